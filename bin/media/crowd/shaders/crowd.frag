@@ -0,0 +1,25 @@
+#version 330 core
+
+// @author: Methusael Murmu
+
+in VS_OUT {
+    vec3 normal;
+    vec3 frag_pos;
+    vec2 tex_coord;
+} fs_in;
+
+uniform sampler2D texture_diffuse0;
+uniform vec3 light_dir;
+uniform vec3 ambience;
+
+// Gamma inverse
+uniform float gamma_inv = 1.0 / 2.2;
+
+out vec4 color;
+
+void main(void) {
+    vec3 diff_map = texture(texture_diffuse0, fs_in.tex_coord).rgb;
+    float diff = max(dot(normalize(fs_in.normal), -light_dir), 0.0);
+
+    color = vec4(pow((ambience + diff) * diff_map, vec3(gamma_inv)), 1.0);
+}
@@ -0,0 +1,55 @@
+#version 330 core
+
+// @author: Methusael Murmu
+
+layout (location = 0) in vec3 position;
+layout (location = 1) in vec3 normal;
+layout (location = 2) in vec2 tex_coord;
+layout (location = 5) in uvec4 joints;
+layout (location = 6) in vec4 weights;
+layout (location = 7) in float morph;  // 0 for meshes without morph targets
+
+out VS_OUT {
+    vec3 normal;
+    vec3 frag_pos;
+    vec2 tex_coord;
+} vs_out;
+
+// Skinning matrices of all instances, 4 texels (columns) per matrix
+uniform samplerBuffer palette;
+uniform int joint_count;
+
+// Blended morph deltas, one texel per vertex
+uniform sampler2D morph_positions;
+uniform sampler2D morph_normals;
+
+uniform mat4 model;
+uniform mat4 proj_view;
+uniform int grid_width;
+uniform float grid_spacing;
+
+mat4 joint_mat(uint joint) {
+    int base = (gl_InstanceID * joint_count + int(joint)) * 4;
+    return mat4(texelFetch(palette, base), texelFetch(palette, base + 1),
+                texelFetch(palette, base + 2), texelFetch(palette, base + 3));
+}
+
+void main(void) {
+    ivec2 texel = ivec2(gl_VertexID % 1024, gl_VertexID / 1024);
+    vec3 local_pos = position + morph * texelFetch(morph_positions, texel, 0).xyz;
+    vec3 local_normal = normal + morph * texelFetch(morph_normals, texel, 0).xyz;
+
+    mat4 skin = weights.x * joint_mat(joints.x) + weights.y * joint_mat(joints.y) +
+                weights.z * joint_mat(joints.z) + weights.w * joint_mat(joints.w);
+
+    // Instances stand on a grid centered at the origin
+    vec2 cell = vec2(gl_InstanceID % grid_width, gl_InstanceID / grid_width);
+    vec3 offset = vec3(cell.x - 0.5 * (grid_width - 1), 0.0, cell.y - 0.5 * (grid_width - 1));
+
+    vec4 world_pos = model * skin * vec4(local_pos, 1.0) + vec4(offset * grid_spacing, 0.0);
+    gl_Position = proj_view * world_pos;
+
+    vs_out.frag_pos = world_pos.xyz;
+    vs_out.normal = normalize(mat3(model) * mat3(skin) * local_normal);
+    vs_out.tex_coord = tex_coord;
+}
@@ -0,0 +1,17 @@
+#version 330 core
+
+// @author: Methusael Murmu
+
+in VS_OUT {
+    vec3 position;
+    vec3 normal;
+} fs_in;
+
+// Added onto the other targets' deltas by blending
+layout (location = 0) out vec4 position_delta;
+layout (location = 1) out vec4 normal_delta;
+
+void main(void) {
+    position_delta = vec4(fs_in.position, 0.0);
+    normal_delta = vec4(fs_in.normal, 0.0);
+}
@@ -0,0 +1,24 @@
+#version 330 core
+
+// @author: Methusael Murmu
+
+// One sparse delta of a morph target, drawn as a point onto its vertex's texel
+layout (location = 0) in uint vertex;
+layout (location = 1) in vec3 position;
+layout (location = 2) in vec3 normal;
+
+out VS_OUT {
+    vec3 position;
+    vec3 normal;
+} vs_out;
+
+uniform vec2 size;  // Texels per row, rows
+uniform float weight;
+
+void main(void) {
+    vec2 texel = vec2(vertex % uint(size.x), vertex / uint(size.x)) + 0.5;
+    gl_Position = vec4(texel / size * 2.0 - 1.0, 0.0, 1.0);
+
+    vs_out.position = weight * position;
+    vs_out.normal = weight * normal;
+}
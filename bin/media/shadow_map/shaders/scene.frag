@@ -3,6 +3,7 @@
 // @author: Methusael Murmu
 
 #define MAX_NUM_LIGHTS 5
+#define MAX_CASCADES 4
 
 in VS_OUT {
     vec3 frag_pos;
@@ -20,6 +21,13 @@ uniform sampler2D texture_diffuse0;
 uniform sampler2D texture_specular0;
 uniform sampler2D texture_normal0;
 uniform sampler2DShadow shadow_tex;
+uniform sampler2DArrayShadow csm_tex;
+
+// Cascaded shadow maps
+uniform bool csm_enabled = false;
+uniform int csm_count;
+uniform float csm_split[MAX_CASCADES];     // View depth where each cascade ends
+uniform mat4 csm_mat[MAX_CASCADES];        // World to shadow texture space
 
 uniform struct {
     vec3 ambience;          // World ambient color
@@ -46,6 +54,7 @@ struct Light {
 uniform int light_count;
 uniform Light light[MAX_NUM_LIGHTS];
 uniform vec3 cam_pos;
+uniform vec3 cam_front;
 
 // Gamma inverse
 uniform float gamma_inv = 1.0 / 2.2;
@@ -104,6 +113,29 @@ float calc_shadow() {
     return 1.0 - visibility / 9.0;
 }
 
+// PCF (3x3 Samples) on the cascade covering this fragment
+float calc_shadow_csm() {
+    float depth = dot(fs_in.frag_pos - cam_pos, cam_front);
+
+    int c;
+    for (c = 0; c < csm_count; ++c)
+        if (depth < csm_split[c]) break;
+    if (c == csm_count) return 0.0;
+
+    vec4 coord = csm_mat[c] * vec4(fs_in.frag_pos, 1.0);
+    vec2 texelSize = 1.0 / textureSize(csm_tex, 0).xy;
+    float visibility = 0.0;
+
+    for (int x = -1; x <= 1; ++x) {
+        for (int y = -1; y <= 1; ++y) {
+            visibility += texture(csm_tex, vec4(
+                coord.xy + vec2(x, y) * texelSize, float(c), coord.z));
+        }
+    }
+
+    return 1.0 - visibility / 9.0;
+}
+
 // Implements Blinn-Phong shading
 void main(void) {
     vec3 out_col = vec3(0);
@@ -119,7 +151,8 @@ void main(void) {
     // Calculate ambient color
     vec3 ambience = world.ambience * material.ambience * diff_map;
     // Apply shadow
-    out_col = mix(out_col + ambience, ambience, calc_shadow());
+    out_col = mix(out_col + ambience, ambience,
+        csm_enabled ? calc_shadow_csm() : calc_shadow());
 
     // Gamma correction
     out_col = pow(out_col, vec3(gamma_inv));
@@ -0,0 +1,18 @@
+#version 330 core
+
+// Single pass cascade rendering: one instance per cascade,
+// routed to its array layer from the vertex stage
+#extension GL_ARB_shader_viewport_layer_array : enable
+#extension GL_AMD_vertex_shader_layer : enable
+
+#define MAX_CASCADES 4
+
+layout (location = 0) in vec3 position;
+
+uniform mat4 lmMat;
+uniform mat4 lvpMat[MAX_CASCADES];
+
+void main(void) {
+    gl_Position = lvpMat[gl_InstanceID] * lmMat * vec4(position, 1.0);
+    gl_Layer = gl_InstanceID;
+}
@@ -0,0 +1,43 @@
+#version 330 core
+
+// One axis of a separable 9-tap gaussian over depth moments.
+// Reads a cube face (face >= 0) or a plain 2D texture (face < 0)
+
+in vec2 tex_coord;
+
+uniform samplerCube cube_src;
+uniform sampler2D plane_src;
+uniform int face = -1;
+uniform vec2 blur_step;     // Texel step along the blur axis
+
+layout (location = 0) out vec2 moments;
+
+// Linearly sampled gaussian: 5 fetches cover 9 texels
+const float kOffsets[3] = float[](0.0, 1.3846153846, 3.2307692308);
+const float kWeights[3] = float[](0.2270270270, 0.3162162162, 0.0702702703);
+
+// Cube map direction for a face texel (see the GL cube map face selection table)
+vec3 face_dir(vec2 st) {
+    st = st * 2.0 - 1.0;
+    if (face == 0) return vec3( 1.0, -st.y, -st.x);
+    if (face == 1) return vec3(-1.0, -st.y,  st.x);
+    if (face == 2) return vec3( st.x,  1.0,  st.y);
+    if (face == 3) return vec3( st.x, -1.0, -st.y);
+    if (face == 4) return vec3( st.x, -st.y,  1.0);
+    return vec3(-st.x, -st.y, -1.0);
+}
+
+vec2 fetch(vec2 st) {
+    return face < 0 ? texture(plane_src, st).rg : texture(cube_src, face_dir(st)).rg;
+}
+
+void main(void) {
+    vec2 sum = fetch(tex_coord) * kWeights[0];
+
+    for (int i = 1; i < 3; ++i) {
+        sum += fetch(tex_coord + blur_step * kOffsets[i]) * kWeights[i];
+        sum += fetch(tex_coord - blur_step * kOffsets[i]) * kWeights[i];
+    }
+
+    moments = sum;
+}
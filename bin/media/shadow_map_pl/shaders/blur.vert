@@ -0,0 +1,10 @@
+#version 330 core
+
+// Fullscreen triangle generated from gl_VertexID (no vertex buffers)
+out vec2 tex_coord;
+
+void main(void) {
+    vec2 pos = vec2((gl_VertexID << 1) & 2, gl_VertexID & 2);
+    tex_coord = pos;
+    gl_Position = vec4(pos * 2.0 - 1.0, 0.0, 1.0);
+}
@@ -11,6 +11,12 @@ in VS_OUT {
 uniform sampler2D texture_diffuse0;
 uniform sampler2D texture_specular0;
 uniform samplerCube shadow_tex;
+uniform samplerCubeShadow shadow_cmp_tex;  // Same depth, hardware compared
+uniform samplerCube vsm_tex;                // Blurred depth moments
+
+// Shadow filter: 0 = 20 tap PCF, 1 = rotated Poisson on hardware compares,
+// 2 = variance shadow map
+uniform int shadow_mode = 0;
 
 uniform struct {
     vec3 ambience;          // World ambient color
@@ -40,6 +46,14 @@ uniform int light_count;
 uniform Light light[MAX_NUM_LIGHTS];
 uniform vec3 cam_pos;
 
+// Shadow atlas: every light's cube faces unrolled into tiles of one texture
+uniform bool atlas_enabled = false;
+uniform sampler2DShadow atlas_tex;
+uniform vec3 atlas_tile[MAX_NUM_LIGHTS * 6];    // (offset, scale), zero if no tile
+uniform vec3 face_dir[6];                       // Cube face view basis
+uniform vec3 face_right[6];
+uniform vec3 face_up[6];
+
 // Gamma inverse
 uniform float gamma_inv = 1.0 / 2.2;
 uniform float farPlane = 100.0f;
@@ -54,6 +68,14 @@ const vec3 kPCFSamples[20] = vec3[](
    vec3( 0,  1,  1), vec3( 0, -1,  1), vec3( 0, -1, -1), vec3( 0,  1, -1)
 );
 
+#define POISSON_TAPS 8
+
+const vec2 kPoissonDisk[POISSON_TAPS] = vec2[](
+   vec2(-0.6134,  0.6230), vec2( 0.1710,  0.9246), vec2( 0.7869,  0.4719),
+   vec2(-0.9382, -0.1845), vec2(-0.2172, -0.0540), vec2( 0.5560, -0.2520),
+   vec2(-0.3937, -0.8610), vec2( 0.3570, -0.8880)
+);
+
 // Function prototypesc
 vec3 calc_point_light(Light plight, vec3 cam_dir, vec3 diff_map,
                       vec3 spec_map);
@@ -87,6 +109,74 @@ float calc_shadow(vec3 lpos) {
     return shadow / float(samples);
 }
 
+// Rotated Poisson disk over hardware filtered compares (each tap is a 2x2 PCF)
+float calc_shadow_poisson(vec3 lpos) {
+    vec3 ftol = fs_in.frag_pos - lpos;
+    float bias = 0.15;
+    float ref = (length(ftol) - bias) / farPlane;
+    float diskRadius = 1.5 * (1.0 + (length(cam_pos - fs_in.frag_pos) / farPlane)) / 50.0;
+
+    // Disk plane perpendicular to the lookup direction
+    vec3 n = normalize(ftol);
+    vec3 t = normalize(cross(n, abs(n.y) < 0.99 ? vec3(0, 1, 0) : vec3(1, 0, 0)));
+    vec3 b = cross(n, t);
+
+    // Per fragment rotation trades banding for noise
+    float angle = 6.2831853 *
+        fract(sin(dot(fs_in.frag_pos, vec3(12.9898, 78.233, 37.719))) * 43758.5453);
+    mat2 rot = mat2(cos(angle), sin(angle), -sin(angle), cos(angle));
+
+    float lit = 0.0;
+    for (int i = 0; i < POISSON_TAPS; ++i) {
+        vec2 p = rot * kPoissonDisk[i] * diskRadius;
+        lit += texture(shadow_cmp_tex, vec4(ftol + t * p.x + b * p.y, ref));
+    }
+
+    return 1.0 - lit / float(POISSON_TAPS);
+}
+
+// Single filtered tap on blurred moments, Chebyshev upper bound
+float calc_shadow_vsm(vec3 lpos) {
+    vec3 ftol = fs_in.frag_pos - lpos;
+    float depth = length(ftol) / farPlane;
+    vec2 moments = texture(vsm_tex, ftol).rg;
+
+    if (depth <= moments.x) return 0.0;
+
+    float variance = max(moments.y - moments.x * moments.x, 0.00002);
+    float delta = depth - moments.x;
+    float p_max = variance / (variance + delta * delta);
+
+    // Cut off the tail to reduce light bleeding
+    return 1.0 - clamp((p_max - 0.3) / 0.7, 0.0, 1.0);
+}
+
+// 3x3 hardware compares in the tile of the cube face the fragment falls in
+float calc_shadow_atlas(int idx, vec3 lpos) {
+    vec3 ftol = fs_in.frag_pos - lpos;
+    vec3 a = abs(ftol);
+    int face = (a.x > a.y && a.x > a.z) ? (ftol.x > 0.0 ? 0 : 1) :
+        (a.y > a.z) ? (ftol.y > 0.0 ? 2 : 3) : (ftol.z > 0.0 ? 4 : 5);
+
+    vec3 tile = atlas_tile[idx * 6 + face];
+    if (tile.z == 0.0) return 0.0;
+
+    // Same projection as the 90 degree face render, kept off the tile borders
+    vec2 uv = vec2(dot(ftol, face_right[face]), dot(ftol, face_up[face])) /
+        dot(ftol, face_dir[face]) * 0.5 + 0.5;
+    float texel = 1.0 / float(textureSize(atlas_tex, 0).x);
+    float inset = 1.5 * texel / tile.z;
+    vec2 st = tile.xy + clamp(uv, inset, 1.0 - inset) * tile.z;
+
+    float ref = (length(ftol) - 0.15) / farPlane;
+    float lit = 0.0;
+    for (int x = -1; x <= 1; ++x)
+        for (int y = -1; y <= 1; ++y)
+            lit += texture(atlas_tex, vec3(st + vec2(x, y) * texel, ref));
+
+    return 1.0 - lit / 9.0;
+}
+
 // Implements Blinn-Phong shading
 void main(void) {
     vec3 out_col = vec3(0);
@@ -97,11 +187,18 @@ void main(void) {
     // Calculate ambient color
     vec3 ambience = world.ambience * material.ambience * diff_map;
 
-    // Calculate color from lights
-    out_col += calc_point_light(light[0], cam_dir, diff_map, spec_map);
+    // Calculate color from lights, shadowed by the atlas or (first light only) the cube
+    for (int i = 0; i < light_count; ++i) {
+        float shadow = 0.0;
+        if (atlas_enabled) shadow = calc_shadow_atlas(i, light[i].position);
+        else if (i == 0 && shadow_mode == 1) shadow = calc_shadow_poisson(light[0].position);
+        else if (i == 0 && shadow_mode == 2) shadow = calc_shadow_vsm(light[0].position);
+        else if (i == 0) shadow = calc_shadow(light[0].position);
 
-    // Apply shadow
-    out_col = mix(out_col + ambience, ambience, calc_shadow(light[0].position));
+        out_col += (1.0 - shadow) *
+            calc_point_light(light[i], cam_dir, diff_map, spec_map);
+    }
+    out_col += ambience;
 
     // Gamma correction
     out_col = pow(out_col, vec3(gamma_inv));
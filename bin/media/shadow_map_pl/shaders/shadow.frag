@@ -5,7 +5,13 @@ in vec4 frag_pos;
 uniform vec3 lightPos;
 uniform float farPlane = 100.0;
 
+// Depth moments, only kept by variance shadow map targets
+layout (location = 0) out vec2 moments;
+
 void main(void) {
     // Map depth to [0, 1]
-    gl_FragDepth = length(frag_pos.xyz - lightPos) / farPlane;
+    float depth = length(frag_pos.xyz - lightPos) / farPlane;
+
+    gl_FragDepth = depth;
+    moments = vec2(depth, depth * depth);
 }
@@ -0,0 +1,14 @@
+#version 330 core
+
+// Renders a single cube face per pass
+layout (location = 0) in vec3 position;
+
+out vec4 frag_pos;
+
+uniform mat4 lmMat;
+uniform mat4 lvpMat;
+
+void main(void) {
+    frag_pos = lmMat * vec4(position, 1.0);
+    gl_Position = lvpMat * frag_pos;
+}
@@ -0,0 +1,22 @@
+#version 330 core
+
+// Single pass cube shadow: one instance per visible cube face,
+// routed to its layer from the vertex stage
+#extension GL_ARB_shader_viewport_layer_array : enable
+#extension GL_AMD_vertex_shader_layer : enable
+
+layout (location = 0) in vec3 position;
+
+out vec4 frag_pos;
+
+uniform mat4 lmMat;
+uniform mat4 lvpMat[6];
+uniform int faceIdx[6];     // Visible faces, indexed by instance
+
+void main(void) {
+    int face = faceIdx[gl_InstanceID];
+
+    frag_pos = lmMat * vec4(position, 1.0);
+    gl_Position = lvpMat[face] * frag_pos;
+    gl_Layer = face;
+}
@@ -0,0 +1,15 @@
+#version 330 core
+
+// Distance field glyphs: 0.5 on the outline, antialiased over one screen pixel
+in vec2 texCoords;
+out vec4 color;
+
+uniform sampler2D text;
+uniform vec3 textColor;
+
+void main(void) {
+    float dist = texture(text, texCoords).r;
+    float width = fwidth(dist) * 0.5;
+
+    color = vec4(textColor, smoothstep(0.5 - width, 0.5 + width, dist));
+}
@@ -47,6 +47,11 @@ class FreeCamera {
         return mViewMat;
     }
 
+    // Current orientation seen from _pos, for positions interpolated between updates
+    t_m4 viewMatAt(t_rcv3 _pos) const {
+        return glm::lookAt(_pos, _pos + mLocalFront, sGLOBAL_UP);
+    }
+
     inline GLfloat fov() const          { return mFov; }
     inline GLfloat speed() const        { return mCamSpeed; }
     inline GLfloat sensitivity() const  { return mSensitivity; }
@@ -9,8 +9,12 @@
 #include <base.h>
 #include <base_util.h>
 #include <base_shader.h>
+#include <base_profiler.h>
+#include <base_gpumem.h>
 #include <3d/object.h>
+#include <3d/morph.h>
 #include <3d/type_common.h>
+#include <animator/skeleton.h>
 #include <external/soil/SOIL.h>
 
 #include <external/assimp/Importer.hpp>
@@ -38,6 +42,12 @@ struct Vertex {
     t_v3 tangent, bitangent;
 };
 
+// Skinning influences, kept in their own stream so static meshes don't pay for them
+struct VertexSkin {
+    GLushort joints[SKIN_MAX_INFLUENCE];
+    GLfloat weights[SKIN_MAX_INFLUENCE];
+};
+
 struct Texture {
     GLuint id;
     glf::TextureType type;
@@ -48,6 +58,7 @@ class Mesh;
 
 typedef std::vector<GLuint>  t_vuint;
 typedef std::vector<Vertex>  t_vvert;
+typedef std::vector<VertexSkin> t_vskin;
 typedef std::vector<Texture> t_vtex;
 typedef std::vector<Mesh>    t_vmesh;
 
@@ -57,15 +68,21 @@ GLuint loadTextureFromFile(const char* _path, std::string _dir, bool sRGB);
 class Mesh {
  public:
     Mesh(const t_vvert& _verts, const t_vuint& _vidx,
-         const t_vuint& _tidx, RenderContext* _renderContext):
-        vertices(_verts), tex_ids(_tidx), vert_ids(_vidx), mpContext(_renderContext) {
-        vAO = vBO = eBO = tex_sz = 0;
+         const t_vuint& _tidx, RenderContext* _renderContext,
+         const t_vskin& _skin = t_vskin(), const MorphSet& _morph = MorphSet()):
+        vertices(_verts), skin(_skin), morph(_morph), tex_ids(_tidx), vert_ids(_vidx),
+        mpContext(_renderContext) {
+        vAO = vBO = eBO = sBO = tex_sz = 0;
         bindMesh();
     }
 
-    ~Mesh() {
+    /* Meshes are copied around while loading, so the owning Model releases
+     * the GL objects once, like MorphSet's */
+    void dispose() {
         glDeleteBuffers(1, &eBO); glDeleteBuffers(1, &vBO);
-        glDeleteBuffers(1, &vAO);
+        glDeleteBuffers(1, &sBO);
+        glDeleteVertexArrays(1, &vAO);
+        vAO = vBO = eBO = sBO = 0;
     }
 
     inline const GLuint VAO() const { return vAO; }
@@ -83,6 +100,14 @@ class Mesh {
             glUniform1i(_texinfo->textureUniformLocation(_type, tex_type_c[_type]++), i);
         }
 
+        // Constant attribute, shaders scale the morph deltas by it
+        if (morph.empty()) {
+            glVertexAttrib1f(glf::ATTR_MORPH_ID, 0.0f);
+        } else {
+            morph.bind(MORPH_TEX_UNIT);
+            glVertexAttrib1f(glf::ATTR_MORPH_ID, 1.0f);
+        }
+
         glBindVertexArray(vAO);
         if (mpContext->shouldDrawInstanced) {
             glDrawElementsInstanced(
@@ -103,11 +128,13 @@ class Mesh {
     }
 
     t_vvert             vertices;
+    t_vskin             skin;   // Empty for static meshes
+    MorphSet            morph;  // Empty without morph targets
     std::vector<GLuint> tex_ids;
     std::vector<GLuint> vert_ids;
 
  private:
-    GLuint vAO, vBO, eBO;
+    GLuint vAO, vBO, eBO, sBO;
     RenderContext* mpContext;
 
     // tex_type:    used as counters for texture types during render
@@ -145,6 +172,20 @@ class Mesh {
             BUFFER_OFFSET(getOffset(Vertex, bitangent)));
         glEnableVertexAttribArray(glf::ATTR_BTAN_ID);
 
+        if (!skin.empty()) {
+            glGenBuffers(1, &sBO);
+            glBindBuffer(GL_ARRAY_BUFFER, sBO);
+            glBufferData(GL_ARRAY_BUFFER, sizeof(VertexSkin) * skin.size(),
+                &skin[0], GL_STATIC_DRAW);
+
+            glVertexAttribIPointer(glf::ATTR_JOINTS_ID, SKIN_MAX_INFLUENCE, GL_UNSIGNED_SHORT,
+                sizeof(VertexSkin), BUFFER_OFFSET(getOffset(VertexSkin, joints)));
+            glEnableVertexAttribArray(glf::ATTR_JOINTS_ID);
+            glVertexAttribPointer(glf::ATTR_WEIGHTS_ID, SKIN_MAX_INFLUENCE, GL_FLOAT, GL_FALSE,
+                sizeof(VertexSkin), BUFFER_OFFSET(getOffset(VertexSkin, weights)));
+            glEnableVertexAttribArray(glf::ATTR_WEIGHTS_ID);
+        }
+
         // Unbind
         glBindVertexArray(0);
         tex_sz = tex_ids.size();
@@ -153,13 +194,17 @@ class Mesh {
 
 class Model: public Object {
  public:
-    explicit Model(t_rcv3 _pos = Object::kDefaultTranslate): mesh_sz(0) {
+    explicit Model(t_rcv3 _pos = Object::kDefaultTranslate): morphsBlended(0), mesh_sz(0) {
         std::fill_n(bounds, BOUNDS_SZ, 0);  // For 6 faces of the box bound
     }
 
     ~Model() {
         for (GLint i = 0; i < textures.size(); ++i)
             glDeleteTextures(1, &textures[i].id);
+        for (GLuint i = 0; i < meshes.size(); ++i) {
+            meshes[i].dispose();
+            meshes[i].morph.dispose();
+        }
     }
 
     inline bool load(const char* _path, bool sRGB = false, bool _flipuv = true) {
@@ -170,6 +215,41 @@ class Model: public Object {
     inline const t_vmesh& getMeshes() const { return meshes; }
     inline RenderContext& renderContext() { return mRenderContext; }
 
+    // Skinned models carry a skeleton, each of their meshes a skin stream
+    inline bool skinned() const { return skeleton.size() > 0; }
+    inline const anim::Skeleton& getSkeleton() const { return skeleton; }
+    inline const std::vector<anim::AnimationClip>& getClips() const { return clips; }
+
+    /* Morph channel c weighs target c of every mesh, Assimp's anim meshes
+     * carry no names so channels go by index */
+    inline GLuint morphChannels() const { return morphWeights.size(); }
+    inline GLfloat morphWeight(GLuint _channel) const { return morphWeights[_channel]; }
+    inline void morphWeight(GLuint _channel, GLfloat _weight) { morphWeights[_channel] = _weight; }
+    // Meshes whose deltas were rebuilt over all updateMorphs() calls
+    inline GLuint morphRebuilds() const { return morphsBlended; }
+
+    // Blends the targets of meshes whose weights changed, _shader is the accumulation pass
+    void updateMorphs(glf::Shader& _shader) {
+        if (morphWeights.empty()) return;
+        for (GLint i = 0; i < mesh_sz; ++i)
+            morphsBlended += meshes[i].morph.accumulate(&morphWeights[0], morphWeights.size(), _shader);
+    }
+
+    // World space bounding sphere enclosing the model's box bound
+    void boundingSphere(t_v3& _center, GLfloat& _radius) {
+        t_rcm4 mat = modelMat();
+        t_v3 mid = 0.5f * t_v3(bounds[RIGHT] + bounds[LEFT],
+            bounds[TOP] + bounds[BOTTOM], bounds[BACK] + bounds[FRONT]);
+        t_v3 half = 0.5f * t_v3(bounds[RIGHT] - bounds[LEFT],
+            bounds[TOP] - bounds[BOTTOM], bounds[BACK] - bounds[FRONT]);
+
+        GLfloat max_scale = std::max(glm::length(t_v3(mat[0])),
+            std::max(glm::length(t_v3(mat[1])), glm::length(t_v3(mat[2]))));
+
+        _center = t_v3(mat * glm::vec4(mid, 1.0f));
+        _radius = glm::length(half) * max_scale;
+    }
+
     void render(glf::ShaderTextureInfo* _texinfo) {
         // Perform per-model setup here
 
@@ -185,6 +265,10 @@ class Model: public Object {
 
     t_vmesh meshes;
     t_vtex  textures;
+    anim::Skeleton skeleton;
+    std::vector<anim::AnimationClip> clips;
+    std::vector<GLfloat> morphWeights;
+    GLuint morphsBlended;
     GLfloat bounds[BOUNDS_SZ];
     RenderContext mRenderContext;
 
@@ -196,6 +280,9 @@ class Model: public Object {
     const Model& operator=(const Model& rhs) {}
 
     bool loadModel(std::string _path, bool _flipuv) {
+        PROFILE_ZONE("Model load");
+        // Meshes and textures are charged to the file they came from
+        GPU_OWNER("Model " + _path.substr(_path.find_last_of('/') + 1));
 #ifdef _MODEL_DEBUG_
         fprintf(stdout, "Loading model: %s\n", _path.c_str());
 #endif
@@ -216,7 +303,12 @@ class Model: public Object {
         fprintf(stdout, "Model directory: %s\n", directory.c_str());
         fprintf(stdout, "Processing nodes...\n");
 #endif
+        if (hasSkin(scene)) {
+            buildSkeleton(scene->mRootNode, -1);
+            skeleton.rootInverse = glm::inverse(toMat4(scene->mRootNode->mTransformation));
+        }
         processNode(scene->mRootNode, scene);
+        loadClips(scene);
 
         mesh_sz = meshes.size();
 #ifdef _MODEL_DEBUG_
@@ -232,7 +324,7 @@ class Model: public Object {
 #endif
         for (i = 0; i < _node->mNumMeshes; ++i) {
             aiMesh* mesh = _scene->mMeshes[_node->mMeshes[i]];
-            meshes.push_back(processMesh(mesh, _scene));
+            meshes.push_back(processMesh(mesh, _scene, skeleton.find(_node->mName.C_Str())));
 #ifdef _MODEL_DEBUG_
         fprintf(stdout, "Processed mesh: (%u of %u)\n", i + 1, _node->mNumMeshes);
 #endif
@@ -246,8 +338,10 @@ class Model: public Object {
         }
     }
 
-    Mesh processMesh(aiMesh* _mesh, const aiScene* _scene) {
+    // _joint: joint of the owning node, drives unskinned meshes of skinned models
+    Mesh processMesh(aiMesh* _mesh, const aiScene* _scene, GLint _joint) {
         t_vvert vertices;
+        t_vskin skin;
         t_vuint tex_ids, vert_ids;
         GLuint i, j;
 
@@ -308,7 +402,151 @@ class Model: public Object {
             tex_ids.insert(tex_ids.end(), norm_ids.begin(), norm_ids.end());
         }
 
-        return Mesh(vertices, vert_ids, tex_ids, &mRenderContext);
+        if (skinned()) processSkin(_mesh, _joint, skin);
+
+        MorphSet morph;
+        if (_mesh->mNumAnimMeshes) processMorphs(_mesh, morph);
+
+        return Mesh(vertices, vert_ids, tex_ids, &mRenderContext, skin, morph);
+    }
+
+    // Keeps the vertices each anim mesh moves, as offsets from the base mesh
+    void processMorphs(const aiMesh* _mesh, MorphSet& _morph) {
+        std::vector<MorphDelta> deltas;
+        MorphDelta delta;
+        _morph.setVertexCount(_mesh->mNumVertices);
+
+        for (GLuint k = 0; k < _mesh->mNumAnimMeshes; ++k) {
+            const aiAnimMesh* target = _mesh->mAnimMeshes[k];
+            deltas.clear();
+            for (GLuint i = 0; i < _mesh->mNumVertices; ++i) {
+                delta.vertex = i;
+                delta.position = delta.normal = t_v3(0.0f);
+                if (target->mVertices) {
+                    aiVector3D d = target->mVertices[i] - _mesh->mVertices[i];
+                    delta.position = t_v3(d.x, d.y, d.z);
+                }
+                if (target->mNormals && _mesh->mNormals) {
+                    aiVector3D d = target->mNormals[i] - _mesh->mNormals[i];
+                    delta.normal = t_v3(d.x, d.y, d.z);
+                }
+                if (glm::dot(delta.position, delta.position) > MORPH_DELTA_EPSILON ||
+                    glm::dot(delta.normal, delta.normal) > MORPH_DELTA_EPSILON)
+                    deltas.push_back(delta);
+            }
+            _morph.addTarget(deltas);
+        }
+
+        if (_morph.targetCount() > morphWeights.size())
+            morphWeights.resize(_morph.targetCount(), 0.0f);
+#ifdef _MODEL_DEBUG_
+        fprintf(stdout, "Morph targets: %u, %u sparse deltas\n", _morph.targetCount(), _morph.deltas());
+#endif
+    }
+
+    static glm::mat4 toMat4(const aiMatrix4x4& _m) {
+        // Assimp matrices are row major
+        return glm::mat4(_m.a1, _m.b1, _m.c1, _m.d1, _m.a2, _m.b2, _m.c2, _m.d2,
+                         _m.a3, _m.b3, _m.c3, _m.d3, _m.a4, _m.b4, _m.c4, _m.d4);
+    }
+
+    static bool hasSkin(const aiScene* _scene) {
+        if (_scene->mNumAnimations > 0) return true;
+        for (GLuint i = 0; i < _scene->mNumMeshes; ++i)
+            if (_scene->mMeshes[i]->HasBones()) return true;
+        return false;
+    }
+
+    // Every node becomes a joint, in depth first order so parents come first
+    void buildSkeleton(const aiNode* _node, GLint _parent) {
+        aiVector3D t, s; aiQuaternion r;
+        _node->mTransformation.Decompose(s, r, t);
+        GLint joint = skeleton.add(_node->mName.C_Str(), _parent,
+            glm::vec3(t.x, t.y, t.z), glm::quat(r.w, r.x, r.y, r.z), glm::vec3(s.x, s.y, s.z));
+
+        for (GLuint i = 0; i < _node->mNumChildren; ++i)
+            buildSkeleton(_node->mChildren[i], joint);
+    }
+
+    // Keeps the SKIN_MAX_INFLUENCE heaviest weights per vertex, normalized
+    void processSkin(const aiMesh* _mesh, GLint _joint, t_vskin& _skin) {
+        VertexSkin rigid;
+        std::fill_n(rigid.joints, SKIN_MAX_INFLUENCE, 0);
+        std::fill_n(rigid.weights, SKIN_MAX_INFLUENCE, 0.0f);
+        if (!_mesh->HasBones()) {  // Follows its node rigidly
+            rigid.joints[0] = std::max(_joint, 0); rigid.weights[0] = 1.0f;
+            _skin.assign(_mesh->mNumVertices, rigid);
+            return;
+        }
+
+        _skin.assign(_mesh->mNumVertices, rigid);
+        GLuint i, j, k;
+        for (i = 0; i < _mesh->mNumBones; ++i) {
+            const aiBone* bone = _mesh->mBones[i];
+            GLint joint = skeleton.find(bone->mName.C_Str());
+            if (joint < 0) continue;
+            skeleton.inverseBind[joint] = toMat4(bone->mOffsetMatrix);
+
+            for (j = 0; j < bone->mNumWeights; ++j) {
+                VertexSkin& vs = _skin[bone->mWeights[j].mVertexId];
+                GLfloat w = bone->mWeights[j].mWeight;
+
+                // Replace the lightest influence if this one is heavier
+                k = std::min_element(vs.weights, vs.weights + SKIN_MAX_INFLUENCE) - vs.weights;
+                if (w > vs.weights[k]) { vs.weights[k] = w; vs.joints[k] = joint; }
+            }
+        }
+
+        for (i = 0; i < _skin.size(); ++i) {
+            GLfloat* w = _skin[i].weights;
+            GLfloat total = 0.0f;
+            for (k = 0; k < SKIN_MAX_INFLUENCE; ++k) total += w[k];
+            if (total > 0.0f) for (k = 0; k < SKIN_MAX_INFLUENCE; ++k) w[k] /= total;
+        }
+    }
+
+    void loadClips(const aiScene* _scene) {
+        GLuint i, j, k;
+        for (i = 0; i < _scene->mNumAnimations && skinned(); ++i) {
+            const aiAnimation* anim = _scene->mAnimations[i];
+            GLfloat tps = anim->mTicksPerSecond > 0.0 ? anim->mTicksPerSecond : 25.0f;
+
+            anim::AnimationClip clip;
+            clip.name = anim->mName.C_Str();
+            clip.duration = anim->mDuration / tps;
+
+            for (j = 0; j < anim->mNumChannels; ++j) {
+                const aiNodeAnim* ch = anim->mChannels[j];
+                GLint joint = skeleton.find(ch->mNodeName.C_Str());
+                if (joint < 0) continue;
+
+                anim::Track<glm::vec3> pos, scale;
+                anim::Track<glm::quat> rot;
+                for (k = 0; k < ch->mNumPositionKeys; ++k) {
+                    const aiVector3D& v = ch->mPositionKeys[k].mValue;
+                    pos.addKey(ch->mPositionKeys[k].mTime / tps, glm::vec3(v.x, v.y, v.z));
+                }
+                for (k = 0; k < ch->mNumRotationKeys; ++k) {
+                    const aiQuaternion& q = ch->mRotationKeys[k].mValue;
+                    rot.addKey(ch->mRotationKeys[k].mTime / tps, glm::quat(q.w, q.x, q.y, q.z));
+                }
+                for (k = 0; k < ch->mNumScalingKeys; ++k) {
+                    const aiVector3D& v = ch->mScalingKeys[k].mValue;
+                    scale.addKey(ch->mScalingKeys[k].mTime / tps, glm::vec3(v.x, v.y, v.z));
+                }
+
+                clip.joints.push_back(joint);
+                clip.translations.push_back(pos);
+                clip.rotations.push_back(rot);
+                clip.scales.push_back(scale);
+            }
+
+#ifdef _MODEL_DEBUG_
+            fprintf(stdout, "Clip: %s (%.2f s, %u channels)\n",
+                clip.name.c_str(), clip.duration, anim->mNumChannels);
+#endif
+            clips.push_back(clip);
+        }
     }
 
     void loadTextures(aiMaterial* _material, aiTextureType _type,
@@ -0,0 +1,186 @@
+#ifndef __MORPH__
+#define __MORPH__
+
+/**
+ * Morph targets blended on the GPU
+ * @author: Methusael Murmu
+ */
+
+#include <base.h>
+#include <base_shader.h>
+#include <base_gpumem.h>
+#include <3d/type_common.h>
+
+#include <stddef.h>
+#include <stdio.h>
+#include <algorithm>
+#include <vector>
+
+namespace glf3d {
+
+#define MORPH_TEX_WIDTH 1024
+#define MORPH_TEX_UNIT 4            // Position deltas, normal deltas on the next unit
+#define MORPH_DELTA_EPSILON 1e-10f  // Squared length below which a delta is dropped
+
+// Offset of one vertex under a fully weighted target
+struct MorphDelta {
+    GLuint vertex;
+    t_v3 position, normal;
+};
+
+/* Sparse targets of one mesh
+ * Each target is a run of deltas drawn as points into two float textures,
+ * one texel per vertex at (id % MORPH_TEX_WIDTH, id / MORPH_TEX_WIDTH), with
+ * additive blending. The textures are only rebuilt when a weight changes, so
+ * the per frame cost doesn't grow with the vertex count */
+class MorphSet {
+ public:
+    MorphSet(): vertices(0), rows(0), deltaCount(0), vAO(0), vBO(0), fBO(0) {
+        tex[0] = tex[1] = 0;
+    }
+
+    inline bool empty() const { return first.empty(); }
+    inline GLuint targetCount() const { return first.size(); }
+    inline GLuint deltas() const { return deltaCount; }
+
+    void setVertexCount(GLuint _vertices) { vertices = _vertices; }
+
+    void addTarget(const std::vector<MorphDelta>& _deltas) {
+        first.push_back(deltaCount);
+        count.push_back(_deltas.size());
+        applied.push_back(0.0f);
+        data.insert(data.end(), _deltas.begin(), _deltas.end());
+        deltaCount += _deltas.size();
+    }
+
+    void dispose() {
+        glDeleteFramebuffers(1, &fBO);
+        glDeleteTextures(2, tex);
+        glDeleteBuffers(1, &vBO);
+        glDeleteVertexArrays(1, &vAO);
+        vAO = vBO = fBO = tex[0] = tex[1] = 0;
+    }
+
+    /* Rebuilds the blended deltas if any of _weights (one per target, missing
+     * ones are 0) changed since the last call. Leaves _shader in use
+     * Returns whether the textures were rebuilt */
+    bool accumulate(const GLfloat* _weights, GLuint _count, glf::Shader& _shader) {
+        if (empty()) return false;
+
+        bool changed = !tex[0];
+        for (GLuint t = 0; t < first.size(); ++t) {
+            GLfloat w = t < _count ? _weights[t] : 0.0f;
+            changed = changed || w != applied[t];
+            applied[t] = w;
+        }
+        if (!changed) return false;
+        if (!tex[0]) init();
+
+        GLint viewport[4], fbo, blend[4];
+        glGetIntegerv(GL_VIEWPORT, viewport);
+        glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &fbo);
+        glGetIntegerv(GL_BLEND_SRC_RGB, &blend[0]); glGetIntegerv(GL_BLEND_DST_RGB, &blend[1]);
+        glGetIntegerv(GL_BLEND_SRC_ALPHA, &blend[2]); glGetIntegerv(GL_BLEND_DST_ALPHA, &blend[3]);
+        GLboolean blending = glIsEnabled(GL_BLEND), depth = glIsEnabled(GL_DEPTH_TEST);
+
+        static const GLfloat zero[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+        glBindFramebuffer(GL_FRAMEBUFFER, fBO);
+        glViewport(0, 0, MORPH_TEX_WIDTH, rows);
+        glClearBufferfv(GL_COLOR, 0, zero);
+        glClearBufferfv(GL_COLOR, 1, zero);
+
+        glDisable(GL_DEPTH_TEST);
+        glEnable(GL_BLEND);
+        glBlendFunc(GL_ONE, GL_ONE);
+
+        _shader.use();
+        GLint loc_weight = glGetUniformLocation(_shader.getProgram(), "weight");
+        glUniform2f(glGetUniformLocation(_shader.getProgram(), "size"),
+            (GLfloat) MORPH_TEX_WIDTH, (GLfloat) rows);
+
+        glBindVertexArray(vAO);
+        for (GLuint t = 0; t < first.size(); ++t) {
+            if (applied[t] == 0.0f || count[t] == 0) continue;
+            glUniform1f(loc_weight, applied[t]);
+            glDrawArrays(GL_POINTS, first[t], count[t]);
+        }
+        glBindVertexArray(0);
+
+        // Restore what the caller had
+        glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+        glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+        glBlendFuncSeparate(blend[0], blend[1], blend[2], blend[3]);
+        if (!blending) glDisable(GL_BLEND);
+        if (depth) glEnable(GL_DEPTH_TEST);
+        return true;
+    }
+
+    // Position deltas on _unit, normal deltas on _unit + 1
+    void bind(GLuint _unit) const {
+        glActiveTexture(GL_TEXTURE0 + _unit);
+        glBindTexture(GL_TEXTURE_2D, tex[0]);
+        glActiveTexture(GL_TEXTURE0 + _unit + 1);
+        glBindTexture(GL_TEXTURE_2D, tex[1]);
+    }
+
+ private:
+    GLuint vertices, rows, deltaCount;
+    GLuint vAO, vBO, fBO, tex[2];
+
+    // Delta runs per target and the weights the textures hold
+    std::vector<GLuint> first, count;
+    std::vector<GLfloat> applied;
+    std::vector<MorphDelta> data;  // Released once uploaded
+
+    // Created on first use, meshes are copied around while loading
+    void init() {
+        GPU_OWNER("Morph targets");
+        rows = std::max(1u, (vertices + MORPH_TEX_WIDTH - 1) / MORPH_TEX_WIDTH);
+
+        glGenTextures(2, tex);
+        for (GLuint i = 0; i < 2; ++i) {
+            glBindTexture(GL_TEXTURE_2D, tex[i]);
+            glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA32F, MORPH_TEX_WIDTH, rows, 0,
+                GL_RGBA, GL_FLOAT, NULL);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        }
+        glBindTexture(GL_TEXTURE_2D, 0);
+
+        GLint fbo;
+        glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &fbo);
+        glGenFramebuffers(1, &fBO);
+        glBindFramebuffer(GL_FRAMEBUFFER, fBO);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, tex[0], 0);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, GL_TEXTURE_2D, tex[1], 0);
+        static const GLenum buffers[2] = { GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1 };
+        glDrawBuffers(2, buffers);
+        if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+            fprintf(stderr, "MorphSet: incomplete delta framebuffer\n");
+        glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+
+        glGenVertexArrays(1, &vAO);
+        glGenBuffers(1, &vBO);
+        glBindVertexArray(vAO);
+        glBindBuffer(GL_ARRAY_BUFFER, vBO);
+        glBufferData(GL_ARRAY_BUFFER, sizeof(MorphDelta) * data.size(),
+            data.empty() ? NULL : &data[0], GL_STATIC_DRAW);
+
+        glVertexAttribIPointer(0, 1, GL_UNSIGNED_INT, sizeof(MorphDelta),
+            BUFFER_OFFSET(offsetof(MorphDelta, vertex)));
+        glEnableVertexAttribArray(0);
+        glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(MorphDelta),
+            BUFFER_OFFSET(offsetof(MorphDelta, position)));
+        glEnableVertexAttribArray(1);
+        glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, sizeof(MorphDelta),
+            BUFFER_OFFSET(offsetof(MorphDelta, normal)));
+        glEnableVertexAttribArray(2);
+        glBindVertexArray(0);
+
+        std::vector<MorphDelta>().swap(data);
+    }
+};
+
+}  // namespace glf3d
+
+#endif
@@ -15,7 +15,7 @@ namespace glf3d {
 
 class Object {
  public:
-    explicit Object(t_rcv3 _pos = kDefaultTranslate) {
+    explicit Object(t_rcv3 _pos = kDefaultTranslate): mRevision(0) {
         translate(_pos); scalef(1.0f);
         rotate(0.0f, glm::vec3(0, 1, 0));
         rotateAnchor(0.0, glm::vec3(0, 1, 0), _pos);
@@ -28,31 +28,37 @@ class Object {
     }
 
     inline t_rcv3 translate() const { return mTranslate; }
+    // Bumped on every transform change; lets observers cache derived state
+    inline GLuint revision() const { return mRevision; }
     inline t_rcm4 modelMat() {
         if (stale.all != 0) updateModelMatrix();
         return mModelMat;
     }
 
     // Setters
-    inline void translate(t_rcv3 _pos) { mTranslate = _pos; stale.pos = true; }
-    inline void scale(t_rcv3 _scale) { mScale = _scale; stale.scale = true; }
+    inline void translate(t_rcv3 _pos) { mTranslate = _pos; stale.pos = true; touch(); }
+    inline void scale(t_rcv3 _scale) { mScale = _scale; stale.scale = true; touch(); }
     inline void scalef(GLfloat _scale) { scale(glm::vec3(_scale)); }
 
     inline void rotate(GLfloat _angle, t_rcv3 _rot_axis) {
         locAngle = _angle; locRotAxis = _rot_axis;
-        stale.rot = true;
+        stale.rot = true; touch();
     }
 
     inline void rotateAnchor(GLfloat _angle, t_rcv3 _rot_axis, t_rcv3 _anchor) {
         ancAngle = _angle; ancRotAxis = _rot_axis;
         ancPos = _anchor;
-        stale.ancRot = true;
+        stale.ancRot = true; touch();
     }
 
     // Default constants
     static const t_v3 kDefaultTranslate;
 
+ protected:
+    inline void touch() { mRevision++; }
+
  private:
+    GLuint mRevision;
     t_m4 mModelMat, mTransMat, mRotMat, mScaleMat, mAncRotMat;
     t_v3 mTranslate, mScale, locRotAxis, ancRotAxis, ancPos, mPos;
     GLfloat locAngle, ancAngle;  // Local and anchored rotation angle in radians
@@ -191,7 +197,7 @@ class Light: public Object {
 
     // Setters
     inline void type(LightType _type) { mType = _type; }
-    inline void direction(t_rcv3 _dir) { mDirection = glm::normalize(_dir); }
+    inline void direction(t_rcv3 _dir) { mDirection = glm::normalize(_dir); touch(); }
     inline void cutoffInner(GLfloat _angle) { mCutoffInner = _angle; }
     inline void cutoffOuter(GLfloat _angle) { mCutoffOuter = _angle; }
     inline void distance(GLfloat _dist) {
@@ -0,0 +1,326 @@
+#ifndef __SHADOW__
+#define __SHADOW__
+
+/**
+ * Shadow map helpers
+ * @author: Methusael Murmu
+ */
+
+#include <base.h>
+#include <3d/object.h>
+#include <3d/type_common.h>
+#include <external/glm/matrix.hpp>
+#include <external/glm/gtc/matrix_transform.hpp>
+
+#include <math.h>
+#include <vector>
+#include <algorithm>
+
+namespace glf3d {
+
+// Selects which shadow casters a depth pass renders
+enum CasterFilter { CASTER_ALL, CASTER_STATIC, CASTER_DYNAMIC };
+
+inline bool casterSelected(bool _static, CasterFilter _filter) {
+    return _filter == CASTER_ALL || _static == (_filter == CASTER_STATIC);
+}
+
+/* Decides when a cached depth map of static casters has to be rebuilt
+ * The light and the static casters are observed through their Object
+ * revisions, so the static depth is only re-rendered after one of them moved */
+class ShadowCache {
+ public:
+    ShadowCache(): enabled(true), dirty(true), lightRev(0), rebuilds(0) {}
+
+    void addStatic(Object* _obj) {
+        statics.push_back(_obj);
+        revisions.push_back(_obj->revision());
+        dirty = true;
+    }
+
+    void clear() { statics.clear(); revisions.clear(); dirty = true; }
+    void invalidate() { dirty = true; }
+
+    void enable(bool _enable) { enabled = _enable; dirty = true; }
+    bool isEnabled() const { return enabled; }
+
+    // Number of times the static depth was re-rendered
+    GLuint rebuildCount() const { return rebuilds; }
+
+    // Returns true if the static depth map has to be re-rendered this frame
+    bool stale(const Object& _light) {
+        bool changed = dirty || !enabled || _light.revision() != lightRev;
+        lightRev = _light.revision();
+
+        for (size_t i = 0; i < statics.size(); ++i) {
+            if (statics[i]->revision() != revisions[i]) {
+                revisions[i] = statics[i]->revision();
+                changed = true;
+            }
+        }
+
+        dirty = false;
+        if (changed) rebuilds++;
+        return changed;
+    }
+
+ private:
+    std::vector<Object*> statics;
+    std::vector<GLuint> revisions;
+
+    bool enabled, dirty;
+    GLuint lightRev, rebuilds;
+};
+
+// Copy the depth attachment of one framebuffer into another of equal size
+inline void blitDepth(GLuint _src, GLuint _dst, GLint _width, GLint _height) {
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, _src);
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, _dst);
+    glBlitFramebuffer(0, 0, _width, _height, 0, 0, _width, _height,
+        GL_DEPTH_BUFFER_BIT, GL_NEAREST);
+    glBindFramebuffer(GL_FRAMEBUFFER, _dst);
+}
+
+#define MAX_CASCADES 4
+
+/* Cascaded shadow maps for directional lights
+ * The camera frustum is split with the practical split scheme (a blend of
+ * logarithmic and uniform splits, weighted by lambda). Each cascade is fitted
+ * with a bounding sphere of its sub-frustum, which keeps its size constant
+ * under camera rotation, and snapped to whole shadow texels to avoid shimmer */
+class CascadedShadow {
+ public:
+    explicit CascadedShadow(GLuint _count = MAX_CASCADES,
+        GLuint _res = 1024, GLfloat _lambda = 0.75f): mResolution(_res) {
+        count(_count); lambda(_lambda);
+        casterMargin(kDefaultCasterMargin);
+    }
+
+    // Getters
+    inline GLuint count() const { return mCount; }
+    inline GLuint resolution() const { return mResolution; }
+    inline GLfloat lambda() const { return mLambda; }
+    // View space depth where cascade _idx ends
+    inline GLfloat splitDepth(GLuint _idx) const { return mSplits[_idx + 1]; }
+    inline t_rcm4 lightViewProj(GLuint _idx) const { return mLightVP[_idx]; }
+
+    // Setters
+    inline void count(GLuint _count) {
+        mCount = glm::clamp<GLuint>(_count, 1, MAX_CASCADES);
+    }
+    inline void lambda(GLfloat _lambda) {
+        mLambda = glm::clamp<GLfloat>(_lambda, 0.0f, 1.0f);
+    }
+    // Extra depth behind each cascade for casters outside the camera frustum
+    inline void casterMargin(GLfloat _margin) { mCasterMargin = _margin; }
+
+    // Fits all cascades to the view frustum between _near and _far
+    void update(t_rcm4 _view, GLfloat _fov, GLfloat _aspect,
+                GLfloat _near, GLfloat _far, t_rcv3 _lightDir) {
+        GLuint i;
+        GLfloat ratio = _far / _near;
+
+        mSplits[0] = _near;
+        for (i = 1; i <= mCount; ++i) {
+            GLfloat frac = static_cast<GLfloat>(i) / mCount;
+            mSplits[i] = LINEAR_IP(mLambda,
+                _near + (_far - _near) * frac, _near * powf(ratio, frac));
+        }
+
+        t_m4 invView = glm::inverse(_view);
+        GLfloat tanV = tanf(_fov * 0.5f), tanH = tanV * _aspect;
+
+        for (i = 0; i < mCount; ++i)
+            fitCascade(i, invView, tanH, tanV, _lightDir);
+    }
+
+ private:
+    GLuint mCount, mResolution;
+    GLfloat mLambda, mCasterMargin;
+    GLfloat mSplits[MAX_CASCADES + 1];
+    t_m4 mLightVP[MAX_CASCADES];
+
+    static constexpr GLfloat kDefaultCasterMargin = 20.0f;
+
+    void fitCascade(GLuint _idx, t_rcm4 _invView, GLfloat _tanH,
+                    GLfloat _tanV, t_rcv3 _lightDir) {
+        GLfloat d[2] = { mSplits[_idx], mSplits[_idx + 1] };
+        t_v3 corners[8], center(0.0f);
+        GLuint i;
+
+        // Sub-frustum corners in world space
+        for (i = 0; i < 8; ++i) {
+            GLfloat z = d[i >> 2];
+            glm::vec4 vc((i & 1 ? 1.0f : -1.0f) * _tanH * z,
+                         (i & 2 ? 1.0f : -1.0f) * _tanV * z, -z, 1.0f);
+            corners[i] = t_v3(_invView * vc);
+            center += corners[i];
+        }
+        center /= 8.0f;
+
+        GLfloat radius = 0.0f;
+        for (i = 0; i < 8; ++i)
+            radius = std::max(radius, glm::length(corners[i] - center));
+        // Quantize to keep the projection size stable between frames
+        radius = ceilf(radius * 16.0f) / 16.0f;
+
+        t_v3 up = fabs(_lightDir.y) > 0.99f ? t_v3(0, 0, 1) : t_v3(0, 1, 0);
+        t_m4 view = glm::lookAt(
+            center - _lightDir * (radius + mCasterMargin), center, up);
+        t_m4 proj = glm::ortho(-radius, radius, -radius, radius,
+            0.0f, 2.0f * radius + mCasterMargin);
+
+        // Snap the projected world origin to the texel grid
+        GLfloat half_res = mResolution * 0.5f;
+        glm::vec4 origin = proj * view * glm::vec4(0.0f, 0.0f, 0.0f, 1.0f);
+        glm::vec2 texel = glm::vec2(origin) * half_res;
+        glm::vec2 offset = (glm::round(texel) - texel) / half_res;
+        proj[3][0] += offset.x;
+        proj[3][1] += offset.y;
+
+        mLightVP[_idx] = proj * view;
+    }
+};
+
+// Square region of a shadow atlas, in texels
+struct ShadowTile {
+    GLuint x, y, size;
+};
+
+/* Shares one depth texture between many shadow maps
+ * Requests are made each frame in order of decreasing importance, each for a
+ * number of equally sized tiles (6 for an unrolled cube). Sizes are rounded down
+ * to powers of two; if they don't fit, the biggest tiles of the least important
+ * requests are halved, and requests already at the minimum size dropped last.
+ * Tiles are then placed biggest first along a Morton curve, which packs power
+ * of two squares without gaps */
+class ShadowAtlas {
+ public:
+    explicit ShadowAtlas(GLuint _res = 4096,
+        GLuint _minTile = 64, GLuint _maxTile = 1024):
+        mResolution(_res), mMinTile(_minTile), mMaxTile(std::min(_maxTile, _res)) {}
+
+    // Getters
+    inline GLuint resolution() const { return mResolution; }
+    inline GLuint minTile() const { return mMinTile; }
+    inline GLuint maxTile() const { return mMaxTile; }
+    inline GLuint requestCount() const { return requests.size(); }
+
+    // Tile size granted to a request, 0 if it was dropped
+    inline GLuint granted(GLuint _req) const { return requests[_req].size; }
+    inline const ShadowTile& tile(GLuint _req, GLuint _idx) const {
+        return tiles[requests[_req].first + _idx];
+    }
+
+    // Atlas texture coordinate transform of a tile: (offset, scale), zero if dropped
+    glm::vec3 tileTransform(GLuint _req, GLuint _idx) const {
+        if (!granted(_req)) return glm::vec3(0.0f);
+
+        const ShadowTile& t = tile(_req, _idx);
+        GLfloat inv = 1.0f / mResolution;
+        return glm::vec3(t.x * inv, t.y * inv, t.size * inv);
+    }
+
+    // Starts a new frame of requests
+    void begin() { requests.clear(); tiles.clear(); }
+
+    // Returns the request handle; a zero size (nothing on screen) is dropped outright
+    GLuint request(GLuint _size, GLuint _count = 1) {
+        GLuint size = _size ? mMinTile : 0;
+        while (size && size * 2 <= std::min(_size, mMaxTile)) size *= 2;
+
+        Request req = { size, _count, static_cast<GLuint>(tiles.size()) };
+        requests.push_back(req);
+        tiles.resize(tiles.size() + _count);
+        return requests.size() - 1;
+    }
+
+    // Fits and places all requests of this frame
+    void pack() {
+        GLuint i, j;
+        GLuint capacity = units(mResolution);
+        GLuint total = 0;
+        for (i = 0; i < requests.size(); ++i)
+            total += requests[i].count * units(requests[i].size);
+
+        while (total > capacity) {
+            // Least important request among the ones holding the biggest tiles
+            GLuint victim = requests.size();
+            for (i = requests.size(); i-- > 0;) {
+                if (requests[i].size > mMinTile && (victim == requests.size() ||
+                    requests[i].size > requests[victim].size)) victim = i;
+            }
+
+            if (victim != requests.size()) {
+                total -= requests[victim].count * units(requests[victim].size);
+                requests[victim].size /= 2;
+                total += requests[victim].count * units(requests[victim].size);
+                continue;
+            }
+
+            // Everything is at the minimum size, drop the least important
+            for (i = requests.size(); i-- > 0;) {
+                if (!requests[i].size) continue;
+                total -= requests[i].count * units(requests[i].size);
+                requests[i].size = 0;
+                break;
+            }
+        }
+
+        // Biggest first, importance order among equal sizes
+        std::vector<GLuint> order(requests.size());
+        for (i = 0; i < order.size(); ++i) order[i] = i;
+        std::stable_sort(order.begin(), order.end(), SizeGreater(requests));
+
+        GLuint offset = 0;
+        for (i = 0; i < order.size(); ++i) {
+            const Request& req = requests[order[i]];
+            if (!req.size) continue;
+
+            for (j = 0; j < req.count; ++j) {
+                ShadowTile& t = tiles[req.first + j];
+                t.x = compact(offset) * mMinTile;
+                t.y = compact(offset >> 1) * mMinTile;
+                t.size = req.size;
+                offset += units(req.size);
+            }
+        }
+    }
+
+ private:
+    struct Request {
+        GLuint size, count, first;
+    };
+
+    struct SizeGreater {
+        explicit SizeGreater(const std::vector<Request>& _reqs): reqs(_reqs) {}
+        bool operator()(GLuint _a, GLuint _b) const {
+            return reqs[_a].size > reqs[_b].size;
+        }
+        const std::vector<Request>& reqs;
+    };
+
+    GLuint mResolution, mMinTile, mMaxTile;
+    std::vector<Request> requests;
+    std::vector<ShadowTile> tiles;
+
+    // Area of a tile in minimum size tiles
+    inline GLuint units(GLuint _size) const {
+        GLuint edge = _size / mMinTile;
+        return edge * edge;
+    }
+
+    // Gathers the even bits of a Morton code
+    static GLuint compact(GLuint _code) {
+        _code &= 0x55555555;
+        _code = (_code | (_code >> 1)) & 0x33333333;
+        _code = (_code | (_code >> 2)) & 0x0f0f0f0f;
+        _code = (_code | (_code >> 4)) & 0x00ff00ff;
+        _code = (_code | (_code >> 8)) & 0x0000ffff;
+        return _code;
+    }
+};
+
+}  // namespace glf3d
+
+#endif
@@ -0,0 +1,71 @@
+#ifndef __SKIN__
+#define __SKIN__
+
+/**
+ * GPU side of skinning
+ * @author: Methusael Murmu
+ */
+
+#include <base.h>
+#include <base_gpumem.h>
+#include <external/glm/mat4x4.hpp>
+
+namespace glf3d {
+
+/* Skinning matrices of any number of characters in one texture buffer
+ * Matrix m spans texels [4m, 4m + 3], one column each, so a vertex shader
+ * fetches joint j of instance i at (i * joint_count + j) * 4 */
+class PaletteBuffer {
+ public:
+    PaletteBuffer(): buffer(0), texture(0), capacity(0) {}
+
+    void init(GLuint _matrices) {
+        if (texture) return;
+
+        GPU_OWNER("Skin palettes");
+        glGenBuffers(1, &buffer);
+        glGenTextures(1, &texture);
+        reserve(_matrices);
+
+        glBindTexture(GL_TEXTURE_BUFFER, texture);
+        glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32F, buffer);
+        glBindTexture(GL_TEXTURE_BUFFER, 0);
+    }
+
+    void dispose() {
+        glDeleteTextures(1, &texture);
+        glDeleteBuffers(1, &buffer);
+        texture = buffer = capacity = 0;
+    }
+
+    // Orphans the previous contents so frames in flight are left alone
+    void upload(const glm::mat4* _data, GLuint _matrices) {
+        if (_matrices > capacity) reserve(_matrices);
+
+        glBindBuffer(GL_TEXTURE_BUFFER, buffer);
+        glBufferData(GL_TEXTURE_BUFFER, capacity * sizeof(glm::mat4), NULL, GL_STREAM_DRAW);
+        glBufferSubData(GL_TEXTURE_BUFFER, 0, _matrices * sizeof(glm::mat4), _data);
+        glBindBuffer(GL_TEXTURE_BUFFER, 0);
+    }
+
+    void bind(GLuint _unit) const {
+        glActiveTexture(GL_TEXTURE0 + _unit);
+        glBindTexture(GL_TEXTURE_BUFFER, texture);
+    }
+
+    inline GLuint size() const { return capacity; }
+
+ private:
+    GLuint buffer, texture, capacity;
+
+    void reserve(GLuint _matrices) {
+        capacity = _matrices;
+        glBindBuffer(GL_TEXTURE_BUFFER, buffer);
+        glBufferData(GL_TEXTURE_BUFFER, capacity * sizeof(glm::mat4), NULL, GL_STREAM_DRAW);
+        glBindBuffer(GL_TEXTURE_BUFFER, 0);
+    }
+};
+
+}  // namespace glf3d
+
+#endif
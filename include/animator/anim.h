@@ -9,12 +9,12 @@
 #include <base_util.h>
 
 #include <math.h>
-#include <stdlib.h>
-#include <string.h>
 #include <external/glm/common.hpp>
 #include <external/glm/gtc/constants.hpp>
 
 #include <algorithm>
+#include <new>
+#include <type_traits>
 #include <vector>
 
 namespace anim {
@@ -44,105 +44,108 @@ enum InterpolatorType { LINEAR, SINE, COSINE };
 enum AnimatorStatus { STOPPED, PAUSED, RUNNING };
 enum AnimatorLoopType { LOOP_ONCE, LOOP_START, LOOP_REVERSE };
 
+// Eases frac between the end points. Stateless, so they fit any Interpolator
+struct LinearInterpolator {
+    template <typename T>
+    T operator()(const T& init, const T& final, float frac) const {
+        return LINEAR_IP(frac, init, final);
+    }
+};
+
+struct SineInterpolator {
+    template <typename T>
+    T operator()(const T& init, const T& final, float frac) const {
+        float val_frac = (sin(frac * util::Constants::PI_TWO) + 1) / 2.0f;
+        return LINEAR_IP(val_frac, init, final);
+    }
+};
+
+struct CosineInterpolator {
+    template <typename T>
+    T operator()(const T& init, const T& final, float frac) const {
+        float val_frac = (cos(frac * util::Constants::PI_TWO) + 1) / 2.0f;
+        return LINEAR_IP(val_frac, init, final);
+    }
+};
+
+#define ANIM_INTERPOLATOR_BUF_SZ 16
+
+/* Type erased interpolation callable, T (init, final, frac)
+ * The callable is kept inline, so interpolators are created, copied and called
+ * without touching the heap. It must be trivially copyable and fit in
+ * ANIM_INTERPOLATOR_BUF_SZ bytes */
 template <typename T>
 class Interpolator {
  public:
-    Interpolator() { context = NULL; }
+    Interpolator() { bind(LinearInterpolator()); }
 
-    void setPropertyContext(PropertyContext<T>* _context) {
-        context = _context;
+    template <typename F>
+    static Interpolator<T> from(const F& _func) {
+        Interpolator<T> ip; ip.bind(_func);
+        return ip;
     }
 
-    virtual void interpolate(T& val, float frac) = 0;
+    inline T operator()(const T& _init, const T& _final, float _frac) const {
+        return invoker(&storage, _init, _final, _frac);
+    }
 
  private:
-    Interpolator(const Interpolator& ref) {}
+    typedef T (*Invoker)(const void*, const T&, const T&, float);
 
- protected:
-    PropertyContext<T>* context;
-};
+    union Storage {
+        unsigned char bytes[ANIM_INTERPOLATOR_BUF_SZ];
+        void* alignPtr; double alignDouble;
+    };
 
-#define _ctxt Interpolator<T>::context
+    Invoker invoker;
+    Storage storage;
 
-template <typename T>
-class LinearInterpolator: public Interpolator<T> {
- public:
-    void interpolate(T& val, float frac) {
-        val = LINEAR_IP(frac, _ctxt->init, _ctxt->final);
-    }
-};
+    template <typename F>
+    void bind(const F& _func) {
+        static_assert(sizeof(F) <= sizeof(Storage) && alignof(F) <= alignof(Storage),
+            "Interpolator callable does not fit in ANIM_INTERPOLATOR_BUF_SZ");
+        static_assert(std::is_trivially_copyable<F>::value,
+            "Interpolator callable must be trivially copyable");
 
-template <typename T>
-class SineInterpolator: public Interpolator<T> {
- public:
-    void interpolate(T& val, float frac) {
-        float val_frac = (sin(frac * util::Constants::PI_TWO) + 1) / 2.0f;
-        val = LINEAR_IP(val_frac, _ctxt->init, _ctxt->final);
+        new (&storage) F(_func);
+        invoker = &invoke<F>;
     }
-};
 
-template <typename T>
-class CosineInterpolator: public Interpolator<T> {
- public:
-    void interpolate(T& val, float frac) {
-        float val_frac = (cos(frac * util::Constants::PI_TWO) + 1) / 2.0f;
-        val = LINEAR_IP(val_frac, _ctxt->init, _ctxt->final);
+    template <typename F>
+    static T invoke(const void* _func, const T& _init, const T& _final, float _frac) {
+        return (*static_cast<const F*>(_func))(_init, _final, _frac);
     }
 };
 
-#undef _ctxt
-
 template <typename T>
 class InterpolatorFactory {
  public:
-    static Interpolator<T>* create(InterpolatorType _type) {
+    static Interpolator<T> create(InterpolatorType _type) {
         switch (_type) {
-            case LINEAR:
-                return new LinearInterpolator<T>;
             case SINE:
-                return new SineInterpolator<T>;
+                return Interpolator<T>::from(SineInterpolator());
             case COSINE:
-                return new CosineInterpolator<T>;
-            default: return NULL;
+                return Interpolator<T>::from(CosineInterpolator());
+            default:
+                return Interpolator<T>::from(LinearInterpolator());
         }
     }
 };
 
+/* Interpolates a property over time
+ * Context and interpolator are held by value, copies are plain member copies */
 template <typename T>
 class PropertyAnimator {
  public:
     enum INC_FACTOR { FORWARD = 1, BACKWARD = -1 };
 
-    PropertyAnimator() {
-        construtor(0, 1, 1);
+    PropertyAnimator(): context(0, 1, 1) {
+        init(0);
     }
 
-    PropertyAnimator(T _init, T _final, float _duration) {
-        construtor(_init, _final, _duration);
-    }
-
-    PropertyAnimator(const PropertyAnimator& ref) {
-        size_t sz = sizeof(*ref.interpolator);
-        Interpolator<T>* new_ip = static_cast<Interpolator<T>*>(malloc(sz));
-        memcpy(new_ip, ref.interpolator, sz);
-
-        init(ref.val, ref.elapsedTime, ref.loopType, ref.incFactor,
-             ref.stat, new PropertyContext<T>(*ref.context), new_ip);
-    }
-
-    virtual ~PropertyAnimator() {
-        delete context;
-        delete interpolator;
-    }
-
-    const PropertyAnimator<T>& operator=(PropertyAnimator<T> pc) {
-        val = pc.val; elapsedTime = pc.elapsedTime;
-        loopType = pc.loopType; incFactor = pc.incFactor;
-        stat = pc.stat;
-
-        std::swap(this->context, pc.context);
-        std::swap(this->interpolator, pc.interpolator);
-        return *this;
+    PropertyAnimator(T _init, T _final, float _duration):
+        context(_init, _final, _duration) {
+        init(_init);
     }
 
     inline const T value() const { return val; }
@@ -153,37 +156,30 @@ class PropertyAnimator {
     void stop() { stat = STOPPED; reset(); }
 
     void set(T _init, T _final, float _duration) {
-        context->set(_init, _final, _duration);
+        context.set(_init, _final, _duration);
     }
 
     void setLoopType(AnimatorLoopType type) {
         loopType = type;
     }
 
-    void setInterpolator(Interpolator<T>* _interpolator) {
-        if (interpolator == _interpolator ||
-            _interpolator == NULL)
-            return;
-
-        if (interpolator != NULL) { delete interpolator; }
-
+    void setInterpolator(const Interpolator<T>& _interpolator) {
         interpolator = _interpolator;
-        interpolator->setPropertyContext(context);
     }
 
     void step(float tp) {
         if (stat != RUNNING)
             return;
 
-        interpolator->interpolate(val, elapsedTime / context->duration);
+        val = interpolator(context.init, context.final, elapsedTime / context.duration);
         switch (loopType) {
             case LOOP_ONCE:
-                if (elapsedTime >= context->duration)
+                if (elapsedTime >= context.duration)
                     stop();
                 break;
 
             case LOOP_REVERSE:
-                if (elapsedTime >= context->duration && incFactor == FORWARD)
+                if (elapsedTime >= context.duration && incFactor == FORWARD)
                     incFactor = BACKWARD;
                 else if (elapsedTime <= 0 && incFactor == BACKWARD)
                     incFactor = FORWARD;
@@ -192,8 +188,8 @@ class PropertyAnimator {
 
         elapsedTime += incFactor * tp;
         elapsedTime = loopType != LOOP_START ?
-            glm::clamp<float>(elapsedTime, 0, context->duration) :
-                fmod(elapsedTime, context->duration);
+            glm::clamp<float>(elapsedTime, 0, context.duration) :
+                fmod(elapsedTime, context.duration);
     }
 
  private:
@@ -204,27 +200,13 @@ class PropertyAnimator {
     AnimatorLoopType loopType;
     INC_FACTOR incFactor;
 
-    PropertyContext<T>* context;
-    Interpolator<T>* interpolator;
-
-    // Workaround for constructor delegation
-    void construtor(T _init, T _final, float _duration) {
-        init(_init, 0, LOOP_START, FORWARD, RUNNING,
-             new PropertyContext<T>(_init, _final, _duration),
-             InterpolatorFactory<T>::create(LINEAR));
-    }
-
-    void init(T _value, float _time, AnimatorLoopType _loop,
-        INC_FACTOR _fac, AnimatorStatus _status, PropertyContext<T>* pc,
-        Interpolator<T>* ip) {
-        // Say NO to bad initial pointers
-        context = NULL; interpolator = NULL;
-
-        val = _value; elapsedTime = _time;
-        loopType = _loop; incFactor = _fac;
-        stat = _status;
+    PropertyContext<T> context;
+    Interpolator<T> interpolator;
 
-        context = pc; setInterpolator(ip);
+    void init(T _value) {
+        val = _value; elapsedTime = 0;
+        loopType = LOOP_START; incFactor = FORWARD;
+        stat = RUNNING;
     }
 
     void reset() {
@@ -235,24 +217,22 @@ class PropertyAnimator {
 template <typename T>
 class AnimatorRegistry {
  private:
+    typedef typename std::vector<PropertyAnimator<T>*>::iterator Iterator;
     std::vector<PropertyAnimator<T>*> animators;
-    typename std::vector<PropertyAnimator<T>*>::iterator itr;
 
  public:
     AnimatorRegistry() {}
 
+    // Iterators are local so that registries may be stepped from several threads
     #define LOOP_ITR(v) \
-        for (v = animators.begin(); v != animators.end(); ++v)
+        for (Iterator v = animators.begin(); v != animators.end(); ++v)
 
     void add(PropertyAnimator<T>* anim) {
         animators.push_back(anim);
     }
 
-    PropertyAnimator<T> remove(PropertyAnimator<T>* anim) {
-        LOOP_ITR(itr) {
-            if (*itr == anim) { break; }
-        }
-
+    void remove(PropertyAnimator<T>* anim) {
+        Iterator itr = std::find(animators.begin(), animators.end(), anim);
         if (itr != animators.end())
             animators.erase(itr);
     }
@@ -0,0 +1,269 @@
+#ifndef __ANIM_SYSTEM_H__
+#define __ANIM_SYSTEM_H__
+
+/**
+ * Data oriented animation system
+ * @author: Methusael Murmu
+ */
+
+#include <base_jobs.h>
+#include <animator/anim.h>
+
+#include <vector>
+
+namespace anim {
+
+#define ANIM_INTERPOLATOR_SZ 3
+#define ANIM_LOOP_SZ 3
+#define ANIM_STEP_GRAIN 4096  // Properties per job of a parallel step
+
+// Stable reference to a property animated by an AnimationSystem
+typedef GLuint AnimHandle;
+
+/* Steps many float properties at once
+ * Properties are kept in structure of arrays batches, one per interpolator and
+ * loop type, so each batch is stepped by a branch free loop the compiler can
+ * vectorize. Disjoint ranges may be stepped concurrently (stepRange); handles
+ * stay valid while others are added and removed */
+class AnimationSystem {
+ public:
+    AnimationSystem() {}
+
+    AnimHandle add(GLfloat _init, GLfloat _final, GLfloat _duration,
+                   InterpolatorType _ip = LINEAR, AnimatorLoopType _loop = LOOP_START) {
+        GLuint b = _ip * ANIM_LOOP_SZ + _loop;
+        Batch& batch = batches[b];
+
+        AnimHandle handle;
+        if (freeHandles.empty()) {
+            handle = slots.size();
+            slots.push_back(Slot());
+        } else {
+            handle = freeHandles.back();
+            freeHandles.pop_back();
+        }
+        slots[handle].batch = b;
+        slots[handle].index = batch.size();
+
+        batch.init.push_back(_init);
+        batch.final.push_back(_final);
+        batch.duration.push_back(_duration);
+        batch.invDuration.push_back(1.0f / _duration);
+        batch.elapsed.push_back(0.0f);
+        batch.dir.push_back(1.0f);
+        batch.running.push_back(1.0f);
+        batch.value.push_back(_init);
+        batch.paused.push_back(0);
+        batch.owner.push_back(handle);
+        return handle;
+    }
+
+    // Moves the last property of the batch into the freed place
+    void remove(AnimHandle _handle) {
+        Slot& slot = slots[_handle];
+        Batch& batch = batches[slot.batch];
+        GLuint last = batch.size() - 1;
+
+        batch.moveTo(last, slot.index);
+        slots[batch.owner[slot.index]].index = slot.index;
+        batch.popBack();
+
+        freeHandles.push_back(_handle);
+    }
+
+    void clear() {
+        for (GLuint b = 0; b < kBatchCount; ++b) batches[b] = Batch();
+        slots.clear(); freeHandles.clear();
+    }
+
+    // Getters
+    inline GLfloat value(AnimHandle _h) const { return at(_h, &Batch::value); }
+    inline AnimatorStatus status(AnimHandle _h) const {
+        const Slot& s = slots[_h];
+        if (batches[s.batch].running[s.index] != 0.0f) return RUNNING;
+        return batches[s.batch].paused[s.index] ? PAUSED : STOPPED;
+    }
+    // Total number of animated properties
+    GLuint size() const {
+        GLuint sz = 0;
+        for (GLuint b = 0; b < kBatchCount; ++b) sz += batches[b].size();
+        return sz;
+    }
+
+    void set(AnimHandle _h, GLfloat _init, GLfloat _final, GLfloat _duration) {
+        const Slot& s = slots[_h];
+        Batch& batch = batches[s.batch];
+        batch.init[s.index] = _init; batch.final[s.index] = _final;
+        batch.duration[s.index] = _duration;
+        batch.invDuration[s.index] = 1.0f / _duration;
+    }
+
+    void play(AnimHandle _h) { setStatus(_h, RUNNING); }
+    void pause(AnimHandle _h) { setStatus(_h, PAUSED); }
+    void stop(AnimHandle _h) { setStatus(_h, STOPPED); }
+
+    void playAll() { setStatusAll(RUNNING); }
+    void pauseAll() { setStatusAll(PAUSED); }
+    void stopAll() { setStatusAll(STOPPED); }
+
+    void step(GLfloat _dt) { stepRange(0, size(), _dt); }
+
+    /* Steps properties [_begin, _end) of all batches taken back to back
+     * Safe to call concurrently for disjoint ranges */
+    void stepRange(GLuint _begin, GLuint _end, GLfloat _dt) {
+        GLuint base = 0;
+        for (GLuint b = 0; b < kBatchCount && base < _end; ++b) {
+            GLuint sz = batches[b].size();
+            GLuint lo = std::max(_begin, base), hi = std::min(_end, base + sz);
+            if (lo < hi) stepFn(b)(batches[b], lo - base, hi - base, _dt);
+            base += sz;
+        }
+    }
+
+    // Splits a step into ranges of ANIM_STEP_GRAIN properties run as jobs
+    void stepParallel(GLfloat _dt, jobs::JobSystem& _jobs = jobs::JobSystem::instance()) {
+        _jobs.parallelFor(0, size(), ANIM_STEP_GRAIN, [this, _dt](GLuint _begin, GLuint _end) {
+            stepRange(_begin, _end, _dt);
+        });
+    }
+
+ private:
+    static const GLuint kBatchCount = ANIM_INTERPOLATOR_SZ * ANIM_LOOP_SZ;
+
+    struct Batch {
+        std::vector<GLfloat> init, final, duration, invDuration;
+        std::vector<GLfloat> elapsed, dir, running, value;  // dir: +-1, running: 0 or 1
+        std::vector<GLubyte> paused;                        // Tells PAUSED from STOPPED
+        std::vector<AnimHandle> owner;
+
+        inline GLuint size() const { return value.size(); }
+
+        void moveTo(GLuint _src, GLuint _dst) {
+            init[_dst] = init[_src]; final[_dst] = final[_src];
+            duration[_dst] = duration[_src]; invDuration[_dst] = invDuration[_src];
+            elapsed[_dst] = elapsed[_src]; dir[_dst] = dir[_src];
+            running[_dst] = running[_src]; value[_dst] = value[_src];
+            paused[_dst] = paused[_src]; owner[_dst] = owner[_src];
+        }
+
+        void popBack() {
+            init.pop_back(); final.pop_back(); duration.pop_back(); invDuration.pop_back();
+            elapsed.pop_back(); dir.pop_back(); running.pop_back(); value.pop_back();
+            paused.pop_back(); owner.pop_back();
+        }
+    };
+
+    struct Slot { GLuint batch, index; };
+
+    typedef void (*StepFn)(Batch&, GLuint, GLuint, GLfloat);
+
+    Batch batches[kBatchCount];
+    std::vector<Slot> slots;
+    std::vector<AnimHandle> freeHandles;
+
+    inline GLfloat at(AnimHandle _h, std::vector<GLfloat> Batch::*_field) const {
+        const Slot& s = slots[_h];
+        return (batches[s.batch].*_field)[s.index];
+    }
+
+    void setStatus(AnimHandle _h, AnimatorStatus _status) {
+        const Slot& s = slots[_h];
+        setStatus(batches[s.batch], s.index, _status);
+    }
+
+    void setStatusAll(AnimatorStatus _status) {
+        for (GLuint b = 0; b < kBatchCount; ++b)
+            for (GLuint i = 0; i < batches[b].size(); ++i)
+                setStatus(batches[b], i, _status);
+    }
+
+    static void setStatus(Batch& _batch, GLuint _i, AnimatorStatus _status) {
+        _batch.running[_i] = _status == RUNNING ? 1.0f : 0.0f;
+        _batch.paused[_i] = _status == PAUSED;
+        if (_status == STOPPED) {
+            _batch.elapsed[_i] = 0.0f;
+            _batch.dir[_i] = 1.0f;
+        }
+    }
+
+    /* sin(2 pi x) for x in [0, 1], branch free parabolic fit (error < 0.001)
+     * Unlike libm sinf, it keeps the step loops vectorizable */
+    static inline GLfloat sinTurn(GLfloat _x) {
+        GLfloat t = _x - static_cast<GLfloat>(static_cast<GLint>(_x + 0.5f));  // [-0.5, 0.5]
+        GLfloat y = 8.0f * t - 16.0f * t * fabsf(t);
+        return 0.225f * (y * fabsf(y) - y) + y;
+    }
+
+    template <GLuint IP>
+    static inline GLfloat ease(GLfloat _frac) {
+        switch (IP) {
+            case SINE: return (sinTurn(_frac) + 1.0f) * 0.5f;
+            case COSINE: return (sinTurn(_frac + 0.25f) + 1.0f) * 0.5f;
+            default: return _frac;
+        }
+    }
+
+    /* Same semantics as PropertyAnimator::step, one batch range at a time
+     * Status tests are 0/1 masks folded into arithmetic so the loop has no
+     * branches left to stop vectorization */
+    template <GLuint IP, GLuint LOOP>
+    static void stepBatch(Batch& _b, GLuint _begin, GLuint _end, GLfloat _dt) {
+        stepKernel<IP, LOOP>(&_b.init[_begin], &_b.final[_begin],
+            &_b.duration[_begin], &_b.invDuration[_begin], &_b.elapsed[_begin],
+            &_b.dir[_begin], &_b.running[_begin], &_b.value[_begin], _end - _begin, _dt);
+    }
+
+    // Restrict only holds for parameters, hence the separate kernel
+    template <GLuint IP, GLuint LOOP>
+    static void stepKernel(const GLfloat* __restrict init, const GLfloat* __restrict final,
+                           const GLfloat* __restrict dur, const GLfloat* __restrict invDur,
+                           GLfloat* __restrict elapsed, GLfloat* __restrict dir,
+                           GLfloat* __restrict running, GLfloat* __restrict value,
+                           GLint n, GLfloat _dt) {
+        for (GLint i = 0; i < n; ++i) {
+            GLfloat run = running[i], e = elapsed[i], d = dur[i], fac = dir[i];
+
+            GLfloat v = LINEAR_IP(ease<IP>(e * invDur[i]), init[i], final[i]);
+            value[i] = run * v + (1.0f - run) * value[i];
+
+            if (LOOP == LOOP_REVERSE) {
+                GLfloat flip =
+                    ((e >= d) & (fac > 0.0f)) | ((e <= 0.0f) & (fac < 0.0f)) ? 1.0f : 0.0f;
+                fac -= 2.0f * run * flip * fac;
+            }
+
+            GLfloat next = e + fac * _dt * run;
+            if (LOOP == LOOP_START) {
+                next -= d * static_cast<GLfloat>(static_cast<GLint>(next * invDur[i]));
+            } else {
+                next = std::min(std::max(next, 0.0f), d);
+            }
+
+            if (LOOP == LOOP_ONCE) {  // Finished properties stop and rewind
+                GLfloat done = (run != 0.0f) & (e >= d) ? 1.0f : 0.0f;
+                next *= 1.0f - done;
+                running[i] = run - done;
+            }
+
+            elapsed[i] = next;
+            dir[i] = fac;
+        }
+    }
+
+    // Indexed by interpolator * ANIM_LOOP_SZ + loop type, like the batches
+    static StepFn stepFn(GLuint _batch) {
+        static const StepFn fns[kBatchCount] = {
+            &stepBatch<LINEAR, LOOP_ONCE>, &stepBatch<LINEAR, LOOP_START>,
+            &stepBatch<LINEAR, LOOP_REVERSE>,
+            &stepBatch<SINE, LOOP_ONCE>, &stepBatch<SINE, LOOP_START>,
+            &stepBatch<SINE, LOOP_REVERSE>,
+            &stepBatch<COSINE, LOOP_ONCE>, &stepBatch<COSINE, LOOP_START>,
+            &stepBatch<COSINE, LOOP_REVERSE>
+        };
+        return fns[_batch];
+    }
+};
+
+}  // namespace anim
+
+#endif
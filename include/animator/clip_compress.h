@@ -0,0 +1,454 @@
+#ifndef __ANIM_CLIP_COMPRESS_H__
+#define __ANIM_CLIP_COMPRESS_H__
+
+/**
+ * Animation clip compression
+ * @author: Methusael Murmu
+ */
+
+#include <animator/skeleton.h>
+
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+namespace anim {
+
+#define CLIP_BLOB_MAGIC 0x50494c43  // "CLIP"
+#define CLIP_BLOB_VERSION 1
+#define CLIP_RESAMPLE_RATE 30.0f    // Keys per second for non linear tracks
+#define CLIP_TIME_MAX 65535.0f
+#define CLIP_VALUE_MAX 65535.0f
+#define CLIP_QUAT_MAX 32767.0f      // 15 bits per smallest-three component
+
+/* Tolerances for dropping keys: units for translations, radians for
+ * rotations, ratio for scales */
+struct ClipCompression {
+    ClipCompression():
+        translationError(0.001f), rotationError(0.0005f), scaleError(0.001f) {}
+
+    GLfloat translationError, rotationError, scaleError;
+};
+
+// Size and largest sampled error of a compressed clip against its source
+struct ClipReport {
+    std::string name;
+    GLuint rawKeys, keys;
+    size_t rawBytes, bytes;
+    GLfloat translationError, rotationError, scaleError;
+};
+
+/* Blob layout, every field 4 byte aligned and located by offsets only so the
+ * blob can be memory mapped as is:
+ *   header   u32 magic, u32 version, f32 duration, u32 channels
+ *   channel  u32 joint, u32 offset[3] for translation, rotation, scale (0: none)
+ *   vec3     u32 keys, f32 min[3], f32 step[3], u16 time[keys] (even), u16 value[3 * keys]
+ *   quat     u32 keys, u16 time[keys] (even), u16 value[3 * keys] (smallest three)
+ * Key times are fractions of the duration */
+class CompressedClip {
+ public:
+    CompressedClip(): base(NULL), sz(0) {}
+
+    /* Wraps a blob without copying it, _data must outlive this clip
+     * Every track is checked to lie within _size, so sampling a truncated or
+     * corrupt blob can't read past it */
+    bool load(const void* _data, size_t _size) {
+        base = NULL; sz = 0;
+
+        const GLuint* header = static_cast<const GLuint*>(_data);
+        if (_size < 4 * sizeof(GLuint) || header[0] != CLIP_BLOB_MAGIC ||
+            header[1] != CLIP_BLOB_VERSION || _size < 16 + 16 * static_cast<size_t>(header[3])) {
+            fprintf(stderr, "CompressedClip: not a version %d clip blob\n", CLIP_BLOB_VERSION);
+            return false;
+        }
+
+        const GLubyte* bytes = static_cast<const GLubyte*>(_data);
+        for (GLuint c = 0; c < header[3]; ++c) {
+            const GLuint* entry = reinterpret_cast<const GLuint*>(bytes + 16 + 16 * c);
+            for (GLuint t = 1; t < 4; ++t) {
+                size_t offset = entry[t];
+                if (!offset) continue;
+
+                GLuint keys = offset % 4 || offset + sizeof(GLuint) > _size ? 0 :
+                    reinterpret_cast<const GLuint*>(bytes + offset)[0];
+                if (!keys || offset + trackBytes(t == 2, keys) > _size) {
+                    fprintf(stderr, "CompressedClip: track %u of channel %u runs past "
+                        "the %lu byte blob\n", t, c, static_cast<unsigned long>(_size));
+                    return false;
+                }
+            }
+        }
+
+        base = bytes; sz = _size;
+        return true;
+    }
+
+    inline bool valid() const { return base != NULL; }
+    inline size_t bytes() const { return sz; }
+    inline GLfloat duration() const { return reinterpret_cast<const GLfloat*>(base)[2]; }
+    inline GLuint channelCount() const { return words(0)[3]; }
+    inline GLuint joint(GLuint _channel) const { return channel(_channel)[0]; }
+
+    // Keys left over all tracks
+    GLuint keyCount() const {
+        GLuint keys = 0;
+        for (GLuint c = 0; c < channelCount(); ++c)
+            for (GLuint t = 1; t < 4; ++t)
+                if (channel(c)[t]) keys += words(channel(c)[t])[0];
+        return keys;
+    }
+
+    // Channel samples at _time, false when the channel doesn't key that component
+    bool translation(GLuint _channel, GLfloat _time, TrackCursor& _cursor, glm::vec3& _out) const {
+        GLuint offset = channel(_channel)[1];
+        if (offset) _out = sampleVec3(offset, keyTime(_time), _cursor);
+        return offset != 0;
+    }
+
+    bool rotation(GLuint _channel, GLfloat _time, TrackCursor& _cursor, glm::quat& _out) const {
+        GLuint offset = channel(_channel)[2];
+        if (offset) _out = sampleQuat(offset, keyTime(_time), _cursor);
+        return offset != 0;
+    }
+
+    bool scale(GLuint _channel, GLfloat _time, TrackCursor& _cursor, glm::vec3& _out) const {
+        GLuint offset = channel(_channel)[3];
+        if (offset) _out = sampleVec3(offset, keyTime(_time), _cursor);
+        return offset != 0;
+    }
+
+    /* Same as SkeletonPose::sample for a raw clip
+     * Channels of joints the pose's skeleton doesn't have are skipped, the
+     * blob may have been built for another one */
+    void sample(SkeletonPose& _pose, GLfloat _time) const {
+        GLuint channels = channelCount(), joints = _pose.jointCount();
+        std::vector<TrackCursor>& cursors = _pose.cursorsFor(base, channels * 3);
+        if (duration() > 0.0f) _time = fmodf(_time, duration());
+
+        glm::vec3 v; glm::quat q;
+        for (GLuint c = 0; c < channels; ++c) {
+            GLuint j = joint(c);
+            if (j >= joints) continue;
+            if (translation(c, _time, cursors[3 * c], v)) _pose.translation(j, v);
+            if (rotation(c, _time, cursors[3 * c + 1], q)) _pose.rotation(j, q);
+            if (scale(c, _time, cursors[3 * c + 2], v)) _pose.scale(j, v);
+        }
+    }
+
+    // Smallest three: the largest component is dropped (kept positive) and
+    // rebuilt from the others, its index lives in the top bits of the first two
+    static void packQuat(const glm::quat& _q, GLushort* _out) {
+        GLfloat c[4] = { _q.x, _q.y, _q.z, _q.w };
+        GLuint largest = 0;
+        for (GLuint i = 1; i < 4; ++i)
+            if (fabsf(c[i]) > fabsf(c[largest])) largest = i;
+
+        GLfloat sign = c[largest] < 0.0f ? -1.0f : 1.0f;
+        for (GLuint i = 0, n = 0; i < 4; ++i) {
+            if (i == largest) continue;
+            GLfloat f = glm::clamp(sign * c[i] * static_cast<GLfloat>(M_SQRT2), -1.0f, 1.0f);
+            _out[n++] = static_cast<GLushort>((f * 0.5f + 0.5f) * CLIP_QUAT_MAX + 0.5f);
+        }
+        _out[0] |= (largest & 1) << 15;
+        _out[1] |= (largest >> 1) << 15;
+    }
+
+    static glm::quat unpackQuat(const GLushort* _in) {
+        GLuint largest = (_in[0] >> 15) | ((_in[1] >> 15) << 1);
+        GLfloat c[4], sum = 0.0f;
+        for (GLuint i = 0, n = 0; i < 4; ++i) {
+            if (i == largest) continue;
+            c[i] = ((_in[n++] & 0x7fff) / CLIP_QUAT_MAX * 2.0f - 1.0f) * static_cast<GLfloat>(M_SQRT1_2);
+            sum += c[i] * c[i];
+        }
+        c[largest] = sqrtf(std::max(0.0f, 1.0f - sum));
+        return glm::quat(c[3], c[0], c[1], c[2]);
+    }
+
+    // Blends by normalized lerp along the shorter arc, cheaper than slerp
+    static glm::quat nlerp(const glm::quat& _a, const glm::quat& _b, GLfloat _t) {
+        GLfloat sign = glm::dot(_a, _b) < 0.0f ? -1.0f : 1.0f;
+        return glm::normalize(_a * (1.0f - _t) + _b * (sign * _t));
+    }
+
+ private:
+    const GLubyte* base;
+    size_t sz;
+
+    inline const GLuint* words(GLuint _offset) const {
+        return reinterpret_cast<const GLuint*>(base + _offset);
+    }
+    inline const GLuint* channel(GLuint _channel) const { return words(16 + 16 * _channel); }
+
+    // Bytes of a track block with _keys keys, laid out as documented above
+    static inline size_t trackBytes(bool _quat, GLuint _keys) {
+        size_t times = 2 * ((static_cast<size_t>(_keys) + 1) & ~static_cast<size_t>(1));
+        return sizeof(GLuint) + (_quat ? 0 : 6 * sizeof(GLfloat)) + times + 6 * static_cast<size_t>(_keys);
+    }
+    inline GLfloat keyTime(GLfloat _time) const {
+        return duration() > 0.0f ? _time / duration() * CLIP_TIME_MAX : 0.0f;
+    }
+
+    // Segment [k, k + 1] holding _qt, or the clamped end key when there is none
+    static GLuint seek(const GLushort* _times, GLuint _keys, GLfloat _qt,
+                       TrackCursor& _cursor, GLfloat& _frac) {
+        _frac = 0.0f;
+        if (_keys < 2 || _qt <= _times[0]) return 0;
+        if (_qt >= _times[_keys - 1]) return _keys - 1;
+
+        GLuint k = std::min(_cursor.key, _keys - 2);
+        bool found = false;
+        if (_times[k] <= _qt) {
+            for (GLuint n = 0; n < TRACK_CURSOR_SCAN && _times[k + 1] <= _qt; ++n) ++k;
+            found = _times[k + 1] > _qt;
+        }
+        if (!found) k = std::upper_bound(_times, _times + _keys, _qt) - _times - 1;
+
+        _cursor.key = k;
+        _frac = (_qt - _times[k]) / (_times[k + 1] - _times[k]);
+        return k;
+    }
+
+    glm::vec3 sampleVec3(GLuint _offset, GLfloat _qt, TrackCursor& _cursor) const {
+        const GLuint* block = words(_offset);
+        GLuint keys = block[0];
+        const GLfloat* range = reinterpret_cast<const GLfloat*>(block + 1);
+        const GLushort* times = reinterpret_cast<const GLushort*>(block + 7);
+        const GLushort* values = times + ((keys + 1) & ~1u);
+
+        GLfloat frac;
+        GLuint k = seek(times, keys, _qt, _cursor, frac);
+        const GLushort* a = values + 3 * k;
+        glm::vec3 va(range[0] + a[0] * range[3], range[1] + a[1] * range[4], range[2] + a[2] * range[5]);
+        if (frac == 0.0f) return va;
+
+        const GLushort* b = a + 3;
+        glm::vec3 vb(range[0] + b[0] * range[3], range[1] + b[1] * range[4], range[2] + b[2] * range[5]);
+        return LINEAR_IP(frac, va, vb);
+    }
+
+    glm::quat sampleQuat(GLuint _offset, GLfloat _qt, TrackCursor& _cursor) const {
+        const GLuint* block = words(_offset);
+        GLuint keys = block[0];
+        const GLushort* times = reinterpret_cast<const GLushort*>(block + 1);
+        const GLushort* values = times + ((keys + 1) & ~1u);
+
+        GLfloat frac;
+        GLuint k = seek(times, keys, _qt, _cursor, frac);
+        glm::quat qa = unpackQuat(values + 3 * k);
+        return frac == 0.0f ? qa : nlerp(qa, unpackQuat(values + 3 * k + 3), frac);
+    }
+};
+
+inline void sampleClip(SkeletonPose& _pose, const CompressedClip& _clip, GLfloat _time) {
+    _clip.sample(_pose, _time);
+}
+
+typedef BasicPoseJob<CompressedClip> PackedPoseJob;
+
+// Prints one line per clip: keys, bytes and worst error
+inline void printClipReport(const ClipReport& _report) {
+    fprintf(stdout, "Clip %s: %u -> %u keys, %.1f -> %.1f KiB (%.1fx), "
+        "max error %.5f units, %.4f deg, %.5f scale\n", _report.name.c_str(),
+        _report.rawKeys, _report.keys, _report.rawBytes / 1024.0, _report.bytes / 1024.0,
+        _report.bytes ? (double) _report.rawBytes / _report.bytes : 0.0,
+        _report.translationError, glm::degrees(_report.rotationError), _report.scaleError);
+}
+
+/* Builds clip blobs: drops every key linear interpolation of its neighbours
+ * reproduces within tolerance, then quantizes what is left */
+class ClipCompressor {
+ public:
+    static void compress(const AnimationClip& _clip, const ClipCompression& _settings,
+                         std::vector<GLubyte>& _blob) {
+        GLuint channels = _clip.joints.size();
+        _blob.assign(16 + 16 * channels, 0);
+
+        GLuint* header = reinterpret_cast<GLuint*>(&_blob[0]);
+        header[0] = CLIP_BLOB_MAGIC; header[1] = CLIP_BLOB_VERSION;
+        memcpy(&header[2], &_clip.duration, sizeof(GLfloat));
+        header[3] = channels;
+
+        GLuint entry[4];
+        for (GLuint c = 0; c < channels; ++c) {
+            entry[0] = _clip.joints[c];
+            entry[1] = writeVec3(_clip.translations[c], _clip.duration, _settings.translationError, _blob);
+            entry[2] = writeQuat(_clip.rotations[c], _clip.duration, _settings.rotationError, _blob);
+            entry[3] = writeVec3(_clip.scales[c], _clip.duration, _settings.scaleError, _blob);
+            memcpy(&_blob[16 + 16 * c], entry, sizeof(entry));
+        }
+    }
+
+    // Compares both clips every 1 / _rate seconds
+    static ClipReport measure(const AnimationClip& _raw, const CompressedClip& _packed,
+                              GLfloat _rate = 60.0f) {
+        ClipReport report;
+        report.name = _raw.name;
+        report.rawKeys = report.keys = 0;
+        report.rawBytes = 0; report.bytes = _packed.bytes();
+        report.translationError = report.rotationError = report.scaleError = 0.0f;
+
+        glm::vec3 v; glm::quat q;
+        GLuint steps = std::max(1.0f, _raw.duration * _rate);
+        for (GLuint c = 0; c < _raw.joints.size(); ++c) {
+            const Track<glm::vec3>& t = _raw.translations[c];
+            const Track<glm::quat>& r = _raw.rotations[c];
+            const Track<glm::vec3>& s = _raw.scales[c];
+            report.rawKeys += t.keyCount() + r.keyCount() + s.keyCount();
+            report.rawBytes += t.memoryUsage() + r.memoryUsage() + s.memoryUsage();
+
+            TrackCursor cursors[6];
+            for (GLuint i = 0; i <= steps; ++i) {
+                GLfloat time = std::min(_raw.duration * i / steps, _raw.duration);
+                if (_packed.translation(c, time, cursors[0], v))
+                    report.translationError = std::max(report.translationError,
+                        glm::length(v - t.evaluate(time, cursors[3])));
+                if (_packed.rotation(c, time, cursors[1], q))
+                    report.rotationError = std::max(report.rotationError,
+                        angle(q, r.evaluate(time, cursors[4])));
+                if (_packed.scale(c, time, cursors[2], v))
+                    report.scaleError = std::max(report.scaleError,
+                        glm::length(v - s.evaluate(time, cursors[5])));
+            }
+        }
+
+        report.keys = _packed.keyCount();
+        return report;
+    }
+
+ private:
+    static GLfloat angle(const glm::quat& _a, const glm::quat& _b) {
+        return 2.0f * acosf(std::min(1.0f, fabsf(glm::dot(_a, _b))));
+    }
+
+    static void align(std::vector<GLubyte>& _blob) {
+        _blob.resize((_blob.size() + 3) & ~static_cast<size_t>(3), 0);
+    }
+
+    template <typename T>
+    static void append(std::vector<GLubyte>& _blob, const T* _data, size_t _count) {
+        const GLubyte* bytes = reinterpret_cast<const GLubyte*>(_data);
+        _blob.insert(_blob.end(), bytes, bytes + _count * sizeof(T));
+    }
+
+    // Keys of a track as linear ones, other modes are resampled
+    template <typename T>
+    static void linearKeys(const Track<T>& _track, GLfloat _duration,
+                           std::vector<GLfloat>& _times, std::vector<T>& _values) {
+        _times.clear(); _values.clear();
+        if (_track.interpolation() == KEY_LINEAR) {
+            for (GLuint k = 0; k < _track.keyCount(); ++k) {
+                _times.push_back(_track.keyTime(k));
+                _values.push_back(_track.keyValue(k));
+            }
+            return;
+        }
+
+        TrackCursor cursor;
+        GLuint steps = std::max(1.0f, _duration * CLIP_RESAMPLE_RATE);
+        for (GLuint i = 0; i <= steps; ++i) {
+            _times.push_back(_duration * i / steps);
+            _values.push_back(_track.evaluate(_times.back(), cursor));
+        }
+    }
+
+    static GLfloat error(const glm::vec3& _a, const glm::vec3& _b) { return glm::length(_a - _b); }
+    static GLfloat error(const glm::quat& _a, const glm::quat& _b) { return angle(_a, _b); }
+    static glm::vec3 blend(const glm::vec3& _a, const glm::vec3& _b, GLfloat _t) {
+        return LINEAR_IP(_t, _a, _b);
+    }
+    static glm::quat blend(const glm::quat& _a, const glm::quat& _b, GLfloat _t) {
+        return CompressedClip::nlerp(_a, _b, _t);
+    }
+
+    // Greedily stretches each segment as long as the keys it skips stay in tolerance
+    template <typename T>
+    static void reduce(const std::vector<GLfloat>& _times, const std::vector<T>& _values,
+                       GLfloat _tolerance, std::vector<GLuint>& _kept) {
+        GLuint n = _times.size();
+        _kept.assign(1, 0);
+        if (n < 2) return;
+
+        GLuint a = 0;
+        for (GLuint b = 2; b < n; ++b) {
+            bool fits = true;
+            for (GLuint k = a + 1; k < b && fits; ++k) {
+                GLfloat dt = _times[b] - _times[a];
+                GLfloat t = dt > 0.0f ? (_times[k] - _times[a]) / dt : 0.0f;
+                fits = error(blend(_values[a], _values[b], t), _values[k]) <= _tolerance;
+            }
+            if (!fits) { a = b - 1; _kept.push_back(a); }
+        }
+        _kept.push_back(n - 1);
+    }
+
+    static void writeTimes(const std::vector<GLfloat>& _times, const std::vector<GLuint>& _kept,
+                           GLfloat _duration, std::vector<GLubyte>& _blob) {
+        std::vector<GLushort> q((_kept.size() + 1) & ~1u, 0);
+        for (GLuint k = 0; k < _kept.size(); ++k) {
+            GLfloat f = _duration > 0.0f ? _times[_kept[k]] / _duration : 0.0f;
+            q[k] = static_cast<GLushort>(glm::clamp(f, 0.0f, 1.0f) * CLIP_TIME_MAX + 0.5f);
+        }
+        append(_blob, &q[0], q.size());
+    }
+
+    static GLuint writeVec3(const Track<glm::vec3>& _track, GLfloat _duration,
+                            GLfloat _tolerance, std::vector<GLubyte>& _blob) {
+        if (_track.keyCount() == 0) return 0;
+
+        std::vector<GLfloat> times; std::vector<glm::vec3> values;
+        std::vector<GLuint> kept;
+        linearKeys(_track, _duration, times, values);
+        reduce(times, values, _tolerance, kept);
+
+        glm::vec3 lo = values[kept[0]], hi = lo;
+        for (GLuint k = 1; k < kept.size(); ++k) {
+            lo = glm::min(lo, values[kept[k]]); hi = glm::max(hi, values[kept[k]]);
+        }
+        glm::vec3 step = (hi - lo) / CLIP_VALUE_MAX;
+
+        align(_blob);
+        GLuint offset = _blob.size(), keys = kept.size();
+        GLfloat range[6] = { lo.x, lo.y, lo.z, step.x, step.y, step.z };
+        append(_blob, &keys, 1);
+        append(_blob, range, 6);
+        writeTimes(times, kept, _duration, _blob);
+
+        std::vector<GLushort> q(3 * keys);
+        for (GLuint k = 0; k < keys; ++k) {
+            for (GLuint c = 0; c < 3; ++c) {
+                GLfloat f = step[c] > 0.0f ? (values[kept[k]][c] - lo[c]) / step[c] : 0.0f;
+                q[3 * k + c] = static_cast<GLushort>(f + 0.5f);
+            }
+        }
+        append(_blob, &q[0], q.size());
+        return offset;
+    }
+
+    static GLuint writeQuat(const Track<glm::quat>& _track, GLfloat _duration,
+                            GLfloat _tolerance, std::vector<GLubyte>& _blob) {
+        if (_track.keyCount() == 0) return 0;
+
+        std::vector<GLfloat> times; std::vector<glm::quat> values;
+        std::vector<GLuint> kept;
+        linearKeys(_track, _duration, times, values);
+        reduce(times, values, _tolerance, kept);
+
+        align(_blob);
+        GLuint offset = _blob.size(), keys = kept.size();
+        append(_blob, &keys, 1);
+        writeTimes(times, kept, _duration, _blob);
+
+        std::vector<GLushort> q(3 * keys);
+        for (GLuint k = 0; k < keys; ++k)
+            CompressedClip::packQuat(values[kept[k]], &q[3 * k]);
+        append(_blob, &q[0], q.size());
+        return offset;
+    }
+};
+
+}  // namespace anim
+
+#endif
@@ -0,0 +1,197 @@
+#ifndef __ANIM_SKELETON_H__
+#define __ANIM_SKELETON_H__
+
+/**
+ * Skeletons, animation clips and skinning palettes
+ * @author: Methusael Murmu
+ */
+
+#include <base_jobs.h>
+#include <animator/track.h>
+
+#include <external/glm/mat4x4.hpp>
+#include <external/glm/gtc/quaternion.hpp>
+
+#if defined(__SSE__)
+#include <xmmintrin.h>
+#endif
+
+#include <string>
+#include <vector>
+
+namespace anim {
+
+#define SKIN_MAX_INFLUENCE 4
+
+/* Joint hierarchy as arrays per attribute
+ * Parents always come before their children, a root's parent is -1 */
+struct Skeleton {
+    std::vector<GLint> parents;
+    std::vector<std::string> names;
+    std::vector<glm::vec3> bindTranslations, bindScales;
+    std::vector<glm::quat> bindRotations;
+    std::vector<glm::mat4> inverseBind;  // Mesh to joint space, identity for plain nodes
+    glm::mat4 rootInverse;               // Brings the skinned result back to model space
+
+    Skeleton(): rootInverse(1.0f) {}
+
+    inline GLuint size() const { return parents.size(); }
+
+    GLuint add(const std::string& _name, GLint _parent,
+               const glm::vec3& _t, const glm::quat& _r, const glm::vec3& _s) {
+        parents.push_back(_parent); names.push_back(_name);
+        bindTranslations.push_back(_t); bindRotations.push_back(_r);
+        bindScales.push_back(_s);
+        inverseBind.push_back(glm::mat4(1.0f));
+        return parents.size() - 1;
+    }
+
+    GLint find(const std::string& _name) const {
+        for (GLuint j = 0; j < names.size(); ++j)
+            if (names[j] == _name) return j;
+        return -1;
+    }
+};
+
+// Keyed transforms of some joints of a skeleton, times in seconds
+struct AnimationClip {
+    AnimationClip(): duration(0.0f) {}
+
+    std::string name;
+    GLfloat duration;
+
+    // One channel per animated joint
+    std::vector<GLuint> joints;
+    std::vector<Track<glm::vec3> > translations, scales;
+    std::vector<Track<glm::quat> > rotations;
+};
+
+// out = a * b, safe for out aliasing either operand
+inline void mulMat4(const glm::mat4& _a, const glm::mat4& _b, glm::mat4& _out) {
+#if defined(__SSE__)
+    __m128 a0 = _mm_loadu_ps(&_a[0][0]), a1 = _mm_loadu_ps(&_a[1][0]);
+    __m128 a2 = _mm_loadu_ps(&_a[2][0]), a3 = _mm_loadu_ps(&_a[3][0]);
+    __m128 col[4];
+    for (GLuint c = 0; c < 4; ++c) {
+        col[c] = _mm_add_ps(
+            _mm_add_ps(_mm_mul_ps(a0, _mm_set1_ps(_b[c][0])), _mm_mul_ps(a1, _mm_set1_ps(_b[c][1]))),
+            _mm_add_ps(_mm_mul_ps(a2, _mm_set1_ps(_b[c][2])), _mm_mul_ps(a3, _mm_set1_ps(_b[c][3]))));
+    }
+    for (GLuint c = 0; c < 4; ++c) _mm_storeu_ps(&_out[c][0], col[c]);
+#else
+    _out = _a * _b;
+#endif
+}
+
+/* Pose of one character, local transforms kept as arrays per component
+ * Cursors follow the sampled clip so forward playback stays O(1) per key */
+class SkeletonPose {
+ public:
+    explicit SkeletonPose(const Skeleton* _skeleton = NULL): cursorOwner(NULL) {
+        if (_skeleton) setSkeleton(_skeleton);
+    }
+
+    void setSkeleton(const Skeleton* _skeleton) {
+        skeleton = _skeleton; cursorOwner = NULL;
+        reset();
+        globals.resize(skeleton->size());
+    }
+
+    // Back to the bind pose
+    void reset() {
+        translations = skeleton->bindTranslations;
+        rotations = skeleton->bindRotations;
+        scales = skeleton->bindScales;
+    }
+
+    // Poses the animated joints at _time, wrapped to the clip's duration
+    void sample(const AnimationClip& _clip, GLfloat _time) {
+        std::vector<TrackCursor>& cursors = cursorsFor(&_clip, _clip.joints.size() * 3);
+        if (_clip.duration > 0.0f) _time = fmodf(_time, _clip.duration);
+
+        for (GLuint c = 0; c < _clip.joints.size(); ++c) {
+            GLuint j = _clip.joints[c];
+            if (_clip.translations[c].keyCount())
+                translations[j] = _clip.translations[c].evaluate(_time, cursors[3 * c]);
+            if (_clip.rotations[c].keyCount())
+                rotations[j] = _clip.rotations[c].evaluate(_time, cursors[3 * c + 1]);
+            if (_clip.scales[c].keyCount())
+                scales[j] = _clip.scales[c].evaluate(_time, cursors[3 * c + 2]);
+        }
+    }
+
+    inline GLuint jointCount() const { return translations.size(); }
+
+    // Local transform of a joint, for clips sampled elsewhere
+    inline void translation(GLuint _joint, const glm::vec3& _t) { translations[_joint] = _t; }
+    inline void rotation(GLuint _joint, const glm::quat& _r) { rotations[_joint] = _r; }
+    inline void scale(GLuint _joint, const glm::vec3& _s) { scales[_joint] = _s; }
+
+    // Playback cursors, rewound whenever another clip is sampled
+    std::vector<TrackCursor>& cursorsFor(const void* _clip, GLuint _count) {
+        if (cursorOwner != _clip) {
+            cursorOwner = _clip;
+            cursors.assign(_count, TrackCursor());
+        }
+        return cursors;
+    }
+
+    // Writes one skinning matrix per joint: rootInverse * global * inverseBind
+    void palette(glm::mat4* _out) {
+        glm::mat4 local;
+        for (GLuint j = 0; j < globals.size(); ++j) {
+            local = glm::mat4_cast(rotations[j]);
+            local[0] *= scales[j].x; local[1] *= scales[j].y; local[2] *= scales[j].z;
+            local[3] = glm::vec4(translations[j], 1.0f);
+
+            GLint p = skeleton->parents[j];
+            mulMat4(p < 0 ? skeleton->rootInverse : globals[p], local, globals[j]);
+            mulMat4(globals[j], skeleton->inverseBind[j], _out[j]);
+        }
+    }
+
+ private:
+    const Skeleton* skeleton;
+    const void* cursorOwner;
+    std::vector<TrackCursor> cursors;
+
+    std::vector<glm::vec3> translations, scales;
+    std::vector<glm::quat> rotations;
+    std::vector<glm::mat4> globals;
+};
+
+inline void sampleClip(SkeletonPose& _pose, const AnimationClip& _clip, GLfloat _time) {
+    _pose.sample(_clip, _time);
+}
+
+// One character to pose and skin, Clip is any type sampleClip() accepts
+template <typename Clip>
+struct BasicPoseJob {
+    SkeletonPose* pose;
+    const Clip* clip;
+    GLfloat time;
+    glm::mat4* palette;
+};
+
+typedef BasicPoseJob<AnimationClip> PoseJob;
+
+template <typename Clip>
+void runPoseJobs(BasicPoseJob<Clip>* _jobs, GLuint _count) {
+    for (GLuint i = 0; i < _count; ++i) {
+        if (_jobs[i].clip) sampleClip(*_jobs[i].pose, *_jobs[i].clip, _jobs[i].time);
+        _jobs[i].pose->palette(_jobs[i].palette);
+    }
+}
+
+// Characters are independent, so they fan out over the job system
+template <typename Clip>
+void runPoseJobs(std::vector<BasicPoseJob<Clip> >& _jobs,
+                 jobs::JobSystem& _system = jobs::JobSystem::instance()) {
+    _system.parallelFor(0, _jobs.size(), 0, [&_jobs](GLuint _begin, GLuint _end) {
+        runPoseJobs(&_jobs[_begin], _end - _begin);
+    });
+}
+
+}  // namespace anim
+
+#endif
@@ -0,0 +1,253 @@
+#ifndef __ANIM_TRACK_H__
+#define __ANIM_TRACK_H__
+
+/**
+ * Keyframe tracks
+ * @author: Methusael Murmu
+ */
+
+#include <base_util.h>
+
+#include <math.h>
+#include <stdio.h>
+#include <external/glm/vec3.hpp>
+#include <external/glm/gtc/quaternion.hpp>
+
+#include <algorithm>
+#include <vector>
+
+namespace anim {
+
+enum KeyInterpolation { KEY_STEP, KEY_LINEAR, KEY_HERMITE, KEY_BEZIER };
+
+// Tracks read up to this many keys ahead of their cursor before searching
+#define TRACK_CURSOR_SCAN 4
+#define TRACK_QUANT_MAX 65535.0f
+
+/* Flattens key values to float components
+ * lerp blends two keys, fix repairs a value built component wise */
+template <typename T>
+struct KeyTraits;
+
+template <>
+struct KeyTraits<GLfloat> {
+    static const GLuint SZ = 1;
+    static void store(const GLfloat& _v, GLfloat* _out) { _out[0] = _v; }
+    static GLfloat load(const GLfloat* _in) { return _in[0]; }
+    static GLfloat lerp(const GLfloat& _a, const GLfloat& _b, GLfloat _t) {
+        return LINEAR_IP(_t, _a, _b);
+    }
+    static GLfloat fix(const GLfloat& _v) { return _v; }
+};
+
+template <>
+struct KeyTraits<glm::vec3> {
+    static const GLuint SZ = 3;
+    static void store(const glm::vec3& _v, GLfloat* _out) {
+        _out[0] = _v.x; _out[1] = _v.y; _out[2] = _v.z;
+    }
+    static glm::vec3 load(const GLfloat* _in) { return glm::vec3(_in[0], _in[1], _in[2]); }
+    static glm::vec3 lerp(const glm::vec3& _a, const glm::vec3& _b, GLfloat _t) {
+        return LINEAR_IP(_t, _a, _b);
+    }
+    static glm::vec3 fix(const glm::vec3& _v) { return _v; }
+};
+
+template <>
+struct KeyTraits<glm::quat> {
+    static const GLuint SZ = 4;
+    static void store(const glm::quat& _v, GLfloat* _out) {
+        _out[0] = _v.x; _out[1] = _v.y; _out[2] = _v.z; _out[3] = _v.w;
+    }
+    static glm::quat load(const GLfloat* _in) {
+        return glm::quat(_in[3], _in[0], _in[1], _in[2]);
+    }
+    static glm::quat lerp(const glm::quat& _a, const glm::quat& _b, GLfloat _t) {
+        return glm::slerp(_a, _b, _t);
+    }
+    // Splines run on the components, the result is renormalized
+    static glm::quat fix(const glm::quat& _v) { return glm::normalize(_v); }
+};
+
+/* Playback position of a track, one per playing instance
+ * Playback that moves forward finds its segment in O(1) amortized */
+struct TrackCursor {
+    TrackCursor(): key(0) {}
+    GLuint key;
+};
+
+/* Keys of a single animated value, sorted by time
+ * Hermite keys carry in/out tangents (units per second), Bezier keys carry
+ * in/out control values. quantize() packs the keys into 16 bits per component
+ * scaled to the range of each component over the track */
+template <typename T>
+class Track {
+    typedef KeyTraits<T> Traits;
+
+ public:
+    Track(KeyInterpolation _mode = KEY_LINEAR): mode(_mode) {
+        stride = Traits::SZ * (hasTangents() ? 3 : 1);
+    }
+
+    // Keys must be added in increasing time order, before quantize()
+    void addKey(GLfloat _time, const T& _value) {
+        if (mode == KEY_BEZIER) addKey(_time, _value, _value, _value);
+        else addKey(_time, _value, T(), T());
+    }
+
+    void addKey(GLfloat _time, const T& _value, const T& _in, const T& _out) {
+        if (quantized()) {
+            fprintf(stderr, "Track: key added after quantization\n");
+            return;
+        }
+
+        times.push_back(_time);
+        size_t at = data.size();
+        data.resize(at + stride);
+        Traits::store(_value, &data[at]);
+        if (hasTangents()) {
+            Traits::store(_in, &data[at + Traits::SZ]);
+            Traits::store(_out, &data[at + 2 * Traits::SZ]);
+        }
+    }
+
+    // Replaces the float keys by 16 bit ones
+    void quantize() {
+        if (quantized() || times.empty()) return;
+
+        GLuint keys = times.size();
+        qMin.assign(stride, 0.0f); qScale.assign(stride, 0.0f);
+        for (GLuint c = 0; c < stride; ++c) {
+            GLfloat lo = data[c], hi = data[c];
+            for (GLuint k = 1; k < keys; ++k) {
+                lo = std::min(lo, data[k * stride + c]);
+                hi = std::max(hi, data[k * stride + c]);
+            }
+            qMin[c] = lo; qScale[c] = (hi - lo) / TRACK_QUANT_MAX;
+        }
+
+        qData.resize(data.size());
+        for (GLuint i = 0; i < data.size(); ++i) {
+            GLuint c = i % stride;
+            GLfloat q = qScale[c] > 0.0f ? (data[i] - qMin[c]) / qScale[c] : 0.0f;
+            qData[i] = static_cast<GLushort>(q + 0.5f);
+        }
+
+        std::vector<GLfloat>().swap(data);
+    }
+
+    inline bool quantized() const { return !qData.empty(); }
+    inline GLuint keyCount() const { return times.size(); }
+    inline KeyInterpolation interpolation() const { return mode; }
+    inline GLfloat duration() const { return times.empty() ? 0.0f : times.back(); }
+    inline GLfloat keyTime(GLuint _key) const { return times[_key]; }
+    inline T keyValue(GLuint _key) const {
+        GLfloat value[3 * Traits::SZ];
+        fetch(_key, value);
+        return Traits::fix(Traits::load(value));
+    }
+    // Bytes held by the keys
+    inline size_t memoryUsage() const {
+        return times.size() * sizeof(GLfloat) + data.size() * sizeof(GLfloat) +
+            qData.size() * sizeof(GLushort) + (qMin.size() + qScale.size()) * sizeof(GLfloat);
+    }
+
+    // Value at _time, clamped to the first and last keys
+    T evaluate(GLfloat _time, TrackCursor& _cursor) const {
+        if (times.empty()) return T();
+
+        GLuint last = times.size() - 1;
+        GLfloat value[3 * Traits::SZ];
+        if (_time <= times[0] || last == 0) {
+            fetch(0, value); return Traits::fix(Traits::load(value));
+        }
+        if (_time >= times[last]) {
+            fetch(last, value); return Traits::fix(Traits::load(value));
+        }
+
+        GLuint k = seek(_time, _cursor);
+        GLfloat next[3 * Traits::SZ];
+        fetch(k, value); fetch(k + 1, next);
+
+        GLfloat dt = times[k + 1] - times[k];
+        GLfloat s = (_time - times[k]) / dt;
+        const GLuint SZ = Traits::SZ;
+
+        switch (mode) {
+            case KEY_STEP:
+                return Traits::fix(Traits::load(value));
+            case KEY_LINEAR:
+                return Traits::fix(Traits::lerp(Traits::load(value), Traits::load(next), s));
+
+            case KEY_HERMITE: {
+                GLfloat s2 = s * s, s3 = s2 * s;
+                GLfloat h00 = 2 * s3 - 3 * s2 + 1, h10 = s3 - 2 * s2 + s;
+                GLfloat h01 = -2 * s3 + 3 * s2, h11 = s3 - s2;
+                for (GLuint c = 0; c < SZ; ++c) {
+                    value[c] = h00 * value[c] + h10 * dt * value[2 * SZ + c] +
+                        h01 * next[c] + h11 * dt * next[SZ + c];
+                }
+                return Traits::fix(Traits::load(value));
+            }
+
+            case KEY_BEZIER: {
+                GLfloat r = 1 - s;
+                GLfloat b0 = r * r * r, b1 = 3 * r * r * s, b2 = 3 * r * s * s, b3 = s * s * s;
+                for (GLuint c = 0; c < SZ; ++c) {
+                    value[c] = b0 * value[c] + b1 * value[2 * SZ + c] +
+                        b2 * next[SZ + c] + b3 * next[c];
+                }
+                return Traits::fix(Traits::load(value));
+            }
+        }
+
+        return Traits::fix(Traits::load(value));
+    }
+
+    // Random access, searches for the segment every time
+    T evaluate(GLfloat _time) const {
+        TrackCursor cursor;
+        return evaluate(_time, cursor);
+    }
+
+ private:
+    KeyInterpolation mode;
+    GLuint stride;
+
+    std::vector<GLfloat> times;
+    std::vector<GLfloat> data;
+
+    // Quantized keys, value = qMin + q * qScale per component
+    std::vector<GLushort> qData;
+    std::vector<GLfloat> qMin, qScale;
+
+    inline bool hasTangents() const { return mode == KEY_HERMITE || mode == KEY_BEZIER; }
+
+    void fetch(GLuint _key, GLfloat* _out) const {
+        GLuint at = _key * stride;
+        if (quantized()) {
+            for (GLuint c = 0; c < stride; ++c)
+                _out[c] = qMin[c] + qData[at + c] * qScale[c];
+        } else {
+            std::copy(&data[at], &data[at] + stride, _out);
+        }
+    }
+
+    // Segment [k, k + 1] holding _time, for times[0] < _time < times.back()
+    GLuint seek(GLfloat _time, TrackCursor& _cursor) const {
+        GLuint k = std::min<GLuint>(_cursor.key, times.size() - 2);
+
+        if (times[k] <= _time) {
+            for (GLuint n = 0; n < TRACK_CURSOR_SCAN && times[k + 1] <= _time; ++n) ++k;
+            if (times[k + 1] > _time) { _cursor.key = k; return k; }
+        }
+
+        k = std::upper_bound(times.begin(), times.end(), _time) - times.begin() - 1;
+        _cursor.key = k;
+        return k;
+    }
+};
+
+}  // namespace anim
+
+#endif
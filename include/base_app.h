@@ -7,18 +7,37 @@
  */
 
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 
 #include <base.h>
 #include <text/text.h>
 #include <base_util.h>
 #include <base_shader.h>
+#include <base_profiler.h>
+#include <base_glstats.h>
+#include <base_gpumem.h>
+#include <base_glcapture.h>
+#include <base_framedump.h>
+#include <base_hud.h>
 
 #include <external/glm/mat4x4.hpp>
 #include <external/glm/gtc/type_ptr.hpp>
 #include <external/glm/gtc/matrix_transform.hpp>
 
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
+
 #define BASE_APP_TITLE_SIZE 128
+#define BASE_PIPELINE_REPORT 2.0  // Seconds between pipeline reports
+#define BASE_MAX_UPDATES 5        // Fixed updates per frame before time is dropped
+#define BASE_PACING_REPORT 2.0    // Seconds between frame pacing reports
+#define BASE_TRACE_FILE "frame_trace.json"
+#define BASE_METRICS_INTERVAL 10.0  // Seconds between exported metrics snapshots
+#define BASE_CAPTURE_FRAMES 60  // Frames recorded by --capture
+#define BASE_FPS_STR_SIZE 64
 
 namespace glf {
 
@@ -37,7 +56,28 @@ class BaseApp {
      * @param elapsedTime:  Time elapsed since initialization of GLFW
      * @param duration:     Time elapsed since last call to this function
      */
-    virtual void render(double elapsedTime, double duration) = 0;
+    virtual void render(double elapsedTime, double duration) {}
+
+    /* Same, for apps with a fixed timestep: alpha is the fraction of a step
+     * simulated time is ahead of the last update(), to interpolate state with.
+     * Always 1 without a fixed timestep */
+    virtual void render(double elapsedTime, double duration, double alpha) {
+        render(elapsedTime, duration);
+    }
+
+    // Called zero or more times a frame, before simulate(), with the fixed step
+    virtual void update(double step) {}
+
+    /* Advances the frame's state without touching GL, before render() gets the
+     * same times. With pipelining it runs on its own thread, one frame ahead
+     * of render(): write only state render() doesn't read until syncFrame() */
+    virtual void simulate(double elapsedTime, double duration) {}
+    // Simulation and rendering are both idle here: hand simulated state to render()
+    virtual void syncFrame() {}
+    /* Called on the GL thread right before render(). With late latching the
+     * serial loop polls events again first, so input read here (or applied in
+     * the event handlers) is as fresh as it gets for the frame */
+    virtual void latchInput() {}
 
     virtual void onKeyPress(int key, int mods) {}
     virtual void onKeyRelease(int key, int mods) {
@@ -65,8 +105,57 @@ class BaseApp {
     }
 
     void enableFPSDisplay(bool enable) { info.showFPS = enable; validateTextRender(); }
-    void enableStatsDisplay(bool enable) { info.showAppInfo = enable; validateTextRender(); }
+    /* Title and the performance HUD, which needs the profiler for GPU pass times
+     * Title and FPS label are retained meshes, only the HUD figures are laid out */
+    void enableStatsDisplay(bool enable) {
+        info.showAppInfo = enable; validateTextRender();
+        if (enable) enableProfiler(true);
+    }
+    // Distance field glyphs, requires a distance field text shader
+    void enableSDFText(bool enable) { info.sdfText = enable; }
     void setBaseTextShader(glf::Shader* _textShader) { baseTextShader = _textShader; }
+    // Simulate frame N + 1 while frame N renders, set during setup()
+    void enablePipelining(bool enable) { info.pipelined = enable; }
+    // Seconds per update(), 0 to disable; at most _maxUpdates run per frame
+    void setFixedTimestep(double _step, GLuint _maxUpdates = BASE_MAX_UPDATES) {
+        fixedStep = _step; maxUpdates = std::max(1u, _maxUpdates);
+        accumulator = 0.0;
+    }
+    // Simulated time given up since startup because frames took too long
+    double droppedTime() const { return dropped; }
+    // Cap on frames per second, 0 for none; combines with vsync
+    void setFrameLimit(double fps) { frameLimiter.setRate(fps); }
+    // Poll events just before render() too, serial loop only
+    void enableLateLatching(bool enable) { info.lateLatch = enable; }
+    // Print mean and deviation of frame intervals every BASE_PACING_REPORT seconds
+    void enablePacingReport(bool enable) { info.pacingReport = enable; }
+    /* Frame zones of prof::Profiler; with it on, F11 prints the last frame's
+     * zone tree and F12 writes a trace of the next frames to BASE_TRACE_FILE */
+    void enableProfiler(bool enable) { prof::Profiler::instance().setEnabled(enable); }
+    /* Appends a snapshot of all registered metrics (frame times, GL counts,
+     * anything else in metrics::Registry) to _path every _interval seconds
+     * while running, for soak runs */
+    bool exportMetrics(const char* _path, double _interval = BASE_METRICS_INTERVAL) {
+        return metrics::Registry::instance().startExport(_path, _interval);
+    }
+    // Warn on stderr whenever tracked GPU allocations go over _megabytes, 0 for none
+    void setGPUMemoryBudget(double _megabytes) {
+        gpumem::setBudget((GLuint64) (_megabytes * 1024.0 * 1024.0));
+    }
+    /* Records GL calls from startup on and _frames frames after to _path, for
+     * glreplay to play back; --capture <file> and --capture-frames <n> on the
+     * command line do the same */
+    void enableCapture(const char* _path, GLuint _frames = BASE_CAPTURE_FRAMES) {
+        capturePath = _path; captureFrames = _frames;
+    }
+    /* Dumps the frames rendered, overlays left out, from startup on: _frames
+     * of them, 0 for all. Readback is asynchronous and encoding on its own
+     * thread; --dump-frames <prefix>, --dump-count <n> and --dump-raw on the
+     * command line do the same */
+    void enableFrameDump(const char* _prefix, FrameDumper::Format _format = FrameDumper::PNG,
+                         GLuint _frames = 0) {
+        dumpPrefix = _prefix; dumpFormat = _format; dumpFrames = _frames;
+    }
     void setStatsColor(const glm::vec3& _color) { baseFontRenderer.setColor(_color, baseTextShader); }
 
     int run(glf::BaseApp* _app) {
@@ -99,6 +188,11 @@ class BaseApp {
             fprintf(stderr, "Failed to initialize OpenGL\n");
             return -3;
         }
+        glstats::install();
+        gpumem::install();
+        // Outermost, recording calls as the app makes them
+        if (!capturePath.empty())
+            glcapture::start(capturePath.c_str(), captureFrames, info.width, info.height);
 
         glfwSetInputMode(window, GLFW_CURSOR,
             info.flags.cursor ? GLFW_CURSOR_NORMAL : GLFW_CURSOR_DISABLED);
@@ -111,8 +205,16 @@ class BaseApp {
         wfac = getWidth() / 1366.0f;
 
         if (info.renderTexts) {
-            baseFontData.loadFonts("media/data/fonts/ubuntu/Ubuntu-R.ttf", 20.0f * wfac);
+            // Distance field glyphs are loaded once at their base size and scaled
+            if (info.sdfText) {
+                baseFontData.loadSDF("media/data/fonts/ubuntu/Ubuntu-R.ttf");
+                textScale = 20.0f * wfac / SDF_GLYPH_SIZE;
+            } else {
+                baseFontData.loadFonts("media/data/fonts/ubuntu/Ubuntu-R.ttf", 20.0f * wfac);
+                textScale = 1.0f;
+            }
             baseFontRenderer.init(&baseFontData, baseTextShader);
+            setAppInfoText();
 
             // Font transforms
             baseTextShader->use();
@@ -127,26 +229,64 @@ class BaseApp {
             glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
         }
 
+        if (!dumpPrefix.empty())
+            frameDumper.start(dumpPrefix, dumpFormat, dumpFrames);
+
         double cur, prev;
         cur = prev = glfwGetTime();
 
-        do {
+        pacingStart = cur;
+        prof::Profiler& profiler = prof::Profiler::instance();
+        if (info.pipelined) {
+            runPipelined(cur);
+        } else do {
+            frameLimiter.wait();
+            glcapture::beginFrame();
+            profiler.beginFrame();
             cur = glfwGetTime();
-            render(cur, cur - prev);
 
-            // Post render
-            if (info.showFPS) {
-                baseFPSMetric.frameUpdated(cur);
-                baseFontRenderer.renderText(baseTextShader, base_fps_str, 10.0f, 10.0f, 0.8f);
+            double alpha;
+            {
+                PROFILE_ZONE("Simulate");
+                alpha = advance(cur - prev);
+                simulate(cur, cur - prev);
+            }
+            syncFrame();
+
+            if (info.lateLatch) glfwPollEvents();
+            latchInput();
+            {
+                PROFILE_GPU_ZONE("Render");
+                render(cur, cur - prev, alpha);
             }
-            if (info.showAppInfo) { renderAppInfo(); }
+            glstats::Counters frameCounts = glstats::take();
+            dumpFrame();
+            postRender(cur, frameCounts);
 
-            glfwSwapBuffers(window);
+            {
+                PROFILE_ZONE("Swap");
+                glfwSwapBuffers(window);
+            }
+            profiler.endFrame();
+            glcapture::endFrame();
+            framePresented();
             glfwPollEvents();
             prev = cur;
         } while (!glfwWindowShouldClose(window));
 
+        glcapture::stop();
+        frameDumper.finish();
         shutdown();
+        profiler.dispose();
+        metrics::Registry::instance().stopExport();
+        baseFPSText.clean();
+        baseInfoText.clean();
+        baseFontData.clean();
+        // Anything still charged outlives the context, freed by the driver at best
+        if (gpumem::total().objects) {
+            fprintf(stderr, "Not released before the GL context closed:\n");
+            gpumem::report(stderr);
+        }
         glfwTerminate();
 
         return 0;
@@ -187,6 +327,22 @@ class BaseApp {
         glfwSwapInterval((int) info.flags.vsync);
     }
 
+    // Options every app takes, before setup() so it can override them
+    void parseArgs(int argc, const char* argv[]) {
+        for (int i = 1; i < argc; ++i) {
+            if (!strcmp(argv[i], "--capture") && i + 1 < argc)
+                capturePath = argv[++i];
+            else if (!strcmp(argv[i], "--capture-frames") && i + 1 < argc)
+                captureFrames = std::max(1, atoi(argv[++i]));
+            else if (!strcmp(argv[i], "--dump-frames") && i + 1 < argc)
+                dumpPrefix = argv[++i];
+            else if (!strcmp(argv[i], "--dump-count") && i + 1 < argc)
+                dumpFrames = std::max(0, atoi(argv[++i]));
+            else if (!strcmp(argv[i], "--dump-raw"))
+                dumpFormat = FrameDumper::RAW;
+        }
+    }
+
     int getWidth() const { return info.width; }
     int getHeight() const { return info.height; }
 
@@ -197,7 +353,10 @@ class BaseApp {
         y = static_cast<float>(_y);
     }
 
+    // Pipelined apps read key states cached at the last poll, from any thread
     int testKeyState(int key, int test_state) const {
+        if (info.pipelined)
+            return key >= 0 && key <= GLFW_KEY_LAST && keyStates[key] == test_state;
         return glfwGetKey(window, key) == test_state;
     }
 
@@ -209,7 +368,9 @@ class BaseApp {
         int majorVersion;
         int samples;  // MSAA Samples
         bool showFPS, showAppInfo;
-        bool renderTexts;
+        bool renderTexts, sdfText;
+        bool pipelined;  // Simulation on its own thread
+        bool lateLatch, pacingReport;
 
         union {
             struct {
@@ -229,24 +390,61 @@ class BaseApp {
     static glf::BaseApp* app;
 
     util::FPSMetric baseFPSMetric;
+    metrics::Counter *metricFrames, *metricDraws, *metricTriangles, *metricStates;
     text::FontData baseFontData;
     text::FontRenderer baseFontRenderer;
+    text::TextMesh baseFPSText, baseInfoText;
+    glf::PerfHUD baseHUD;
     glf::Shader* baseTextShader;
 
  private:
     bool valid;
     GLfloat wfac;  // Width factor [width / 1366.0f]
+    GLfloat textScale;  // Glyph scale to the base text size
     GLFWwindow* window;
 
-    static char base_fps_str[15];
-    static void fps_callback(GLfloat fps) {
-        snprintf(base_fps_str, sizeof(base_fps_str), "FPS: %.2f", fps);
+    unsigned char keyStates[GLFW_KEY_LAST + 1];
+
+    // Frame requests from the GL thread to the simulation thread
+    struct SimHandoff {
+        std::mutex lock;
+        std::condition_variable signal;
+        bool requested, done, quit;
+        double time, duration;  // Frame to simulate
+        double busy;            // Seconds the last simulate() took
+        double alpha;           // Interpolation alpha of the simulated frame
+    } handoff;
+
+    // Fixed timestep state, only touched by the simulating thread
+    double fixedStep, accumulator, dropped;
+    GLuint maxUpdates;
+
+    std::string capturePath;
+    GLuint captureFrames;
+
+    glf::FrameDumper frameDumper;
+    std::string dumpPrefix;
+    FrameDumper::Format dumpFormat;
+    GLuint dumpFrames;
+
+    util::FrameLimiter frameLimiter;
+    util::FramePacing framePacing;
+    double pacingStart;
+
+    static char base_fps_str[BASE_FPS_STR_SIZE];
+    // The FPS label is only laid out again when a new value comes in
+    static void fps_callback(GLfloat fps, const metrics::Summary& frameTimes) {
+        snprintf(base_fps_str, sizeof(base_fps_str), "FPS: %.2f  p99 %.1f ms  max %.1f ms",
+            fps, frameTimes.p99 / 1000.0, frameTimes.max / 1000.0);
+        app->baseFPSText.setLine(0, base_fps_str, 10.0f, 10.0f, 0.8f * app->textScale);
     }
 
-    void renderAppInfo() {
-        baseFontRenderer.renderText(baseTextShader, info.title, 10.0f, 740.0f * wfac, 0.7f);
-        baseFontRenderer.renderText(baseTextShader, "OpenGLDemo Alpha Developer Version", 10.0f, 725.0f * wfac, 0.6f);
-        baseFontRenderer.renderText(baseTextShader, "Methusael Murmu", 10.0f, 710.0f * wfac, 0.6f);
+    // Constant for the whole run, laid out once
+    void setAppInfoText() {
+        baseInfoText.setLine(0, info.title, 10.0f, 740.0f * wfac, 0.7f * textScale);
+        baseInfoText.setLine(1, "OpenGLDemo Alpha Developer Version",
+            10.0f, 725.0f * wfac, 0.6f * textScale);
+        baseInfoText.setLine(2, "Methusael Murmu", 10.0f, 710.0f * wfac, 0.6f * textScale);
     }
 
     // Set to default values
@@ -264,16 +462,211 @@ class BaseApp {
         info.height = 600;
         info.minorVersion = 3;
         info.majorVersion = 3;
-        info.samples = info.renderTexts = 0;
+        info.samples = info.renderTexts = info.sdfText = 0;
         info.showFPS = info.showAppInfo = 0;
+        info.pipelined = info.lateLatch = info.pacingReport = false;
+        fixedStep = accumulator = dropped = 0.0;
+        maxUpdates = BASE_MAX_UPDATES;
+        captureFrames = BASE_CAPTURE_FRAMES;
+        dumpFormat = FrameDumper::PNG;
+        dumpFrames = 0;
+        memset(keyStates, GLFW_RELEASE, sizeof(keyStates));
         info.flags.all = 0;
         info.flags.cursor = 1;
 
+        metrics::Registry& registry = metrics::Registry::instance();
         baseFPSMetric.setCallback(fps_callback);
         baseFPSMetric.setInterval(0.4f);
+        baseFPSMetric.setRecorder(&registry.histogram("frame_time_us"));
+        metricFrames = &registry.counter("frames");
+        metricDraws = &registry.counter("gl.draws");
+        metricTriangles = &registry.counter("gl.triangles");
+        metricStates = &registry.counter("gl.state_changes");
         valid = true;
     }
 
+    /* Runs the fixed updates _duration brings due and returns the alpha
+     * Beyond maxUpdates steps time is dropped instead, so a slow frame can't
+     * make the next one slower still */
+    double advance(double _duration) {
+        if (fixedStep <= 0.0) return 1.0;
+
+        accumulator += _duration;
+        double limit = maxUpdates * fixedStep;
+        if (accumulator > limit) {
+            dropped += accumulator - limit;
+            accumulator = limit;
+        }
+
+        while (accumulator >= fixedStep) {
+            update(fixedStep);
+            accumulator -= fixedStep;
+        }
+        return accumulator / fixedStep;
+    }
+
+    // Pacing is measured where frames leave the app, right after the swap
+    void framePresented() {
+        if (!info.pacingReport) return;
+
+        double now = glfwGetTime();
+        framePacing.frameUpdated(now);
+        if (now - pacingStart > BASE_PACING_REPORT) {
+            fprintf(stdout, "Pacing: %.3f ms mean, %.3f ms deviation, %.3f ms worst "
+                "over %u frames\n", framePacing.mean(), framePacing.deviation(),
+                framePacing.worst(), framePacing.frames());
+            framePacing.reset();
+            pacingStart = now;
+        }
+    }
+
+    // Reads the frame back as render() left it, at the framebuffer's size in pixels
+    void dumpFrame() {
+        if (!frameDumper.active()) return;
+
+        PROFILE_GPU_ZONE("Frame dump");
+        int width, height;
+        glfwGetFramebufferSize(window, &width, &height);
+        frameDumper.capture(width, height);
+    }
+
+    /* Overlays, given the frame's GL counts taken before the frame dump and
+     * them, so neither counts itself */
+    void postRender(double _time, const glstats::Counters& _counts) {
+        metricFrames->add();
+        metricDraws->add(_counts.draws);
+        metricTriangles->add(_counts.triangles);
+        metricStates->add(_counts.stateChanges);
+        baseFPSMetric.frameUpdated(_time);
+
+        if (info.renderTexts) {
+            PROFILE_GPU_ZONE("Overlay");
+            if (info.showAppInfo) {
+                baseFontRenderer.renderText(baseTextShader, baseInfoText);
+                baseHUD.frameUpdated(_time, _counts);
+                baseHUD.queue(baseFontRenderer, 10.0f, 705.0f * wfac, 0.55f * textScale, wfac);
+                baseFontRenderer.flush(baseTextShader);
+            }
+            if (info.showFPS) baseFontRenderer.renderText(baseTextShader, baseFPSText);
+        }
+        glstats::reset();
+    }
+
+    /* Frame N is drawn while the simulation thread advances frame N + 1, so
+     * what's on screen is at most one frame behind the simulation. Events are
+     * polled and state handed over only while the simulation is idle */
+    void runPipelined(double _start) {
+        double prev = _start, simTime = _start, simDuration = 0.0;
+        double reportStart = _start, stall = 0.0, simBusy = 0.0, renderBusy = 0.0;
+        GLuint frames = 0;
+
+        handoff.requested = handoff.done = handoff.quit = false;
+        std::thread simulation(&BaseApp::simulationLoop, this);
+        requestSimulation(simTime, simDuration);
+
+        prof::Profiler& profiler = prof::Profiler::instance();
+        do {
+            frameLimiter.wait();
+            glcapture::beginFrame();
+            profiler.beginFrame();
+
+            // Frame N simulated, frame N - 1 presented
+            double wait = glfwGetTime(), alpha;
+            {
+                PROFILE_ZONE("Simulation wait");
+                simBusy += awaitSimulation(alpha);
+            }
+            stall += glfwGetTime() - wait;
+
+            glfwPollEvents();
+            syncFrame();
+
+            double frameTime = simTime, frameDuration = simDuration;
+            simTime = glfwGetTime(); simDuration = simTime - prev; prev = simTime;
+            requestSimulation(simTime, simDuration);
+
+            // Events were just polled; polling again would race the simulation
+            double start = glfwGetTime();
+            latchInput();
+            {
+                PROFILE_GPU_ZONE("Render");
+                render(frameTime, frameDuration, alpha);
+            }
+            glstats::Counters frameCounts = glstats::take();
+            dumpFrame();
+            postRender(frameTime, frameCounts);
+            renderBusy += glfwGetTime() - start;
+            {
+                PROFILE_ZONE("Swap");
+                glfwSwapBuffers(window);
+            }
+            profiler.endFrame();
+            glcapture::endFrame();
+            framePresented();
+
+            // Simulation time the GL thread didn't wait for ran alongside rendering
+            frames++;
+            double now = glfwGetTime();
+            if (now - reportStart > BASE_PIPELINE_REPORT) {
+                fprintf(stdout, "Pipeline: frame %.2f ms, simulate %.2f ms, render %.2f ms, "
+                    "%.0f%% of simulation overlapped\n", 1000.0 * (now - reportStart) / frames,
+                    1000.0 * simBusy / frames, 1000.0 * renderBusy / frames,
+                    simBusy > 0.0 ? 100.0 * std::max(0.0, 1.0 - stall / simBusy) : 100.0);
+                reportStart = now; frames = 0;
+                stall = simBusy = renderBusy = 0.0;
+            }
+        } while (!glfwWindowShouldClose(window));
+
+        double alpha;
+        awaitSimulation(alpha);
+        {
+            std::lock_guard<std::mutex> guard(handoff.lock);
+            handoff.quit = true;
+        }
+        handoff.signal.notify_all();
+        simulation.join();
+    }
+
+    void requestSimulation(double _time, double _duration) {
+        std::lock_guard<std::mutex> guard(handoff.lock);
+        handoff.time = _time; handoff.duration = _duration;
+        handoff.requested = true; handoff.done = false;
+        handoff.signal.notify_all();
+    }
+
+    // Returns the seconds the finished simulate() call took
+    double awaitSimulation(double& _alpha) {
+        std::unique_lock<std::mutex> lock(handoff.lock);
+        while (!handoff.done) handoff.signal.wait(lock);
+        _alpha = handoff.alpha;
+        return handoff.busy;
+    }
+
+    void simulationLoop() {
+        std::unique_lock<std::mutex> lock(handoff.lock);
+        for (;;) {
+            while (!handoff.requested && !handoff.quit) handoff.signal.wait(lock);
+            if (handoff.quit) break;
+
+            handoff.requested = false;
+            double time = handoff.time, duration = handoff.duration;
+            lock.unlock();
+
+            double start = glfwGetTime(), alpha;
+            {
+                PROFILE_ZONE("Simulate");
+                alpha = advance(duration);
+                simulate(time, duration);
+            }
+            double busy = glfwGetTime() - start;
+
+            lock.lock();
+            handoff.busy = busy; handoff.alpha = alpha;
+            handoff.done = true;
+            handoff.signal.notify_all();
+        }
+    }
+
     void validateTextRender() {
         info.renderTexts = info.showFPS || info.showAppInfo;
     }
@@ -281,6 +674,15 @@ class BaseApp {
     // API event processing callbacks
     static void keyCallback(GLFWwindow* win, int key, int scan,
         int action, int mod) {
+        if (key >= 0 && key <= GLFW_KEY_LAST)
+            app->keyStates[key] = action == GLFW_RELEASE ? GLFW_RELEASE : GLFW_PRESS;
+
+        prof::Profiler& profiler = prof::Profiler::instance();
+        if (action == GLFW_PRESS && profiler.enabled()) {
+            if (key == GLFW_KEY_F11) profiler.print();
+            if (key == GLFW_KEY_F12 && !profiler.capturing()) profiler.captureTrace(BASE_TRACE_FILE);
+        }
+
         switch (action) {
             case GLFW_PRESS:
             case GLFW_REPEAT:
@@ -340,6 +742,7 @@ class BaseApp {
 #define DECLARE_MAIN(a)                     \
 int main(int argc, const char* argv[]) {    \
     glf::BaseApp* apl = new a;              \
+    apl->parseArgs(argc, argv);             \
     int ret = apl->run(apl);                \
     delete apl;                             \
     return ret;                             \
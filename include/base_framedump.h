@@ -0,0 +1,101 @@
+#ifndef __BASE_FRAMEDUMP__
+#define __BASE_FRAMEDUMP__
+
+/**
+ * Frame dumping through asynchronous framebuffer readback
+ * @author: Methusael Murmu
+ */
+
+#include <base.h>
+#include <base_metrics.h>
+
+#include <stdio.h>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#define FRAMEDUMP_RING 3       // Readbacks in flight, frames until one is mapped
+#define FRAMEDUMP_QUEUE 8      // Frames waiting on the encoder before capture() waits too
+#define FRAMEDUMP_PNG_LEVEL 1  // zlib level, speed over size so the encoder keeps up
+
+namespace glf {
+
+/* Reads the default framebuffer into a ring of pixel pack buffers, each
+ * fenced, and maps a buffer only once its fence has passed, FRAMEDUMP_RING
+ * frames later, so glReadPixels never waits on the GPU. Mapped pixels are
+ * copied out and handed to an encoder thread writing PNGs or a raw stream,
+ * rows top to bottom. Frames are never dropped: a full ring waits on the
+ * oldest fence and a full queue on the encoder, both counted in the report */
+class FrameDumper {
+ public:
+    enum Format {
+        PNG,  // <prefix>_00000.png on, RGB
+        RAW   // <prefix>.rgba, frames back to back: ffmpeg -f rawvideo -pix_fmt rgba
+    };
+
+    FrameDumper();
+    ~FrameDumper() { finish(); }
+
+    // _frames 0 to dump until finish()
+    bool start(const std::string& _prefix, Format _format, GLuint _frames = 0);
+    /* Queues the readback of the frame in the back buffer, _width x _height,
+     * and passes on those completed. Once a frame, before swapping; leaves the
+     * default framebuffer bound for reading. GL thread */
+    void capture(GLsizei _width, GLsizei _height);
+    // Reads back the frames in flight, drains the encoder and reports; GL thread
+    void finish();
+    inline bool active() const { return running; }
+
+ private:
+    struct Slot {
+        GLuint pbo;
+        GLsync fence;
+    };
+
+    struct Frame {
+        GLuint index;
+        GLsizei width, height;
+        std::vector<GLubyte> pixels;  // RGBA, bottom row first
+    };
+
+    std::string prefix;
+    Format format;
+    bool running;
+    GLuint limit;
+
+    Slot ring[FRAMEDUMP_RING];
+    GLuint head, inFlight;  // Oldest slot read into, readbacks pending
+    GLsizei width, height;  // Of the ring's buffers
+
+    GLuint captured, written;
+    GLuint gpuWaits, encoderWaits;
+    metrics::Histogram captureTimes;  // GL thread cost per frame, us
+
+    // Encoder side
+    std::thread encoder;
+    std::mutex lock;
+    std::condition_variable signal;
+    std::deque<Frame*> queue;
+    std::vector<Frame*> spare;
+    bool quit;
+    FILE* raw;
+    std::vector<GLubyte> rows, packed;
+
+    void resize(GLsizei _width, GLsizei _height);
+    void release();
+    bool ready(const Slot& _slot);
+    void collect(bool _wait);
+    void encodeLoop();
+    void writePNG(const Frame& _frame);
+    void writeRaw(const Frame& _frame);
+
+    FrameDumper(const FrameDumper& ref) {}
+    const FrameDumper& operator=(const FrameDumper& rhs) { return *this; }
+};
+
+}  // namespace glf
+
+#endif
@@ -0,0 +1,71 @@
+#ifndef __BASE_GLCAPTURE__
+#define __BASE_GLCAPTURE__
+
+/**
+ * GL command stream capture and replay
+ * @author: Methusael Murmu
+ */
+
+#include <base.h>
+
+#include <stddef.h>
+#include <vector>
+
+#define GLCAPTURE_MAGIC "GLCP"
+#define GLCAPTURE_VERSION 1
+#define GLCAPTURE_FLUSH_BYTES (4 << 20)  // Pending bytes written out at once
+
+namespace glcapture {
+
+struct Header {
+    char magic[4];
+    GLuint version;
+    GLuint width, height;  // Default framebuffer at capture
+    GLuint frames;
+    GLuint64 index;        // File offset of the frames' start offsets
+};
+
+/* Routes the gl3w entry points the library and demos use through recording
+ * wrappers and writes every call, with the buffer, texture, shader and
+ * uniform data it reads, to _path. Call right after gl3wInit() and any other
+ * hooks: everything up to the first beginFrame() is the setup a replay needs
+ * (objects, shaders, uploads), then _frames frames are kept and the wrappers
+ * removed. Queries and reads aren't recorded. GL thread only */
+bool start(const char* _path, GLuint _frames, GLuint _width, GLuint _height);
+// Frame boundaries, around everything the frame draws
+void beginFrame();
+void endFrame();
+// Finishes the file early, also done after the last frame
+void stop();
+bool capturing();
+
+/* Plays a capture back on the current context. Object names and uniform
+ * locations are mapped to those the replaying driver hands out; decoding
+ * is a copy per argument, payloads are passed from the loaded file */
+class Replay {
+ public:
+    Replay() {}
+
+    bool load(const char* _path);
+    inline const Header& header() const { return head; }
+    inline GLuint frames() const { return head.frames; }
+    inline size_t bytes() const { return data.size(); }
+
+    // Calls issued, 0 on a malformed stream
+    GLuint playSetup();
+    GLuint playFrame(GLuint _frame);
+
+ private:
+    Header head;
+    std::vector<GLubyte> data;
+    std::vector<GLuint64> starts;  // Setup end and each frame's start, then the index
+
+    GLuint play(GLuint64 _begin, GLuint64 _end);
+
+    Replay(const Replay& ref) {}
+    const Replay& operator=(const Replay& rhs) { return *this; }
+};
+
+}  // namespace glcapture
+
+#endif
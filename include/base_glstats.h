@@ -0,0 +1,34 @@
+#ifndef __BASE_GLSTATS__
+#define __BASE_GLSTATS__
+
+/**
+ * Draw call and state change counters
+ * @author: Methusael Murmu
+ */
+
+#include <base.h>
+
+namespace glstats {
+
+struct Counters {
+    Counters(): draws(0), triangles(0), stateChanges(0) {}
+
+    GLuint64 draws;
+    GLuint64 triangles;     // Triangle primitives submitted, instances included
+    GLuint64 stateChanges;  // Program, binding, capability and fixed state calls
+};
+
+/* Routes the draw and state calls of gl3w through counting wrappers; call
+ * once after gl3wInit(). Counting is GL thread only and costs an extra call
+ * and an increment per command */
+void install();
+bool installed();
+
+// Counts since the last take() or reset()
+const Counters& current();
+Counters take();
+void reset();
+
+}  // namespace glstats
+
+#endif
@@ -0,0 +1,80 @@
+#ifndef __BASE_GPUMEM__
+#define __BASE_GPUMEM__
+
+/**
+ * GPU memory accounting of buffers, textures and renderbuffers
+ * @author: Methusael Murmu
+ */
+
+#include <base.h>
+
+#include <stdio.h>
+#include <string>
+#include <utility>
+#include <vector>
+
+#define GPUMEM_UNTAGGED "Untagged"
+#define GPUMEM_BUDGET_REARM 0.9  // Fraction of the budget usage must fall under to warn again
+
+#define GPUMEM_CONCAT_(a, b) a##b
+#define GPUMEM_CONCAT(a, b) GPUMEM_CONCAT_(a, b)
+#define GPU_OWNER(owner) gpumem::OwnerScope GPUMEM_CONCAT(gpumem_owner_, __LINE__)(owner)
+
+namespace gpumem {
+
+enum Category {
+    VERTEX_BUFFER,   // Allocated through GL_ARRAY_BUFFER
+    INDEX_BUFFER,    // GL_ELEMENT_ARRAY_BUFFER
+    OTHER_BUFFER,    // Uniform, texture, pixel and copy buffers
+    TEXTURE,
+    DEPTH_TEXTURE,   // Depth and depth-stencil formats, shadow maps mostly
+    RENDERBUFFER,
+    CATEGORY_SZ
+};
+
+const char* categoryName(Category _category);
+
+struct Usage {
+    Usage(): bytes(0), objects(0) {}
+
+    GLuint64 bytes;
+    GLuint64 objects;  // Objects with storage
+};
+
+/* Routes the creation, binding, storage and deletion calls of gl3w for
+ * buffers, textures and renderbuffers through tracking wrappers; call once
+ * after gl3wInit(), before anything is bound, as bindings are followed
+ * rather than queried. Sizes are estimated from the storage requested (RGB
+ * texels count as 4 bytes, as drivers pad them) and charged to the owner
+ * innermost when the object was generated. GL thread only */
+void install();
+bool installed();
+
+Usage total();
+Usage usage(Category _category);
+GLuint64 peakBytes();
+// Owners still holding memory, largest first
+std::vector<std::pair<std::string, Usage> > owners();
+
+// Warns on stderr whenever the total goes over _bytes, 0 to disable
+void setBudget(GLuint64 _bytes);
+GLuint64 budget();
+
+// Totals, the categories in use and the owners holding memory
+void report(FILE* _fp);
+
+/* Objects generated in the scope are charged to _owner, scopes nest
+ * Owners are interned by name, so reusing one adds up */
+class OwnerScope {
+ public:
+    explicit OwnerScope(const std::string& _owner);
+    ~OwnerScope();
+
+ private:
+    OwnerScope(const OwnerScope& ref) {}
+    const OwnerScope& operator=(const OwnerScope& rhs) { return *this; }
+};
+
+}  // namespace gpumem
+
+#endif
@@ -0,0 +1,53 @@
+#ifndef __BASE_HUD__
+#define __BASE_HUD__
+
+/**
+ * On-screen performance overlay
+ * @author: Methusael Murmu
+ */
+
+#include <base.h>
+#include <base_glstats.h>
+#include <text/text.h>
+
+#include <string>
+#include <vector>
+
+#define HUD_HISTORY 240     // Frames in the frame time graph
+#define HUD_REFRESH 0.25    // Seconds between refreshes of the figures
+#define HUD_GRAPH_MS 50.0f  // Frame time at the top of the graph
+#define HUD_MAX_PASSES 6    // GPU zones listed
+#define HUD_MAX_OWNERS 3    // Largest GPU memory owners listed
+
+namespace glf {
+
+/* Frame time graph and figures of the last frames, laid out into a text
+ * batch: graph bars are solid quads from the font atlas, so the overlay goes
+ * out with the batch's single draw. Figures are refreshed every HUD_REFRESH
+ * seconds to stay readable, the graph every frame */
+class PerfHUD {
+ public:
+    PerfHUD();
+
+    // Once a frame, with the frame's GL counts taken before any overlay drew
+    void frameUpdated(GLdouble _time, const glstats::Counters& _gl);
+
+    /* Queues the overlay with its top left at (_x, _y) into _renderer's batch,
+     * left for the caller to flush. _scale sizes glyphs, _unit pixels */
+    void queue(text::FontRenderer& _renderer, GLfloat _x, GLfloat _y,
+               GLfloat _scale, GLfloat _unit);
+
+ private:
+    GLfloat history[HUD_HISTORY];  // Frame times in ms, oldest at head once full
+    GLuint head, count;
+    GLdouble lastTime, lastRefresh;
+    glstats::Counters gl;
+    std::vector<std::string> lines;
+    bool probed, memNVX, memATI;
+
+    void refresh();
+};
+
+}  // namespace glf
+
+#endif
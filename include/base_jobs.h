@@ -0,0 +1,124 @@
+#ifndef __BASE_JOBS__
+#define __BASE_JOBS__
+
+/**
+ * Work stealing job system
+ * @author: Methusael Murmu
+ */
+
+#include <base.h>
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#define JOB_QUEUE_SZ 4096   // Jobs per thread queue, jobs beyond it run inline
+#define JOB_SPLIT 4         // Chunks per thread when parallelFor picks the grain
+
+namespace jobs {
+
+// Jobs started under a counter and not finished yet
+struct JobCounter {
+    JobCounter(): pending(0) {}
+    inline bool done() const { return pending.load(std::memory_order_acquire) == 0; }
+
+    std::atomic<GLuint> pending;
+};
+
+/* Calls fn(data, begin, end)
+ * counter, when set, is held up until the job has run; the job itself only
+ * starts once after (when set) is done */
+struct Job {
+    typedef void (*Function)(void*, GLuint, GLuint);
+
+    Job(Function _fn = NULL, void* _data = NULL, GLuint _begin = 0, GLuint _end = 0,
+        JobCounter* _counter = NULL, const JobCounter* _after = NULL):
+        fn(_fn), data(_data), begin(_begin), end(_end), counter(_counter), after(_after) {}
+
+    Function fn;
+    void* data;
+    GLuint begin, end;
+    JobCounter* counter;
+    const JobCounter* after;
+};
+
+/* One queue per thread: owners push and pop at the back, idle threads steal
+ * the oldest jobs from the front of the others. Threads waiting on a counter
+ * run queued jobs meanwhile, so jobs may start and wait for other jobs.
+ * The creating thread is thread 0 and works only while it waits, as does any
+ * other outside thread, which shares queue 0 */
+class JobSystem {
+ public:
+    // _threads includes the calling thread, 0 for one per hardware thread
+    explicit JobSystem(GLuint _threads = 0);
+    ~JobSystem();
+
+    // Shared instance sized to the hardware
+    static JobSystem& instance();
+
+    inline GLuint threadCount() const { return queues.size(); }
+
+    void run(const Job& _job);
+    void wait(const JobCounter& _counter);
+
+    /* Calls _body(begin, end) over chunks of [_begin, _end) of _grain items
+     * (0 picks JOB_SPLIT chunks per thread) and returns once all are done */
+    template <typename F>
+    void parallelFor(GLuint _begin, GLuint _end, GLuint _grain, const F& _body) {
+        if (_end <= _begin) return;
+
+        GLuint sz = _end - _begin;
+        if (_grain == 0) _grain = std::max(1u, sz / (threadCount() * JOB_SPLIT));
+        if (threadCount() < 2 || sz <= _grain) { _body(_begin, _end); return; }
+
+        JobCounter counter;
+        Job job(&invokeRange<F>, const_cast<F*>(&_body), 0, 0, &counter);
+        for (GLuint b = _begin + _grain; b < _end; b += _grain) {
+            job.begin = b; job.end = std::min(b + _grain, _end);
+            run(job);
+        }
+        _body(_begin, _begin + _grain);
+        wait(counter);
+    }
+
+ private:
+    struct Queue {
+        Queue(): head(0), tail(0) {}
+
+        std::mutex lock;
+        GLuint head, tail;  // Thieves take at head, the owner at tail
+        Job jobs[JOB_QUEUE_SZ];
+    };
+
+    std::vector<Queue*> queues;
+    std::vector<std::thread> workers;
+
+    // Jobs sitting in queues and threads asleep for lack of them
+    std::atomic<GLint> queued, sleeping;
+    std::atomic<bool> quit;
+    std::mutex sleepLock;
+    std::condition_variable wake;
+
+    template <typename F>
+    static void invokeRange(void* _body, GLuint _begin, GLuint _end) {
+        (*static_cast<const F*>(_body))(_begin, _end);
+    }
+
+    GLuint self() const;
+    bool push(GLuint _queue, const Job& _job);
+    bool pop(GLuint _queue, Job& _job);
+    bool steal(GLuint _queue, Job& _job);
+    bool runOne(GLuint _self);
+    void execute(const Job& _job);
+    void work(GLuint _index);
+
+    JobSystem(const JobSystem& ref) {}
+    const JobSystem& operator=(const JobSystem& rhs) { return *this; }
+};
+
+}  // namespace jobs
+
+#endif
@@ -0,0 +1,174 @@
+#ifndef __BASE_METRICS__
+#define __BASE_METRICS__
+
+/**
+ * Lock-free metrics: counters, gauges and log-linear histograms
+ * @author: Methusael Murmu
+ */
+
+#include <base.h>
+
+#include <stdio.h>
+#include <atomic>
+#include <condition_variable>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Histogram layout: 2^SUB_BITS linear buckets, then 2^(SUB_BITS - 1) per
+// power of two, so any value is kept within 1 / 2^(SUB_BITS - 1) of itself
+#define METRICS_SUB_BITS 7
+#define METRICS_MAX_BITS 40     // Values at or above 2^40 are clamped
+#define METRICS_BUCKETS ((1 << METRICS_SUB_BITS) + \
+    (METRICS_MAX_BITS - METRICS_SUB_BITS) * (1 << (METRICS_SUB_BITS - 1)))
+
+namespace metrics {
+
+// Bucket of a value and the lowest and highest values sharing it
+GLuint bucketOf(GLuint64 _value);
+GLuint64 bucketLow(GLuint _bucket);
+GLuint64 bucketHigh(GLuint _bucket);
+
+struct Summary {
+    Summary(): count(0), min(0), max(0), mean(0.0), p50(0), p90(0), p99(0), p999(0) {}
+
+    GLuint64 count, min, max;
+    GLdouble mean;
+    GLuint64 p50, p90, p99, p999;
+};
+
+// Plain histogram, for one thread
+class Histogram {
+ public:
+    Histogram() { reset(); }
+
+    void record(GLuint64 _value, GLuint64 _count = 1);
+    void merge(const Histogram& _other);
+    void reset();
+
+    inline GLuint64 count() const { return total; }
+    inline GLuint64 min() const { return total ? lowest : 0; }
+    inline GLuint64 max() const { return highest; }
+    inline GLdouble mean() const { return total ? (GLdouble) sum / total : 0.0; }
+    // Highest value equivalent to the one _percent of recorded values are at or below
+    GLuint64 percentile(GLdouble _percent) const;
+    Summary summary() const;
+
+ private:
+    friend class Recorder;
+
+    GLuint64 counts[METRICS_BUCKETS];
+    GLuint64 total, sum, lowest, highest;
+};
+
+/* Histogram any thread may record into without locks
+ * Writes go to one of two halves; takeInterval() flips them and waits for
+ * writers still in the old half before reading it, so every value lands in
+ * exactly one interval */
+class Recorder {
+ public:
+    Recorder();
+
+    void record(GLuint64 _value);
+
+    // Values since the last call, also kept in the run total
+    void takeInterval(Histogram& _interval);
+    Summary totalSummary();
+
+ private:
+    struct Half {
+        std::atomic<GLuint64> counts[METRICS_BUCKETS];
+        std::atomic<GLuint64> total, sum, lowest, highest;
+        std::atomic<GLuint> writers;
+    };
+
+    Half halves[2];
+    std::atomic<GLuint> active;
+    std::mutex readLock;
+    Histogram totals;
+
+    void clear(Half& _half);
+
+    Recorder(const Recorder& ref) {}
+    const Recorder& operator=(const Recorder& rhs) { return *this; }
+};
+
+class Counter {
+ public:
+    Counter(): value(0) {}
+
+    inline void add(GLuint64 _n = 1) { value.fetch_add(_n, std::memory_order_relaxed); }
+    inline GLuint64 get() const { return value.load(std::memory_order_relaxed); }
+
+ private:
+    std::atomic<GLuint64> value;
+};
+
+// Last value set wins
+class Gauge {
+ public:
+    Gauge(): value(0.0) {}
+
+    inline void set(GLdouble _v) { value.store(_v, std::memory_order_relaxed); }
+    inline GLdouble get() const { return value.load(std::memory_order_relaxed); }
+
+ private:
+    std::atomic<GLdouble> value;
+};
+
+struct Snapshot {
+    struct Series {
+        std::string name;
+        Summary interval, total;
+    };
+
+    GLdouble time;  // Seconds since the registry was created
+    std::vector<std::pair<std::string, GLuint64> > counters;
+    std::vector<std::pair<std::string, GLdouble> > gauges;
+    std::vector<Series> histograms;
+};
+
+/* Named metrics of the whole process. Registering takes a lock and returns the
+ * same object for the same name, keep the reference; updates are lock-free.
+ * Histogram intervals are consumed by snapshot(), so there should be one
+ * reader of them (the exporter, when running) */
+class Registry {
+ public:
+    static Registry& instance();
+    ~Registry();
+
+    Counter& counter(const std::string& _name);
+    Gauge& gauge(const std::string& _name);
+    Recorder& histogram(const std::string& _name);
+
+    // From any thread
+    Snapshot snapshot();
+    static void write(FILE* _fp, const Snapshot& _snap);
+
+    // Appends a snapshot as a JSON line to _path every _interval seconds
+    bool startExport(const char* _path, GLdouble _interval);
+    void stopExport();
+
+ private:
+    std::mutex lock;
+    std::map<std::string, Counter*> counters;
+    std::map<std::string, Gauge*> gauges;
+    std::map<std::string, Recorder*> histograms;
+
+    std::thread exporter;
+    std::mutex exportLock;
+    std::condition_variable exportWake;
+    bool exportQuit;
+
+    Registry(): exportQuit(false) {}
+    void exportLoop(FILE* _fp, GLdouble _interval);
+
+    Registry(const Registry& ref) {}
+    const Registry& operator=(const Registry& rhs) { return *this; }
+};
+
+}  // namespace metrics
+
+#endif
@@ -0,0 +1,157 @@
+#ifndef __BASE_PROFILER__
+#define __BASE_PROFILER__
+
+/**
+ * Hierarchical CPU/GPU frame profiler
+ * @author: Methusael Murmu
+ */
+
+#include <base.h>
+
+#include <stdio.h>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#define PROF_GPU_FRAMES 4       // Frames GPU results are read behind, so reads never wait
+#define PROF_TRACE_FRAMES 120   // Frames a trace capture covers unless told otherwise
+#define PROF_GPU_THREAD 1000    // Trace thread id of the GPU timeline
+
+// Scoped zones, names must outlive the profiler (string literals)
+#define PROF_CONCAT_(a, b) a##b
+#define PROF_CONCAT(a, b) PROF_CONCAT_(a, b)
+#define PROFILE_ZONE(name) prof::CpuZone PROF_CONCAT(prof_zone_, __LINE__)(name)
+#define PROFILE_GPU_ZONE(name) prof::GpuZone PROF_CONCAT(prof_zone_, __LINE__)(name)
+
+namespace prof {
+
+// Times in microseconds since the profiler started
+struct Zone {
+    const char* name;
+    GLuint thread, depth;
+    GLdouble start, end;
+    GLdouble gpuStart, gpuEnd;  // GPU zones only, on the CPU clock
+    bool gpu;
+
+    inline GLdouble cpuMs() const { return (end - start) / 1000.0; }
+    inline GLdouble gpuMs() const { return gpu ? (gpuEnd - gpuStart) / 1000.0 : 0.0; }
+};
+
+/* Zones closed during one frame, sorted by thread and start: each thread's
+ * zones are a pre-order walk of its tree, depth giving the nesting */
+struct Frame {
+    GLuint index;
+    GLdouble start, end;
+    std::vector<Zone> zones;
+
+    inline GLdouble ms() const { return (end - start) / 1000.0; }
+};
+
+/* CPU zones may open and close on any thread. GPU zones bracket their
+ * commands with timestamp queries and belong to the GL thread, which also
+ * calls beginFrame()/endFrame(); their results are read PROF_GPU_FRAMES
+ * frames later and dropped, never waited on, if still not available. A frame
+ * is published with both CPU and GPU times once its queries are read */
+class Profiler {
+ public:
+    static Profiler& instance();
+
+    void setEnabled(bool _enable) { active = _enable; }
+    inline bool enabled() const { return active; }
+
+    void beginFrame();
+    void endFrame();
+
+    void beginZone(const char* _name);
+    void endZone();
+    void beginGpuZone(const char* _name);
+    void endGpuZone();
+
+    // Latest published frame, PROF_GPU_FRAMES behind the current one
+    inline bool hasFrame() const { return published; }
+    inline const Frame& lastFrame() const { return last; }
+    inline GLuint droppedFrames() const { return dropped; }
+    void print(FILE* _out = stdout) const;
+
+    /* Records the next _frames published frames, plus any zones closed before
+     * the first frame when called that early, and writes them to _path as
+     * Chrome trace_event JSON (chrome://tracing, Perfetto) */
+    void captureTrace(const char* _path, GLuint _frames = PROF_TRACE_FRAMES);
+    inline bool capturing() const { return traceLeft != 0; }
+
+    // Releases the GPU queries, with the context still current
+    void dispose();
+
+ private:
+    struct GpuRecord {
+        GLuint zone;        // Index of the CPU side in the frame's zones
+        GLuint begin, end;  // Query slots
+    };
+
+    struct GpuOpen {
+        const char* name;
+        GLuint begin;
+    };
+
+    struct Slot {
+        Slot(): used(0), pending(false) {}
+
+        std::vector<GLuint> queries;
+        GLuint used;
+        std::vector<GpuRecord> records;
+        GLdouble gpuOffset;  // CPU minus GPU clock in microseconds
+        Frame frame;
+        bool pending;
+    };
+
+    bool active, inFrame, published;
+    GLuint frameIndex, dropped;
+
+    std::mutex lock;   // Guards current against zones closing on other threads
+    Frame current;
+    Slot slots[PROF_GPU_FRAMES];
+    std::vector<GpuOpen> gpuOpen;
+    Frame last;
+
+    std::string tracePath;
+    GLuint traceLeft;
+    std::vector<Frame> trace;
+
+    Profiler();
+
+    GLdouble now() const;
+    GLuint query(Slot& _slot);
+    GLuint closeZone();
+    void resolve(Slot& _slot);
+    void publish(Frame& _frame);
+    bool writeTrace() const;
+
+    Profiler(const Profiler& ref) {}
+    const Profiler& operator=(const Profiler& rhs) { return *this; }
+};
+
+class CpuZone {
+ public:
+    explicit CpuZone(const char* _name): open(Profiler::instance().enabled()) {
+        if (open) Profiler::instance().beginZone(_name);
+    }
+    ~CpuZone() { if (open) Profiler::instance().endZone(); }
+
+ private:
+    bool open;
+};
+
+class GpuZone {
+ public:
+    explicit GpuZone(const char* _name): open(Profiler::instance().enabled()) {
+        if (open) Profiler::instance().beginGpuZone(_name);
+    }
+    ~GpuZone() { if (open) Profiler::instance().endGpuZone(); }
+
+ private:
+    bool open;
+};
+
+}  // namespace prof
+
+#endif
@@ -130,7 +130,8 @@ class Shader {
 };
 
 // Shader attributes for vertex shader
-enum Attrib_IDs  { ATTR_POS_ID, ATTR_NORM_ID, ATTR_TEX_ID, ATTR_TAN_ID, ATTR_BTAN_ID, ATTRIB_SZ };
+enum Attrib_IDs  { ATTR_POS_ID, ATTR_NORM_ID, ATTR_TEX_ID, ATTR_TAN_ID, ATTR_BTAN_ID,
+                   ATTR_JOINTS_ID, ATTR_WEIGHTS_ID, ATTR_MORPH_ID, ATTRIB_SZ };
 enum TextureType { TEX_DIFFUSE, TEX_SPECULAR, TEX_NORMAL, TEX_TYPE_SZ };
 
 static const GLuint MAX_SAMPLER_SZ = 3;
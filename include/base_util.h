@@ -6,9 +6,12 @@
  */
 
 #include <base.h>
+#include <base_metrics.h>
 #include <external/glm/vec3.hpp>
 
+#include <math.h>
 #include <stdio.h>
+#include <algorithm>
 #include <string>
 #include <sstream>
 
@@ -24,43 +27,204 @@ glm::vec3 color_random();
 glm::vec3 color(GLuint hex);
 
 // Default fpsCallback
-void show_fps(GLfloat fps);
+void show_fps(GLfloat fps, const metrics::Summary& frameTimes);
 
+// Query the current context's extension list (requires a current context)
+bool has_extension(const char* name);
+
+/* Frame rate along with the spread of frame times (microseconds) per interval,
+ * so a stutter shows up in the interval's max and p99 instead of averaging out */
 class FPSMetric {
-    typedef void (*fpsCallback)(GLfloat);
+    typedef void (*fpsCallback)(GLfloat, const metrics::Summary&);
 
  public:
     FPSMetric():
-        func_callback(show_fps), frame_count(0),
-        fps_disp_count(1), fps_interval(kFPSInterval) {}
+        func_callback(show_fps), recorder(NULL), last_time(-1.0),
+        interval_start(0.0), fps_interval(kFPSInterval) {}
 
     // FPS update interval. @see kFPSInterval
     void setInterval(GLfloat _fps_interval) { fps_interval = _fps_interval; }
     // Function to call in event of updated FPS metric
     void setCallback(fpsCallback callback) { func_callback = callback; }
+    // Frame times also go to _recorder, e.g. a registry histogram being exported
+    void setRecorder(metrics::Recorder* _recorder) { recorder = _recorder; }
 
     void frameUpdated(GLdouble elapsedTime) {
-        frame_count++;
+        if (last_time < 0.0) {
+            last_time = interval_start = elapsedTime;
+            return;
+        }
 
-        if (elapsedTime > fps_disp_count * fps_interval) {
+        GLuint64 us = (GLuint64) (1.0e6 * (elapsedTime - last_time));
+        frame_times.record(us);
+        if (recorder) recorder->record(us);
+        last_time = elapsedTime;
+
+        if (elapsedTime - interval_start > fps_interval) {
             if (func_callback != NULL) {
-                func_callback(frame_count /
-                    (elapsedTime - (fps_disp_count - 1) * fps_interval));
+                func_callback(frame_times.count() / (elapsedTime - interval_start),
+                    frame_times.summary());
             }
-            fps_disp_count++; frame_count = 0;
+            frame_times.reset();
+            interval_start = elapsedTime;
         }
     }
 
  private:
     fpsCallback func_callback;
+    metrics::Recorder* recorder;
+    metrics::Histogram frame_times;
 
-    uint64_t frame_count, fps_disp_count;
+    GLdouble last_time, interval_start;
     GLfloat fps_interval;
 
     // Interval in seconds between consecutive FPS updates
     static constexpr GLfloat kFPSInterval = 5.0f;
 };
 
+/* Measures GPU time spent on the commands issued between begin() and end()
+ * Queries are recycled through a small ring, so a result is only read back
+ * kQueryRingSz frames after it was issued and never stalls the pipeline */
+class GPUTimer {
+ public:
+    GPUTimer(): valid(false) {}
+
+    void init() {
+        if (valid) return;
+
+        glGenQueries(kQueryRingSz, queries);
+        head = pending = 0;
+        valid = true; reset();
+    }
+
+    void dispose() {
+        if (!valid) return;
+
+        glDeleteQueries(kQueryRingSz, queries);
+        valid = false;
+    }
+
+    void begin() {
+        if (!valid) return;
+
+        // Slot at head holds the oldest result when the ring is full
+        if (pending == kQueryRingSz) collect();
+        glBeginQuery(GL_TIME_ELAPSED, queries[head]);
+    }
+
+    void end() {
+        if (!valid) return;
+
+        glEndQuery(GL_TIME_ELAPSED);
+        head = (head + 1) % kQueryRingSz;
+        pending++;
+    }
+
+    // Average GPU time in milliseconds since the last reset
+    GLdouble average() const {
+        return sample_count ? total_ns / 1.0e6 / sample_count : 0.0;
+    }
+    GLuint samples() const { return sample_count; }
+    /* Queries still in flight are dropped too, so the next average only
+     * covers work issued after the reset; reissuing them needs no wait */
+    void reset() { total_ns = 0; sample_count = 0; pending = 0; }
+
+ private:
+    static const GLuint kQueryRingSz = 4;
+
+    GLuint queries[kQueryRingSz];
+    GLuint head, pending, sample_count;
+    GLuint64 total_ns;
+    bool valid;
+
+    void collect() {
+        GLuint64 elapsed;
+        glGetQueryObjectui64v(queries[head], GL_QUERY_RESULT, &elapsed);
+        total_ns += elapsed; sample_count++;
+        pending--;
+    }
+};
+
+/* Holds frames to a target rate without vsync. Sleeps until shortly before
+ * the deadline and spins the rest, as sleeps alone overshoot by the
+ * scheduler's granularity. Deadlines advance by whole periods, so one late
+ * frame doesn't shift the ones after it */
+class FrameLimiter {
+ public:
+    FrameLimiter(): period_ns(0), spin_ns(kSpinNs), deadline_ns(0) {}
+
+    // Frames per second, 0 disables
+    void setRate(GLdouble _fps) {
+        period_ns = _fps > 0.0 ? (int64_t) (1.0e9 / _fps) : 0;
+        deadline_ns = 0;
+    }
+    GLdouble rate() const { return period_ns ? 1.0e9 / period_ns : 0.0; }
+    bool enabled() const { return period_ns != 0; }
+
+    // Time before the deadline left to spinning, wider on coarse schedulers
+    void setSpin(GLdouble _seconds) { spin_ns = (int64_t) (_seconds * 1.0e9); }
+
+    // Returns once the next frame is due
+    void wait();
+
+ private:
+    int64_t period_ns, spin_ns, deadline_ns;
+
+    static const int64_t kSpinNs = 1000000;
+};
+
+// Spread of the intervals between consecutive frames, in milliseconds
+class FramePacing {
+ public:
+    FramePacing(): last_time(-1.0) { reset(); }
+
+    void frameUpdated(GLdouble elapsedTime) {
+        if (last_time >= 0.0) {
+            GLdouble dt = elapsedTime - last_time;
+            sum += dt; sum_sq += dt * dt;
+            worst_dt = std::max(worst_dt, dt);
+            frame_count++;
+        }
+        last_time = elapsedTime;
+    }
+
+    GLdouble mean() const { return frame_count ? 1000.0 * sum / frame_count : 0.0; }
+    GLdouble deviation() const {
+        if (frame_count < 2) return 0.0;
+        GLdouble m = sum / frame_count;
+        return 1000.0 * sqrt(std::max(0.0, sum_sq / frame_count - m * m));
+    }
+    GLdouble worst() const { return 1000.0 * worst_dt; }
+    GLuint frames() const { return frame_count; }
+
+    // Starts a new window, the next interval still counts from the last frame
+    void reset() { sum = sum_sq = worst_dt = 0.0; frame_count = 0; }
+
+ private:
+    GLdouble last_time, sum, sum_sq, worst_dt;
+    GLuint frame_count;
+};
+
+/* Two copies of a frame's state: one side writes back() while the other
+ * reads front(), swap() hands the written copy over. Callers make sure
+ * neither side is busy during swap() */
+template <typename T>
+class DoubleBuffer {
+ public:
+    DoubleBuffer(): cur(0) {}
+
+    inline T& back() { return buffers[cur ^ 1]; }
+    inline const T& front() const { return buffers[cur]; }
+    // Both copies, for resizing them together
+    inline T& operator[](GLuint _i) { return buffers[_i]; }
+
+    void swap() { cur ^= 1; }
+
+ private:
+    T buffers[2];
+    GLuint cur;
+};
+
 inline std::string itos(int num) {
     std::stringstream ostr;
     ostr << num; return ostr.str();
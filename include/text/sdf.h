@@ -0,0 +1,34 @@
+#ifndef __SDF_H__
+#define __SDF_H__
+
+/**
+ * Signed distance field generation for glyphs
+ * @author: Methusael Murmu
+ */
+
+#include <base.h>
+
+#include <vector>
+
+namespace text {
+
+// Single channel glyph image, rows top to bottom
+struct GlyphBitmap {
+    GLuint width, rows;
+    std::vector<GLubyte> pixels;
+
+    GlyphBitmap(): width(0), rows(0) {}
+};
+
+/* Converts a coverage bitmap rendered _upscale times larger than the target
+ * size into a distance field of the target size
+ * The glyph is placed _offsetX, _offsetY high resolution texels into the
+ * field, after a border of _spread target texels on each side. Distances are
+ * exact (separable euclidean distance transform) and stored as 0.5 on the
+ * outline, rising to 1 _spread texels inside and falling to 0 outside */
+void generateSDF(const GlyphBitmap& _hires, GLuint _upscale, GLuint _spread,
+                 GLuint _offsetX, GLuint _offsetY, GlyphBitmap& _sdf);
+
+}  // namespace text
+
+#endif
@@ -8,6 +8,7 @@
 
 #include <base.h>
 #include <base_shader.h>
+#include <text/sdf.h>
 #include <ft2build.h>
 #include FT_FREETYPE_H
 
@@ -15,48 +16,207 @@
 #include <external/glm/vec3.hpp>
 #include <external/glm/gtc/type_ptr.hpp>
 
+#include <list>
 #include <string>
+#include <vector>
+#include <algorithm>
+#include <unordered_map>
 
-#define MAX_CHAR_SZ 128
+#define GLYPH_ATLAS_SIZE 512
+#define GLYPH_PADDING 1     // Texels kept clear around glyphs against filtering bleed
+#define GLYPH_REPLACEMENT 0xfffd
+
+// Distance field fonts: glyph size, distance range (texels), rasterization factor
+#define SDF_GLYPH_SIZE 32
+#define SDF_SPREAD 4
+#define SDF_UPSCALE 8
+#define SDF_CACHE_VERSION 3
+#define SDF_PARALLEL_MIN 8  // Misses in one request worth spreading over threads
 
 namespace text {
 
 // Individual character data
 struct Char {
-    GLuint      texId;
+    glm::vec2   uvMin, uvMax;   // Region of the glyph atlas
     glm::ivec2  size;
     glm::ivec2  bearing;
     int64_t     advance;
 };
 
+/* Decodes the code point starting at _pos of a UTF-8 string and moves _pos past it
+ * Malformed sequences decode to U+FFFD, one byte at a time; overlong forms,
+ * surrogates and code points past U+10FFFF count as malformed */
+inline GLuint decodeUTF8(const std::string& _str, size_t& _pos) {
+    GLubyte lead = _str[_pos++];
+    if (lead < 0x80) return lead;
+
+    static const GLuint kMinCode[4] = { 0, 0x80, 0x800, 0x10000 };
+    GLuint extra, code;
+    if ((lead & 0xe0) == 0xc0) { extra = 1; code = lead & 0x1f; }
+    else if ((lead & 0xf0) == 0xe0) { extra = 2; code = lead & 0x0f; }
+    else if ((lead & 0xf8) == 0xf0) { extra = 3; code = lead & 0x07; }
+    else return GLYPH_REPLACEMENT;
+
+    size_t next = _pos;
+    for (GLuint i = 0; i < extra; ++i) {
+        if (next >= _str.size() || (_str[next] & 0xc0) != 0x80)
+            return GLYPH_REPLACEMENT;
+        code = (code << 6) | (_str[next++] & 0x3f);
+    }
+    if (code < kMinCode[extra] || (code >= 0xd800 && code <= 0xdfff) || code > 0x10ffff)
+        return GLYPH_REPLACEMENT;
+
+    _pos = next;
+    return code;
+}
+
+/* Lazily rasterized font
+ * Glyphs are looked up by Unicode code point and rasterized on first use into
+ * fixed size cells of one atlas texture. When the atlas is full, the least
+ * recently used glyph is evicted; glyphs used by the current batch are never
+ * evicted. Distance field glyphs are also kept in a disk cache next to the font
+ * file, so they are only generated once */
 struct FontData {
     GLuint vAO, vBO;
+    GLuint texId;               // Glyph atlas (single channel)
     GLuint maxHeight;
-    Char charMap[MAX_CHAR_SZ];
+    GLuint height;              // Pixel height the glyph metrics are given at
+    bool sdf;                   // Atlas holds distance fields instead of coverage
 
     FontData(): valid(false) {}
     ~FontData() { clean(); }
 
     GLint loadFonts(const GLchar* font_file, GLint height);
+    // Distance field glyphs, for rendering at any scale with a distance field shader
+    GLint loadSDF(const GLchar* font_file, GLint height = SDF_GLYPH_SIZE);
     void clean();
 
     const bool isValid() const { return valid; }
 
+    // Makes the glyphs of all code points resident, misses are rasterized together
+    void require(const std::vector<GLuint>& codes);
+    // Resident glyph of a code point (rasterized if needed), NULL if it can't be
+    const Char* glyph(GLuint code);
+    // Same, for glyphs already required: NULL if require() dropped it, no retry
+    const Char* resident(GLuint code);
+    // Glyphs used so far may be evicted again once their batch is drawn
+    void endBatch() { batchStamp++; }
+
+    // Center of an atlas cell kept fully covered, for solid quads in text batches
+    const glm::vec2& solidUV() const { return solid; }
+
+    GLuint residentCount() const { return glyphs.size(); }
+    GLuint cellCount() const { return cellsPerRow * cellsPerRow; }
+    // Bumped whenever a glyph leaves the atlas, invalidating laid out texture coords
+    GLuint evictionCount() const { return evictions; }
+
+    // Horizontal kerning between two code points, in pixels at the font height
+    GLfloat kerning(GLuint left, GLuint right) const;
+
  private:
-    bool valid;
+    struct Entry {
+        Char ch;
+        GLuint cell, stamp;
+        std::list<GLuint>::iterator lru;
+    };
+
+    // Rasterized glyph ready for upload
+    struct Raster {
+        Char ch;
+        GlyphBitmap bitmap;
+    };
+
+    bool valid, cacheDirty;
+    std::string cachePath;
+    int64_t fontBytes, fontTime;  // Of the font file the cache was made from
+
+    FT_Library ft;
+    FT_Face face;
+
+    GLuint cellSize, cellsPerRow, batchStamp, evictions;
+    glm::vec2 solid;
+    std::vector<GLuint> freeCells;
+    std::list<GLuint> lruList;  // Most recently used first
+    std::unordered_map<GLuint, Entry> glyphs;
+    std::unordered_map<GLuint, Raster> sdfCache;
+
+    GLint openFace(const GLchar* font_file, GLuint pixelHeight);
+    void createObjects();
+
+    void touch(Entry& entry);
+    bool rasterize(GLuint code, Raster& raster, GlyphBitmap& hires, glm::uvec2& offset);
+    bool insert(GLuint code, const Raster& raster);
+
+    void readCache();
+    void writeCache() const;
 };
 
-// Use this to render fonts on quads using a given FontData
+// A line of retained text
+struct TextLine {
+    std::string str;
+    GLfloat x, y, scale;
+};
+
+/* Retained text, laid out once into its own vertex buffer
+ * Drawn with a single call each frame; the layout is only rebuilt when a line
+ * changes, the mesh is drawn with another font, or a glyph left the atlas */
+class TextMesh {
+ public:
+    TextMesh(): vAO(0), vBO(0), vertCount(0), font(NULL), evictions(0), dirty(true) {}
+    ~TextMesh() { clean(); }
+
+    void setLine(GLuint _idx, const std::string& _str,
+                 GLfloat _x, GLfloat _y, GLfloat _scale) {
+        if (_idx >= lines.size()) lines.resize(_idx + 1);
+
+        TextLine& line = lines[_idx];
+        if (line.str == _str && line.x == _x && line.y == _y && line.scale == _scale)
+            return;
+
+        line.str = _str; line.x = _x; line.y = _y; line.scale = _scale;
+        dirty = true;
+    }
+
+    void clear() { lines.clear(); dirty = true; }
+
+    void clean() {
+        if (!vAO) return;
+
+        glDeleteBuffers(1, &vBO);
+        glDeleteVertexArrays(1, &vAO);
+        vAO = vBO = 0;
+        dirty = true;
+    }
+
+ private:
+    friend class FontRenderer;
+
+    GLuint vAO, vBO, vertCount;
+    const FontData* font;       // Font the layout was made with
+    GLuint evictions;           // Font eviction count at layout time
+    bool dirty;
+    std::vector<TextLine> lines;
+};
+
+/* Use this to render fonts on quads using a given FontData
+ * Glyph quads are batched into one vertex buffer upload and one draw call:
+ * renderText draws a single string, queueText and flush draw many.
+ * Text that rarely changes is better kept in a TextMesh */
 class FontRenderer {
  private:
     glm::vec3 color;
-    GLfloat qVert[4][4];
+    std::vector<GLfloat> batch;  // 6 vertices (x, y, u, v) per glyph
+    std::vector<GLuint> codes;   // Code points of the string being laid out
 
     bool initCalled;
 
     static const GLchar* const kTextUniform;
     static const GLchar* const kTextColorUniform;
 
+    // Appends the glyph quads of a string, kerned, to _verts
+    void layout(const std::string& str, GLfloat x, GLfloat y, GLfloat scale,
+                std::vector<GLfloat>& _verts);
+
  public:
     FontRenderer(): initCalled(false) {}
 
@@ -65,12 +225,6 @@ class FontRenderer {
         _shader->use();
         glUniform1i(glGetUniformLocation(_shader->getProgram(), kTextUniform), 0);
 
-        // Texture coords (inverted on Y axis)
-        qVert[0][2] = 0.0; qVert[0][3] = 0.0;
-        qVert[1][2] = 0.0; qVert[1][3] = 1.0;
-        qVert[2][2] = 1.0; qVert[2][3] = 0.0;
-        qVert[3][2] = 1.0; qVert[3][3] = 1.0;
-
         initCalled = true;
     }
 
@@ -84,7 +238,21 @@ class FontRenderer {
     }
 
     void renderText(const glf::Shader* _shader, const std::string& str,
-                    GLfloat x, GLfloat y, GLfloat scale);
+                    GLfloat x, GLfloat y, GLfloat scale) {
+        queueText(str, x, y, scale);
+        flush(_shader);
+    }
+
+    // Lays out a string into the pending batch
+    void queueText(const std::string& str, GLfloat x, GLfloat y, GLfloat scale);
+    // Adds a filled rectangle in the text color to the pending batch
+    void queueQuad(GLfloat x, GLfloat y, GLfloat w, GLfloat h);
+    // Draws and clears the pending batch
+    void flush(const glf::Shader* _shader);
+
+    // Draws retained text, laying it out again first if it went stale
+    void renderText(const glf::Shader* _shader, TextMesh& mesh);
+
     FontData* font;
 };
 
@@ -0,0 +1,266 @@
+#include <animator/anim.h>
+#include <animator/anim_system.h>
+#include <animator/track.h>
+#include <animator/clip_compress.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <chrono>
+#include <new>
+#include <thread>
+#include <vector>
+
+/**
+ * Steps the same properties through AnimatorRegistry and AnimationSystem,
+ * checks that PropertyAnimators stay off the heap, plays keyframe tracks and
+ * compresses a library of clips, then measures job system scaling
+ * Usage: anim_bench [properties] [frames]
+ * @author: Methusael Murmu
+ */
+
+typedef std::chrono::high_resolution_clock Clock;
+
+static const GLfloat kFrameTime = 1.0f / 60.0f;
+
+// Every operator new in the process goes through here
+static uint64_t allocations = 0;
+
+void* operator new(size_t sz) {
+    ++allocations;
+    void* ptr = malloc(sz ? sz : 1);
+    if (ptr == NULL) throw std::bad_alloc();
+    return ptr;
+}
+
+void operator delete(void* ptr) noexcept { free(ptr); }
+
+static inline GLdouble millisSince(const Clock::time_point& start) {
+    return std::chrono::duration<GLdouble, std::milli>(Clock::now() - start).count();
+}
+
+// Plays Hermite vec3 tracks forward, with and without cursors
+static void benchTracks(GLuint count, GLuint keys, GLuint frames) {
+    std::vector<anim::Track<glm::vec3> > tracks(count, anim::Track<glm::vec3>(anim::KEY_HERMITE));
+    for (GLuint t = 0; t < count; ++t) {
+        for (GLuint k = 0; k < keys; ++k) {
+            glm::vec3 v(sinf(k * 0.1f + t), cosf(k * 0.1f), k * 0.01f);
+            tracks[t].addKey(k * 0.25f, v, v * 0.5f, v * 0.5f);
+        }
+    }
+
+    std::vector<anim::TrackCursor> cursors(count);
+    GLfloat duration = tracks[0].duration(), sum = 0.0f;
+
+    Clock::time_point start = Clock::now();
+    for (GLuint f = 0; f < frames; ++f) {
+        GLfloat time = duration * f / frames;
+        for (GLuint t = 0; t < count; ++t) sum += tracks[t].evaluate(time, cursors[t]).x;
+    }
+    GLdouble cursorMs = millisSince(start) / frames;
+
+    start = Clock::now();
+    for (GLuint f = 0; f < frames; ++f) {
+        GLfloat time = duration * f / frames;
+        for (GLuint t = 0; t < count; ++t) sum += tracks[t].evaluate(time).x;
+    }
+    GLdouble searchMs = millisSince(start) / frames;
+
+    size_t bytes = 0, quantBytes = 0;
+    for (GLuint t = 0; t < count; ++t) {
+        bytes += tracks[t].memoryUsage();
+        tracks[t].quantize();
+        quantBytes += tracks[t].memoryUsage();
+    }
+
+    printf("%u tracks x %u keys (checksum %.1f)\n", count, keys, sum);
+    printf("Cursor lookup:          %8.3f ms/frame\n", cursorMs);
+    printf("Binary search lookup:   %8.3f ms/frame\n", searchMs);
+    printf("Key memory:             %8.1f KiB, %.1f KiB quantized\n",
+        bytes / 1024.0, quantBytes / 1024.0);
+}
+
+// Chain of _joints joints
+static void makeSkeleton(anim::Skeleton& skeleton, GLuint joints) {
+    for (GLuint j = 0; j < joints; ++j)
+        skeleton.add("joint", GLint(j) - 1, glm::vec3(0.0f, 0.1f, 0.0f), glm::quat(), glm::vec3(1.0f));
+}
+
+// Keys all joints at 30 Hz, every third joint stands still
+static void makeClip(anim::AnimationClip& clip, GLuint index, GLuint joints) {
+    char name[32]; snprintf(name, sizeof(name), "clip%02u", index);
+    clip.name = name; clip.duration = 1.0f + index % 4;
+
+    for (GLuint j = 0; j < joints; ++j) {
+        GLfloat amp = j % 3 ? 0.8f : 0.0f, freq = 1.0f + (j + index) % 5;
+        glm::vec3 axis = glm::normalize(glm::vec3(1.0f, GLfloat(j % 4), 0.5f));
+        anim::Track<glm::vec3> t, s;
+        anim::Track<glm::quat> r;
+        for (GLuint k = 0; k <= clip.duration * 30; ++k) {
+            GLfloat time = k / 30.0f;
+            t.addKey(time, glm::vec3(0.0f, 0.1f, 0.05f * amp * sinf(freq * time)));
+            r.addKey(time, glm::angleAxis(amp * sinf(freq * time), axis));
+            s.addKey(time, glm::vec3(1.0f));
+        }
+        clip.joints.push_back(j);
+        clip.translations.push_back(t); clip.rotations.push_back(r); clip.scales.push_back(s);
+    }
+}
+
+static void benchClips(GLuint clipCount, GLuint joints, GLuint frames) {
+    anim::Skeleton skeleton;
+    makeSkeleton(skeleton, joints);
+
+    std::vector<anim::AnimationClip> clips(clipCount);
+    std::vector<std::vector<GLubyte> > blobs(clipCount);
+    std::vector<anim::CompressedClip> packed(clipCount);
+    size_t rawBytes = 0, bytes = 0;
+
+    for (GLuint c = 0; c < clipCount; ++c) {
+        anim::AnimationClip& clip = clips[c];
+        makeClip(clip, c, joints);
+
+        anim::ClipCompressor::compress(clip, anim::ClipCompression(), blobs[c]);
+        packed[c].load(&blobs[c][0], blobs[c].size());
+        anim::ClipReport report = anim::ClipCompressor::measure(clip, packed[c]);
+        rawBytes += report.rawBytes; bytes += report.bytes;
+        if (c < 4) anim::printClipReport(report);
+    }
+
+    anim::SkeletonPose pose(&skeleton);
+    Clock::time_point start = Clock::now();
+    for (GLuint f = 0; f < frames; ++f)
+        for (GLuint c = 0; c < clipCount; ++c) pose.sample(clips[c], f * kFrameTime);
+    GLdouble rawMs = millisSince(start) / frames;
+
+    start = Clock::now();
+    for (GLuint f = 0; f < frames; ++f)
+        for (GLuint c = 0; c < clipCount; ++c) packed[c].sample(pose, f * kFrameTime);
+    GLdouble packedMs = millisSince(start) / frames;
+
+    printf("%u clips x %u joints\n", clipCount, joints);
+    printf("Raw clip sampling:      %8.3f ms/frame, %.1f KiB\n", rawMs, rawBytes / 1024.0);
+    printf("Packed clip sampling:   %8.3f ms/frame, %.1f KiB\n", packedMs, bytes / 1024.0);
+}
+
+// Same work on job systems of 1 to hardware threads: property steps and character poses
+static void benchScaling(GLuint count, GLuint characters, GLuint frames) {
+    anim::AnimationSystem props;
+    for (GLuint i = 0; i < count; ++i) {
+        props.add(0.0f, 1.0f, 0.5f + (i % 7), static_cast<anim::InterpolatorType>(i % ANIM_INTERPOLATOR_SZ),
+            static_cast<anim::AnimatorLoopType>((i / ANIM_INTERPOLATOR_SZ) % ANIM_LOOP_SZ));
+    }
+
+    const GLuint joints = 60;
+    anim::Skeleton skeleton;
+    anim::AnimationClip clip;
+    makeSkeleton(skeleton, joints);
+    makeClip(clip, 0, joints);
+
+    std::vector<anim::SkeletonPose> poses(characters, anim::SkeletonPose(&skeleton));
+    std::vector<anim::PoseJob> poseJobs(characters);
+    std::vector<glm::mat4> palettes(characters * joints);
+    for (GLuint i = 0; i < characters; ++i) {
+        poseJobs[i].pose = &poses[i]; poseJobs[i].clip = &clip;
+        poseJobs[i].palette = &palettes[i * joints];
+    }
+
+    printf("Job system scaling: %u properties, %u characters x %u joints\n", count, characters, joints);
+    printf("Threads   step ms  speedup   pose ms  speedup\n");
+
+    GLdouble stepBase = 0.0, poseBase = 0.0;
+    GLuint hardware = std::max(1u, std::thread::hardware_concurrency());
+    for (GLuint threads = 1; threads <= hardware; threads = threads == hardware ? hardware + 1 :
+            std::min(threads * 2, hardware)) {
+        jobs::JobSystem pool(threads);
+
+        Clock::time_point start = Clock::now();
+        for (GLuint f = 0; f < frames; ++f) props.stepParallel(kFrameTime, pool);
+        GLdouble stepMs = millisSince(start) / frames;
+
+        start = Clock::now();
+        for (GLuint f = 0; f < frames; ++f) {
+            for (GLuint i = 0; i < characters; ++i) poseJobs[i].time = f * kFrameTime + i * 0.37f;
+            anim::runPoseJobs(poseJobs, pool);
+        }
+        GLdouble poseMs = millisSince(start) / frames;
+
+        if (threads == 1) { stepBase = stepMs; poseBase = poseMs; }
+        printf("%7u %9.3f %7.2fx %9.3f %7.2fx\n", threads, stepMs, stepBase / stepMs,
+            poseMs, poseBase / poseMs);
+    }
+}
+
+int main(int argc, char* argv[]) {
+    GLuint count = argc > 1 ? atoi(argv[1]) : 100000;
+    GLuint frames = argc > 2 ? atoi(argv[2]) : 600;
+    GLuint workers = jobs::JobSystem::instance().threadCount();
+
+    // Same mix of interpolators, loops and durations on both sides
+    std::vector<anim::PropertyAnimator<GLfloat> > animators(count);
+    anim::AnimatorRegistry<GLfloat> registry;
+    anim::AnimationSystem system, parallel;
+    std::vector<anim::AnimHandle> handles(count);
+
+    srand(7);
+    for (GLuint i = 0; i < count; ++i) {
+        anim::InterpolatorType ip = static_cast<anim::InterpolatorType>(i % ANIM_INTERPOLATOR_SZ);
+        anim::AnimatorLoopType loop = static_cast<anim::AnimatorLoopType>((i / ANIM_INTERPOLATOR_SZ) % ANIM_LOOP_SZ);
+        GLfloat duration = 0.5f + 4.0f * rand() / RAND_MAX;
+
+        animators[i].set(0.0f, 1.0f, duration);
+        animators[i].setLoopType(loop);
+        animators[i].setInterpolator(anim::InterpolatorFactory<GLfloat>::create(ip));
+        registry.add(&animators[i]);
+
+        handles[i] = system.add(0.0f, 1.0f, duration, ip, loop);
+        parallel.add(0.0f, 1.0f, duration, ip, loop);
+    }
+
+    // Create, copy and step animators, none of which may allocate
+    std::vector<anim::PropertyAnimator<GLfloat> > scratch(count);
+    uint64_t allocsBefore = allocations;
+    Clock::time_point start = Clock::now();
+    for (GLuint i = 0; i < count; ++i) {
+        anim::PropertyAnimator<GLfloat> animator(0.0f, 1.0f, 2.0f);
+        animator.setInterpolator(anim::InterpolatorFactory<GLfloat>::create(anim::SINE));
+        animator.step(kFrameTime);
+        scratch[(i * 7) % count] = animator;
+        scratch[i] = scratch[(i * 7) % count];
+    }
+    GLdouble copyMs = millisSince(start);
+    uint64_t animatorAllocs = allocations - allocsBefore;
+
+    allocsBefore = allocations;
+    start = Clock::now();
+    for (GLuint f = 0; f < frames; ++f) registry.animate(kFrameTime);
+    GLdouble registryMs = millisSince(start) / frames;
+    animatorAllocs += allocations - allocsBefore;
+
+    start = Clock::now();
+    for (GLuint f = 0; f < frames; ++f) system.step(kFrameTime);
+    GLdouble systemMs = millisSince(start) / frames;
+
+    start = Clock::now();
+    for (GLuint f = 0; f < frames; ++f) parallel.stepParallel(kFrameTime);
+    GLdouble parallelMs = millisSince(start) / frames;
+
+    GLfloat maxErr = 0.0f;
+    for (GLuint i = 0; i < count; ++i)
+        maxErr = std::max(maxErr, fabsf(animators[i].value() - system.value(handles[i])));
+
+    printf("%u properties, %u frames\n", count, frames);
+    printf("AnimatorRegistry:       %8.3f ms/frame\n", registryMs);
+    printf("AnimationSystem:        %8.3f ms/frame (%.1fx)\n", systemMs, registryMs / systemMs);
+    printf("AnimationSystem x%-2u:    %8.3f ms/frame (%.1fx)\n",
+        workers, parallelMs, registryMs / parallelMs);
+    printf("Max value difference:   %8.4f\n", maxErr);
+    printf("Create/copy/step x%u:   %8.3f ms, %llu allocations\n",
+        count, copyMs, static_cast<unsigned long long>(animatorAllocs));
+
+    benchTracks(count / 100, 1024, frames);
+    benchClips(64, 60, frames);
+    benchScaling(count * 10, 512, frames);
+
+    return animatorAllocs == 0 ? 0 : 1;
+}
@@ -4,5 +4,5 @@
  * @author: Methusael Murmu
  */
 
-char glf::BaseApp::base_fps_str[15] = { 0 };
+char glf::BaseApp::base_fps_str[BASE_FPS_STR_SIZE] = { 0 };
 glf::BaseApp* glf::BaseApp::app = NULL;
@@ -0,0 +1,284 @@
+#include <base_framedump.h>
+#include <base_gpumem.h>
+
+#include <string.h>
+#include <zlib.h>
+#include <chrono>
+
+/**
+ * @author: Methusael Murmu
+ */
+
+#define FRAMEDUMP_WAIT_NS 1000000000ull  // Per wait on a fence, retried until it passes
+
+namespace glf {
+
+static inline void putBE32(GLubyte* _out, GLuint _value) {
+    _out[0] = _value >> 24; _out[1] = _value >> 16;
+    _out[2] = _value >> 8;  _out[3] = _value;
+}
+
+static void writeChunk(FILE* _fp, const char* _type, const GLubyte* _data, GLuint _size) {
+    GLubyte word[4];
+    putBE32(word, _size);
+    fwrite(word, 1, 4, _fp);
+    fwrite(_type, 1, 4, _fp);
+    if (_size) fwrite(_data, 1, _size, _fp);
+
+    uLong crc = crc32(0L, (const Bytef*) _type, 4);
+    if (_size) crc = crc32(crc, _data, _size);
+    putBE32(word, (GLuint) crc);
+    fwrite(word, 1, 4, _fp);
+}
+
+FrameDumper::FrameDumper():
+    format(PNG), running(false), limit(0), head(0), inFlight(0), width(0), height(0),
+    captured(0), written(0), gpuWaits(0), encoderWaits(0), quit(false), raw(NULL) {
+    for (GLuint i = 0; i < FRAMEDUMP_RING; ++i) {
+        ring[i].pbo = 0;
+        ring[i].fence = 0;
+    }
+}
+
+bool FrameDumper::start(const std::string& _prefix, Format _format, GLuint _frames) {
+    finish();
+
+    if (_format == RAW) {
+        std::string path = _prefix + ".rgba";
+        raw = fopen(path.c_str(), "wb");
+        if (!raw) {
+            fprintf(stderr, "Frame dump: unable to open %s\n", path.c_str());
+            return false;
+        }
+    }
+
+    prefix = _prefix;
+    format = _format;
+    limit = _frames;
+    captured = written = gpuWaits = encoderWaits = 0;
+    captureTimes.reset();
+    quit = false;
+    encoder = std::thread(&FrameDumper::encodeLoop, this);
+    running = true;
+    return true;
+}
+
+void FrameDumper::capture(GLsizei _width, GLsizei _height) {
+    if (!running || _width <= 0 || _height <= 0) return;
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    if (_width != width || _height != height) {
+        while (inFlight) collect(true);
+        resize(_width, _height);
+    }
+
+    // Pass on what the GPU is done with, wait only when every slot is busy
+    while (inFlight && ready(ring[head])) collect(false);
+    if (inFlight == FRAMEDUMP_RING) {
+        gpuWaits++;
+        collect(true);
+    }
+
+    // Framebuffers are always bound before use, so the read binding isn't put back
+    Slot& slot = ring[(head + inFlight) % FRAMEDUMP_RING];
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, 0);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.pbo);
+    glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, BUFFER_OFFSET(0));
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    slot.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    inFlight++;
+    captured++;
+
+    captureTimes.record(std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now() - start).count());
+    if (limit && captured >= limit) finish();
+}
+
+void FrameDumper::finish() {
+    if (!running) return;
+    running = false;
+
+    while (inFlight) collect(true);
+    release();
+
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        quit = true;
+    }
+    signal.notify_all();
+    encoder.join();
+
+    for (size_t i = 0; i < spare.size(); ++i) delete spare[i];
+    spare.clear();
+    if (raw) {
+        fclose(raw);
+        raw = NULL;
+    }
+
+    fprintf(stdout, "Frame dump: %u of %u frames written to %s%s, capture %.3f ms p50 "
+        "%.3f ms p99, waited on the GPU %u times, on the encoder %u times\n", written, captured,
+        prefix.c_str(), format == RAW ? ".rgba" : "_*.png", captureTimes.percentile(50.0) / 1000.0,
+        captureTimes.percentile(99.0) / 1000.0, gpuWaits, encoderWaits);
+}
+
+// Only with nothing in flight
+void FrameDumper::resize(GLsizei _width, GLsizei _height) {
+    release();
+    width = _width;
+    height = _height;
+
+    GPU_OWNER("Frame dump");
+    for (GLuint i = 0; i < FRAMEDUMP_RING; ++i) {
+        glGenBuffers(1, &ring[i].pbo);
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, ring[i].pbo);
+        glBufferData(GL_PIXEL_PACK_BUFFER, (GLsizeiptr) width * height * 4, NULL, GL_STREAM_READ);
+    }
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    head = 0;
+}
+
+void FrameDumper::release() {
+    for (GLuint i = 0; i < FRAMEDUMP_RING; ++i) {
+        if (ring[i].fence) glDeleteSync(ring[i].fence);
+        if (ring[i].pbo) glDeleteBuffers(1, &ring[i].pbo);
+        ring[i].pbo = 0;
+        ring[i].fence = 0;
+    }
+    width = height = 0;
+}
+
+bool FrameDumper::ready(const Slot& _slot) {
+    GLenum status = glClientWaitSync(_slot.fence, 0, 0);
+    return status == GL_ALREADY_SIGNALED || status == GL_CONDITION_SATISFIED;
+}
+
+// Maps the oldest readback, waiting for it with _wait, and queues a copy
+void FrameDumper::collect(bool _wait) {
+    Slot& slot = ring[head];
+    if (_wait) {
+        GLenum status;
+        do {
+            status = glClientWaitSync(slot.fence, GL_SYNC_FLUSH_COMMANDS_BIT, FRAMEDUMP_WAIT_NS);
+        } while (status == GL_TIMEOUT_EXPIRED);
+    }
+    glDeleteSync(slot.fence);
+    slot.fence = 0;
+
+    Frame* frame;
+    {
+        std::unique_lock<std::mutex> guard(lock);
+        if (queue.size() >= FRAMEDUMP_QUEUE) {
+            encoderWaits++;
+            while (queue.size() >= FRAMEDUMP_QUEUE) signal.wait(guard);
+        }
+        if (spare.empty()) {
+            frame = new Frame();
+        } else {
+            frame = spare.back();
+            spare.pop_back();
+        }
+    }
+
+    size_t size = (size_t) width * height * 4;
+    frame->index = captured - inFlight;
+    frame->width = width;
+    frame->height = height;
+    frame->pixels.resize(size);
+
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.pbo);
+    const void* mapped = glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, size, GL_MAP_READ_BIT);
+    if (mapped) {
+        memcpy(&frame->pixels[0], mapped, size);
+        glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+    }
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+    head = (head + 1) % FRAMEDUMP_RING;
+    inFlight--;
+
+    std::lock_guard<std::mutex> guard(lock);
+    if (mapped) {
+        queue.push_back(frame);
+        signal.notify_all();
+    } else {
+        fprintf(stderr, "Frame dump: unable to map frame %u\n", frame->index);
+        spare.push_back(frame);
+    }
+}
+
+// Drains the queue before quitting
+void FrameDumper::encodeLoop() {
+    std::unique_lock<std::mutex> guard(lock);
+    for (;;) {
+        while (queue.empty() && !quit) signal.wait(guard);
+        if (queue.empty()) break;
+
+        Frame* frame = queue.front();
+        queue.pop_front();
+        guard.unlock();
+
+        if (format == PNG) writePNG(*frame);
+        else writeRaw(*frame);
+
+        guard.lock();
+        spare.push_back(frame);
+        signal.notify_all();
+    }
+}
+
+/* Rows are flipped to top first and filtered with Sub, which predicts each
+ * byte from the pixel to its left; alpha is dropped, as the back buffer's
+ * holds whatever blending left there */
+void FrameDumper::writePNG(const Frame& _frame) {
+    GLsizei w = _frame.width, h = _frame.height;
+    size_t line = (size_t) w * 3 + 1;
+    rows.resize(line * h);
+    for (GLsizei y = 0; y < h; ++y) {
+        const GLubyte* src = &_frame.pixels[(size_t) (h - 1 - y) * w * 4];
+        GLubyte* dst = &rows[y * line];
+        *dst++ = 1;
+        for (GLint c = 0; c < 3; ++c) dst[c] = src[c];
+        for (GLsizei x = 1; x < w; ++x)
+            for (GLint c = 0; c < 3; ++c)
+                dst[x * 3 + c] = src[x * 4 + c] - src[(x - 1) * 4 + c];
+    }
+
+    uLongf size = compressBound(rows.size());
+    packed.resize(size);
+    if (compress2(&packed[0], &size, &rows[0], rows.size(), FRAMEDUMP_PNG_LEVEL) != Z_OK) {
+        fprintf(stderr, "Frame dump: unable to compress frame %u\n", _frame.index);
+        return;
+    }
+
+    char path[32];
+    snprintf(path, sizeof(path), "_%05u.png", _frame.index);
+    std::string file = prefix + path;
+    FILE* fp = fopen(file.c_str(), "wb");
+    if (!fp) {
+        fprintf(stderr, "Frame dump: unable to open %s\n", file.c_str());
+        return;
+    }
+
+    static const GLubyte signature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n' };
+    GLubyte header[13];
+    putBE32(header, w);
+    putBE32(header + 4, h);
+    header[8] = 8;   // Bits per channel
+    header[9] = 2;   // RGB
+    header[10] = header[11] = header[12] = 0;  // Deflate, adaptive filtering, no interlace
+
+    fwrite(signature, 1, sizeof(signature), fp);
+    writeChunk(fp, "IHDR", header, sizeof(header));
+    writeChunk(fp, "IDAT", &packed[0], (GLuint) size);
+    writeChunk(fp, "IEND", NULL, 0);
+    if (fclose(fp) == 0) written++;
+}
+
+void FrameDumper::writeRaw(const Frame& _frame) {
+    size_t stride = (size_t) _frame.width * 4;
+    for (GLsizei y = _frame.height - 1; y >= 0; --y)
+        fwrite(&_frame.pixels[y * stride], 1, stride, raw);
+    if (!ferror(raw)) written++;
+}
+
+}  // namespace glf
@@ -0,0 +1,850 @@
+#include <base_glcapture.h>
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+#include <map>
+#include <string>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+/**
+ * Record layout: a GLushort call id, then the arguments as they are in
+ * memory. Pointer arguments that are buffer offsets go as 64 bit integers,
+ * those pointing at client data as a GLuint size and the data, 8 byte aligned
+ * in the file so replay can hand it to GL in place
+ * @author: Methusael Murmu
+ */
+
+#define GLCAP_NULL 0xffffffffu     // Blob size of a null pointer
+#define GLCAP_OFFSET 0xfffffffeu   // Pixels are an offset into the unpack buffer
+#define GLCAP_NAME_KINDS "btvfrsph"
+
+namespace glcapture {
+
+/* Entry points by the way they're recorded
+ * Simple calls take values and buffer offsets only; their kinds say which
+ * arguments are object names to map on replay: b(uffer) t(exture) v(ertex
+ * array) f(ramebuffer) r(enderbuffer) s(ampler) p(rogram) (s)h(ader),
+ * u(niform location), U(se program), - (as is) */
+#define GLCAP_SIMPLE(X)                                                     \
+    X(ActiveTexture, "-") X(AttachShader, "ph") X(BindBuffer, "-b")         \
+    X(BindBufferBase, "--b") X(BindBufferRange, "--b--")                    \
+    X(BindFramebuffer, "-f") X(BindRenderbuffer, "-r") X(BindSampler, "-s") \
+    X(BindTexture, "-t") X(BindVertexArray, "v") X(BlendFunc, "--")         \
+    X(BlendFuncSeparate, "----") X(BlitFramebuffer, "----------")           \
+    X(Clear, "-") X(ClearColor, "----") X(ClearDepth, "-")                  \
+    X(ColorMask, "----") X(CompileShader, "h") X(CullFace, "-")             \
+    X(DeleteProgram, "p") X(DeleteShader, "h") X(DepthFunc, "-")            \
+    X(DepthMask, "-") X(Disable, "-") X(DisableVertexAttribArray, "-")      \
+    X(DrawArrays, "---") X(DrawArraysInstanced, "----")                     \
+    X(DrawBuffer, "-") X(DrawElements, "----")                              \
+    X(DrawElementsBaseVertex, "-----") X(DrawElementsInstanced, "-----")    \
+    X(DrawRangeElements, "------") X(Enable, "-")                           \
+    X(EnableVertexAttribArray, "-") X(Finish, "") X(Flush, "")              \
+    X(FramebufferRenderbuffer, "---r") X(FramebufferTexture, "--t-")        \
+    X(FramebufferTexture2D, "---t-") X(FramebufferTextureLayer, "--t--")    \
+    X(FrontFace, "-") X(GenerateMipmap, "-") X(LinkProgram, "p")            \
+    X(PixelStorei, "--") X(PolygonMode, "--") X(PolygonOffset, "--")        \
+    X(ReadBuffer, "-") X(RenderbufferStorage, "----")                       \
+    X(RenderbufferStorageMultisample, "-----") X(SamplerParameterf, "s--")  \
+    X(SamplerParameteri, "s--") X(Scissor, "----") X(StencilFunc, "---")    \
+    X(StencilMask, "-") X(StencilOp, "---") X(TexBuffer, "--b")             \
+    X(TexImage2DMultisample, "------") X(TexParameterf, "---")              \
+    X(TexParameteri, "---") X(TextureParameteri, "t--")                     \
+    X(Uniform1f, "u-") X(Uniform2f, "u--") X(Uniform3f, "u---")             \
+    X(Uniform4f, "u----") X(Uniform1i, "u-") X(Uniform2i, "u--")            \
+    X(Uniform3i, "u---") X(Uniform4i, "u----") X(UniformBlockBinding, "p--") \
+    X(UseProgram, "U") X(VertexAttrib1f, "--") X(VertexAttrib2f, "---")     \
+    X(VertexAttrib3f, "----") X(VertexAttrib4f, "-----")                    \
+    X(VertexAttribDivisor, "--") X(VertexAttribI4ui, "-----")               \
+    X(VertexAttribIPointer, "-----") X(VertexAttribPointer, "------")       \
+    X(Viewport, "----")
+
+// (n, names) calls and the kind of names they make or free
+#define GLCAP_GEN(X)                                                        \
+    X(GenBuffers, 'b') X(GenTextures, 't') X(GenVertexArrays, 'v')          \
+    X(GenFramebuffers, 'f') X(GenRenderbuffers, 'r') X(GenSamplers, 's')
+#define GLCAP_DELETE(X)                                                     \
+    X(DeleteBuffers, 'b') X(DeleteTextures, 't') X(DeleteVertexArrays, 'v') \
+    X(DeleteFramebuffers, 'f') X(DeleteRenderbuffers, 'r') X(DeleteSamplers, 's')
+
+// Uniform arrays with their component type and count, matrices, attributes
+#define GLCAP_UNIFORMV(X)                                                   \
+    X(Uniform1fv, GLfloat, 1) X(Uniform2fv, GLfloat, 2)                     \
+    X(Uniform3fv, GLfloat, 3) X(Uniform4fv, GLfloat, 4)                     \
+    X(Uniform1iv, GLint, 1) X(Uniform2iv, GLint, 2)                         \
+    X(Uniform3iv, GLint, 3) X(Uniform4iv, GLint, 4)
+#define GLCAP_MATRIX(X)                                                     \
+    X(UniformMatrix2fv, 4) X(UniformMatrix3fv, 9) X(UniformMatrix4fv, 16)
+#define GLCAP_ATTRIBV(X)                                                    \
+    X(VertexAttrib2fv, 2) X(VertexAttrib3fv, 3) X(VertexAttrib4fv, 4)
+
+// Written by hand below
+#define GLCAP_CUSTOM(X)                                                     \
+    X(CreateShader) X(CreateProgram) X(ShaderSource) X(GetUniformLocation)  \
+    X(BufferData) X(BufferSubData) X(TexImage2D) X(TexImage3D)             \
+    X(TexSubImage2D) X(TexSubImage3D) X(DrawBuffers) X(ClearBufferfv)
+
+#define HOOK_SIMPLE(name, kinds) HOOK(name,                                 \
+    (Hook<CALL_##name, decltype(gl3w##name)>::call),                        \
+    (Hook<CALL_##name, decltype(gl3w##name)>::play))
+#define HOOK_GEN(name, kind) HOOK(name, (GenHook<CALL_##name, kind>::call),  \
+    (GenHook<CALL_##name, kind>::play))
+#define HOOK_DELETE(name, kind) HOOK(name, (DeleteHook<CALL_##name, kind>::call), \
+    (DeleteHook<CALL_##name, kind>::play))
+#define HOOK_UNIFORMV(name, type, n) HOOK(name,                             \
+    (UniformHook<CALL_##name, type, n>::call), (UniformHook<CALL_##name, type, n>::play))
+#define HOOK_MATRIX(name, n) HOOK(name, (MatrixHook<CALL_##name, n>::call), \
+    (MatrixHook<CALL_##name, n>::play))
+#define HOOK_ATTRIBV(name, n) HOOK(name, (AttribHook<CALL_##name, n>::call), \
+    (AttribHook<CALL_##name, n>::play))
+#define HOOK_CUSTOM(name) HOOK(name, capture##name, play##name)
+
+#define GLCAP_HOOKS                                                         \
+    GLCAP_SIMPLE(HOOK_SIMPLE) GLCAP_GEN(HOOK_GEN) GLCAP_DELETE(HOOK_DELETE) \
+    GLCAP_UNIFORMV(HOOK_UNIFORMV) GLCAP_MATRIX(HOOK_MATRIX)                 \
+    GLCAP_ATTRIBV(HOOK_ATTRIBV) GLCAP_CUSTOM(HOOK_CUSTOM)
+
+enum Call {
+#define HOOK(name, hook, player) CALL_##name,
+    GLCAP_HOOKS
+#undef HOOK
+    CALL_SZ
+};
+
+typedef void (APIENTRY *Proc)();
+class Reader;
+typedef void (*Player)(Reader&);
+
+// Entry points calls go on to: the wrapped ones, or the replaying context's
+static Proc reals[CALL_SZ];
+static const char* kinds[CALL_SZ];
+static Player players[CALL_SZ];
+
+/* ------------------------------ Writing -------------------------------- */
+
+static FILE* out = NULL;
+static std::vector<GLubyte> pending;
+static GLuint64 written = 0;
+static bool recording = false;
+static GLuint framesWanted = 0, framesDone = 0;
+static std::vector<GLuint64> frameStarts;
+static Header header;
+
+static inline GLuint64 offset() { return written + pending.size(); }
+
+static inline void putBytes(const void* _data, size_t _size) {
+    const GLubyte* bytes = (const GLubyte*) _data;
+    pending.insert(pending.end(), bytes, bytes + _size);
+}
+
+template <typename T>
+static inline void put(T _value) {
+    static_assert(std::is_arithmetic<T>::value, "client pointers need a blob");
+    putBytes(&_value, sizeof(T));
+}
+
+// In core profiles a void pointer among values is an offset into a buffer
+static inline void put(const void* _offset) { put((GLuint64) (uintptr_t) _offset); }
+
+static inline void putBlob(const void* _data, GLuint64 _size) {
+    if (!_data) { put(GLCAP_NULL); return; }
+
+    put((GLuint) _size);
+    while (offset() % 8) pending.push_back(0);
+    putBytes(_data, _size);
+}
+
+static void flush() {
+    if (!out || pending.empty()) return;
+    fwrite(&pending[0], 1, pending.size(), out);
+    written += pending.size();
+    pending.clear();
+}
+
+// Client bytes glTexImage / glTexSubImage read for _w x _h x _d pixels
+static GLuint64 imageBytes(GLenum _format, GLenum _type, GLsizei _w, GLsizei _h, GLsizei _d) {
+    GLuint pixel;
+    switch (_type) {
+        case GL_UNSIGNED_BYTE_3_3_2: case GL_UNSIGNED_BYTE_2_3_3_REV:
+            pixel = 1; break;
+        case GL_UNSIGNED_SHORT_5_6_5: case GL_UNSIGNED_SHORT_5_6_5_REV:
+        case GL_UNSIGNED_SHORT_4_4_4_4: case GL_UNSIGNED_SHORT_4_4_4_4_REV:
+        case GL_UNSIGNED_SHORT_5_5_5_1: case GL_UNSIGNED_SHORT_1_5_5_5_REV:
+            pixel = 2; break;
+        case GL_UNSIGNED_INT_8_8_8_8: case GL_UNSIGNED_INT_8_8_8_8_REV:
+        case GL_UNSIGNED_INT_10_10_10_2: case GL_UNSIGNED_INT_2_10_10_10_REV:
+        case GL_UNSIGNED_INT_24_8: case GL_UNSIGNED_INT_10F_11F_11F_REV:
+        case GL_UNSIGNED_INT_5_9_9_9_REV:
+            pixel = 4; break;
+        case GL_FLOAT_32_UNSIGNED_INT_24_8_REV:
+            pixel = 8; break;
+        default: {
+            GLuint size = (_type == GL_UNSIGNED_BYTE || _type == GL_BYTE) ? 1 :
+                (_type == GL_UNSIGNED_SHORT || _type == GL_SHORT || _type == GL_HALF_FLOAT) ? 2 : 4;
+            GLuint comps;
+            switch (_format) {
+                case GL_RG: case GL_RG_INTEGER: case GL_DEPTH_STENCIL: comps = 2; break;
+                case GL_RGB: case GL_BGR: case GL_RGB_INTEGER: case GL_BGR_INTEGER: comps = 3; break;
+                case GL_RGBA: case GL_BGRA: case GL_RGBA_INTEGER: case GL_BGRA_INTEGER: comps = 4; break;
+                default: comps = 1;
+            }
+            pixel = size * comps;
+        }
+    }
+
+    GLint align = 4;
+    gl3wGetIntegerv(GL_UNPACK_ALIGNMENT, &align);
+    GLuint64 row = (GLuint64) _w * pixel;
+    GLuint64 stride = (row + align - 1) / align * align;
+    GLuint64 rows = (GLuint64) _h * _d;
+    return rows ? stride * (rows - 1) + row : 0;
+}
+
+static void putPixels(const void* _pixels, GLuint64 _size) {
+    GLint unpack = 0;
+    gl3wGetIntegerv(GL_PIXEL_UNPACK_BUFFER_BINDING, &unpack);
+    if (unpack) {
+        put(GLCAP_OFFSET);
+        put(_pixels);
+    } else {
+        putBlob(_pixels, _size);
+    }
+}
+
+static inline void begin(GLuint _call) { put((GLushort) _call); }
+
+/* ------------------------------ Reading -------------------------------- */
+
+class Reader {
+ public:
+    Reader(const GLubyte* _base, GLuint64 _begin, GLuint64 _end):
+        base(_base), cur(_base + _begin), end(_base + _end), bad(false) {}
+
+    template <typename T>
+    inline T get() {
+        T value;
+        if (cur + sizeof(T) > end) {
+            bad = true;
+            memset(&value, 0, sizeof(T));
+            return value;
+        }
+        memcpy(&value, cur, sizeof(T));
+        cur += sizeof(T);
+        return value;
+    }
+
+    // Data in place, an unpack buffer offset, or NULL
+    const void* blob(GLuint* _size = NULL) {
+        GLuint size = get<GLuint>();
+        if (size == GLCAP_NULL) return NULL;
+        if (size == GLCAP_OFFSET) return (const void*) (uintptr_t) get<GLuint64>();
+
+        while ((cur - base) % 8) ++cur;
+        if (cur + size > end) { bad = true; return NULL; }
+        const void* data = cur;
+        cur += size;
+        if (_size) *_size = size;
+        return data;
+    }
+
+    inline bool done() const { return cur >= end; }
+    inline bool failed() const { return bad; }
+    inline GLuint64 position() const { return cur - base; }
+
+ private:
+    const GLubyte *base, *cur, *end;
+    bool bad;
+};
+
+template <>
+inline const void* Reader::get<const void*>() { return (const void*) (uintptr_t) get<GLuint64>(); }
+
+// Names and uniform locations of the capture to those of the replay
+static std::map<GLuint, GLuint> names[sizeof(GLCAP_NAME_KINDS) - 1];
+static std::map<std::pair<GLuint, GLint>, GLint> uniforms;
+static GLuint currentProgram = 0;  // As captured
+
+static inline std::map<GLuint, GLuint>& nameMap(char _kind) {
+    return names[strchr(GLCAP_NAME_KINDS, _kind) - GLCAP_NAME_KINDS];
+}
+
+static GLuint mapName(char _kind, GLuint _name) {
+    std::map<GLuint, GLuint>& map = nameMap(_kind);
+    std::map<GLuint, GLuint>::iterator itr = map.find(_name);
+    return itr != map.end() ? itr->second : _name;
+}
+
+static GLint mapUniform(GLint _location) {
+    std::map<std::pair<GLuint, GLint>, GLint>::iterator itr =
+        uniforms.find(std::make_pair(currentProgram, _location));
+    return itr != uniforms.end() ? itr->second : _location;
+}
+
+static inline void remap(char _kind, GLuint& _value) {
+    if (_kind == 'U') {
+        currentProgram = _value;
+        _value = mapName('p', _value);
+    } else if (_kind != '-') {
+        _value = mapName(_kind, _value);
+    }
+}
+
+static inline void remap(char _kind, GLint& _value) {
+    if (_kind == 'u') _value = mapUniform(_value);
+}
+
+template <typename T>
+static inline void remap(char _kind, T& _value) {}
+
+/* ------------------------------ Hooks ---------------------------------- */
+
+template <size_t... I> struct Indices {};
+template <size_t N, size_t... I> struct MakeIndices: MakeIndices<N - 1, N - 1, I...> {};
+template <size_t... I> struct MakeIndices<0, I...> { typedef Indices<I...> type; };
+
+template <typename F> struct Arity;
+template <typename... A> struct Arity<void (APIENTRY *)(A...)> { enum { value = sizeof...(A) }; };
+
+template <GLuint ID, typename F> struct Hook;
+
+template <GLuint ID, typename... A>
+struct Hook<ID, void (APIENTRY *)(A...)> {
+    typedef void (APIENTRY *Fn)(A...);
+
+    static void APIENTRY call(A... _args) {
+        if (recording) {
+            begin(ID);
+            int order[] = { 0, (put(_args), 0)... };
+            (void) order;
+        }
+        ((Fn) reals[ID])(_args...);
+    }
+
+    // Braced initialization reads the arguments in order
+    static void play(Reader& _in) {
+        std::tuple<A...> args { _in.get<A>()... };
+        invoke(args, typename MakeIndices<sizeof...(A)>::type());
+    }
+
+    template <size_t... I>
+    static void invoke(std::tuple<A...>& _args, Indices<I...>) {
+        int order[] = { 0, (remap(kinds[ID][I], std::get<I>(_args)), 0)... };
+        (void) order;
+        if (reals[ID]) ((Fn) reals[ID])(std::get<I>(_args)...);
+    }
+};
+
+template <GLuint ID, char KIND>
+struct GenHook {
+    typedef void (APIENTRY *Fn)(GLsizei, GLuint*);
+
+    static void APIENTRY call(GLsizei _n, GLuint* _names) {
+        ((Fn) reals[ID])(_n, _names);
+        if (!recording) return;
+        begin(ID);
+        put(_n);
+        for (GLsizei i = 0; i < _n; ++i) put(_names[i]);
+    }
+
+    static void play(Reader& _in) {
+        GLsizei n = _in.get<GLsizei>();
+        std::vector<GLuint> captured(n), made(n);
+        for (GLsizei i = 0; i < n; ++i) captured[i] = _in.get<GLuint>();
+        if (!n || !reals[ID]) return;
+
+        ((Fn) reals[ID])(n, &made[0]);
+        for (GLsizei i = 0; i < n; ++i) nameMap(KIND)[captured[i]] = made[i];
+    }
+};
+
+template <GLuint ID, char KIND>
+struct DeleteHook {
+    typedef void (APIENTRY *Fn)(GLsizei, const GLuint*);
+
+    static void APIENTRY call(GLsizei _n, const GLuint* _names) {
+        if (recording) {
+            begin(ID);
+            put(_n);
+            for (GLsizei i = 0; i < _n; ++i) put(_names[i]);
+        }
+        ((Fn) reals[ID])(_n, _names);
+    }
+
+    static void play(Reader& _in) {
+        GLsizei n = _in.get<GLsizei>();
+        std::vector<GLuint> freed(n);
+        for (GLsizei i = 0; i < n; ++i) {
+            GLuint name = _in.get<GLuint>();
+            freed[i] = mapName(KIND, name);
+            nameMap(KIND).erase(name);
+        }
+        if (n && reals[ID]) ((Fn) reals[ID])(n, &freed[0]);
+    }
+};
+
+template <GLuint ID, typename T, int N>
+struct UniformHook {
+    typedef void (APIENTRY *Fn)(GLint, GLsizei, const T*);
+
+    static void APIENTRY call(GLint _loc, GLsizei _count, const T* _v) {
+        if (recording) {
+            begin(ID);
+            put(_loc); put(_count);
+            putBlob(_v, (GLuint64) _count * N * sizeof(T));
+        }
+        ((Fn) reals[ID])(_loc, _count, _v);
+    }
+
+    static void play(Reader& _in) {
+        GLint loc = _in.get<GLint>();
+        GLsizei count = _in.get<GLsizei>();
+        const T* v = (const T*) _in.blob();
+        if (reals[ID]) ((Fn) reals[ID])(mapUniform(loc), count, v);
+    }
+};
+
+template <GLuint ID, int N>
+struct MatrixHook {
+    typedef void (APIENTRY *Fn)(GLint, GLsizei, GLboolean, const GLfloat*);
+
+    static void APIENTRY call(GLint _loc, GLsizei _count, GLboolean _transpose, const GLfloat* _v) {
+        if (recording) {
+            begin(ID);
+            put(_loc); put(_count); put(_transpose);
+            putBlob(_v, (GLuint64) _count * N * sizeof(GLfloat));
+        }
+        ((Fn) reals[ID])(_loc, _count, _transpose, _v);
+    }
+
+    static void play(Reader& _in) {
+        GLint loc = _in.get<GLint>();
+        GLsizei count = _in.get<GLsizei>();
+        GLboolean transpose = _in.get<GLboolean>();
+        const GLfloat* v = (const GLfloat*) _in.blob();
+        if (reals[ID]) ((Fn) reals[ID])(mapUniform(loc), count, transpose, v);
+    }
+};
+
+template <GLuint ID, int N>
+struct AttribHook {
+    typedef void (APIENTRY *Fn)(GLuint, const GLfloat*);
+
+    static void APIENTRY call(GLuint _index, const GLfloat* _v) {
+        if (recording) {
+            begin(ID);
+            put(_index);
+            putBlob(_v, N * sizeof(GLfloat));
+        }
+        ((Fn) reals[ID])(_index, _v);
+    }
+
+    static void play(Reader& _in) {
+        GLuint index = _in.get<GLuint>();
+        const GLfloat* v = (const GLfloat*) _in.blob();
+        if (reals[ID]) ((Fn) reals[ID])(index, v);
+    }
+};
+
+#define REAL(name) ((decltype(gl3w##name)) reals[CALL_##name])
+
+static GLuint APIENTRY captureCreateShader(GLenum _type) {
+    GLuint shader = REAL(CreateShader)(_type);
+    if (recording) { begin(CALL_CreateShader); put(_type); put(shader); }
+    return shader;
+}
+
+static void playCreateShader(Reader& _in) {
+    GLenum type = _in.get<GLenum>();
+    GLuint shader = _in.get<GLuint>();
+    if (reals[CALL_CreateShader]) nameMap('h')[shader] = REAL(CreateShader)(type);
+}
+
+static GLuint APIENTRY captureCreateProgram() {
+    GLuint program = REAL(CreateProgram)();
+    if (recording) { begin(CALL_CreateProgram); put(program); }
+    return program;
+}
+
+static void playCreateProgram(Reader& _in) {
+    GLuint program = _in.get<GLuint>();
+    if (reals[CALL_CreateProgram]) nameMap('p')[program] = REAL(CreateProgram)();
+}
+
+static void APIENTRY captureShaderSource(GLuint _shader, GLsizei _count,
+                                         const GLchar* const* _strings, const GLint* _lengths) {
+    if (recording) {
+        begin(CALL_ShaderSource);
+        put(_shader); put(_count);
+        for (GLsizei i = 0; i < _count; ++i)
+            putBlob(_strings[i], _lengths && _lengths[i] >= 0 ? _lengths[i] : strlen(_strings[i]));
+    }
+    REAL(ShaderSource)(_shader, _count, _strings, _lengths);
+}
+
+static void playShaderSource(Reader& _in) {
+    GLuint shader = _in.get<GLuint>();
+    GLsizei count = _in.get<GLsizei>();
+    std::vector<const GLchar*> strings(count);
+    std::vector<GLint> lengths(count);
+    for (GLsizei i = 0; i < count; ++i) {
+        GLuint size = 0;
+        strings[i] = (const GLchar*) _in.blob(&size);
+        lengths[i] = size;
+    }
+    if (reals[CALL_ShaderSource] && count)
+        REAL(ShaderSource)(mapName('h', shader), count, &strings[0], &lengths[0]);
+}
+
+static GLint APIENTRY captureGetUniformLocation(GLuint _program, const GLchar* _name) {
+    GLint loc = REAL(GetUniformLocation)(_program, _name);
+    if (recording) {
+        begin(CALL_GetUniformLocation);
+        put(_program);
+        putBlob(_name, strlen(_name) + 1);
+        put(loc);
+    }
+    return loc;
+}
+
+static void playGetUniformLocation(Reader& _in) {
+    GLuint program = _in.get<GLuint>();
+    const GLchar* name = (const GLchar*) _in.blob();
+    GLint loc = _in.get<GLint>();
+    if (loc < 0 || !name || !reals[CALL_GetUniformLocation]) return;
+    uniforms[std::make_pair(program, loc)] = REAL(GetUniformLocation)(mapName('p', program), name);
+}
+
+static void APIENTRY captureBufferData(GLenum _target, GLsizeiptr _size, const void* _data,
+                                       GLenum _usage) {
+    if (recording) {
+        begin(CALL_BufferData);
+        put(_target); put(_size); put(_usage);
+        putBlob(_data, _size);
+    }
+    REAL(BufferData)(_target, _size, _data, _usage);
+}
+
+static void playBufferData(Reader& _in) {
+    GLenum target = _in.get<GLenum>();
+    GLsizeiptr size = _in.get<GLsizeiptr>();
+    GLenum usage = _in.get<GLenum>();
+    const void* data = _in.blob();
+    if (reals[CALL_BufferData]) REAL(BufferData)(target, size, data, usage);
+}
+
+static void APIENTRY captureBufferSubData(GLenum _target, GLintptr _offset, GLsizeiptr _size,
+                                          const void* _data) {
+    if (recording) {
+        begin(CALL_BufferSubData);
+        put(_target); put(_offset); put(_size);
+        putBlob(_data, _size);
+    }
+    REAL(BufferSubData)(_target, _offset, _size, _data);
+}
+
+static void playBufferSubData(Reader& _in) {
+    GLenum target = _in.get<GLenum>();
+    GLintptr offset = _in.get<GLintptr>();
+    GLsizeiptr size = _in.get<GLsizeiptr>();
+    const void* data = _in.blob();
+    if (reals[CALL_BufferSubData]) REAL(BufferSubData)(target, offset, size, data);
+}
+
+static void APIENTRY captureTexImage2D(GLenum _target, GLint _level, GLint _ifmt, GLsizei _w,
+                                       GLsizei _h, GLint _border, GLenum _format, GLenum _type,
+                                       const void* _pixels) {
+    if (recording) {
+        begin(CALL_TexImage2D);
+        put(_target); put(_level); put(_ifmt); put(_w); put(_h); put(_border);
+        put(_format); put(_type);
+        putPixels(_pixels, imageBytes(_format, _type, _w, _h, 1));
+    }
+    REAL(TexImage2D)(_target, _level, _ifmt, _w, _h, _border, _format, _type, _pixels);
+}
+
+static void playTexImage2D(Reader& _in) {
+    GLenum target = _in.get<GLenum>();
+    GLint level = _in.get<GLint>(), ifmt = _in.get<GLint>();
+    GLsizei w = _in.get<GLsizei>(), h = _in.get<GLsizei>();
+    GLint border = _in.get<GLint>();
+    GLenum format = _in.get<GLenum>(), type = _in.get<GLenum>();
+    const void* pixels = _in.blob();
+    if (reals[CALL_TexImage2D]) REAL(TexImage2D)(target, level, ifmt, w, h, border, format, type, pixels);
+}
+
+static void APIENTRY captureTexImage3D(GLenum _target, GLint _level, GLint _ifmt, GLsizei _w,
+                                       GLsizei _h, GLsizei _d, GLint _border, GLenum _format,
+                                       GLenum _type, const void* _pixels) {
+    if (recording) {
+        begin(CALL_TexImage3D);
+        put(_target); put(_level); put(_ifmt); put(_w); put(_h); put(_d); put(_border);
+        put(_format); put(_type);
+        putPixels(_pixels, imageBytes(_format, _type, _w, _h, _d));
+    }
+    REAL(TexImage3D)(_target, _level, _ifmt, _w, _h, _d, _border, _format, _type, _pixels);
+}
+
+static void playTexImage3D(Reader& _in) {
+    GLenum target = _in.get<GLenum>();
+    GLint level = _in.get<GLint>(), ifmt = _in.get<GLint>();
+    GLsizei w = _in.get<GLsizei>(), h = _in.get<GLsizei>(), d = _in.get<GLsizei>();
+    GLint border = _in.get<GLint>();
+    GLenum format = _in.get<GLenum>(), type = _in.get<GLenum>();
+    const void* pixels = _in.blob();
+    if (reals[CALL_TexImage3D])
+        REAL(TexImage3D)(target, level, ifmt, w, h, d, border, format, type, pixels);
+}
+
+static void APIENTRY captureTexSubImage2D(GLenum _target, GLint _level, GLint _x, GLint _y,
+                                          GLsizei _w, GLsizei _h, GLenum _format, GLenum _type,
+                                          const void* _pixels) {
+    if (recording) {
+        begin(CALL_TexSubImage2D);
+        put(_target); put(_level); put(_x); put(_y); put(_w); put(_h);
+        put(_format); put(_type);
+        putPixels(_pixels, imageBytes(_format, _type, _w, _h, 1));
+    }
+    REAL(TexSubImage2D)(_target, _level, _x, _y, _w, _h, _format, _type, _pixels);
+}
+
+static void playTexSubImage2D(Reader& _in) {
+    GLenum target = _in.get<GLenum>();
+    GLint level = _in.get<GLint>(), x = _in.get<GLint>(), y = _in.get<GLint>();
+    GLsizei w = _in.get<GLsizei>(), h = _in.get<GLsizei>();
+    GLenum format = _in.get<GLenum>(), type = _in.get<GLenum>();
+    const void* pixels = _in.blob();
+    if (reals[CALL_TexSubImage2D]) REAL(TexSubImage2D)(target, level, x, y, w, h, format, type, pixels);
+}
+
+static void APIENTRY captureTexSubImage3D(GLenum _target, GLint _level, GLint _x, GLint _y,
+                                          GLint _z, GLsizei _w, GLsizei _h, GLsizei _d,
+                                          GLenum _format, GLenum _type, const void* _pixels) {
+    if (recording) {
+        begin(CALL_TexSubImage3D);
+        put(_target); put(_level); put(_x); put(_y); put(_z); put(_w); put(_h); put(_d);
+        put(_format); put(_type);
+        putPixels(_pixels, imageBytes(_format, _type, _w, _h, _d));
+    }
+    REAL(TexSubImage3D)(_target, _level, _x, _y, _z, _w, _h, _d, _format, _type, _pixels);
+}
+
+static void playTexSubImage3D(Reader& _in) {
+    GLenum target = _in.get<GLenum>();
+    GLint level = _in.get<GLint>(), x = _in.get<GLint>(), y = _in.get<GLint>(), z = _in.get<GLint>();
+    GLsizei w = _in.get<GLsizei>(), h = _in.get<GLsizei>(), d = _in.get<GLsizei>();
+    GLenum format = _in.get<GLenum>(), type = _in.get<GLenum>();
+    const void* pixels = _in.blob();
+    if (reals[CALL_TexSubImage3D])
+        REAL(TexSubImage3D)(target, level, x, y, z, w, h, d, format, type, pixels);
+}
+
+static void APIENTRY captureDrawBuffers(GLsizei _n, const GLenum* _bufs) {
+    if (recording) {
+        begin(CALL_DrawBuffers);
+        put(_n);
+        putBlob(_bufs, _n * sizeof(GLenum));
+    }
+    REAL(DrawBuffers)(_n, _bufs);
+}
+
+static void playDrawBuffers(Reader& _in) {
+    GLsizei n = _in.get<GLsizei>();
+    const GLenum* bufs = (const GLenum*) _in.blob();
+    if (reals[CALL_DrawBuffers]) REAL(DrawBuffers)(n, bufs);
+}
+
+static void APIENTRY captureClearBufferfv(GLenum _buffer, GLint _drawbuffer, const GLfloat* _value) {
+    if (recording) {
+        begin(CALL_ClearBufferfv);
+        put(_buffer); put(_drawbuffer);
+        putBlob(_value, (_buffer == GL_DEPTH ? 1 : 4) * sizeof(GLfloat));
+    }
+    REAL(ClearBufferfv)(_buffer, _drawbuffer, _value);
+}
+
+static void playClearBufferfv(Reader& _in) {
+    GLenum buffer = _in.get<GLenum>();
+    GLint drawbuffer = _in.get<GLint>();
+    const GLfloat* value = (const GLfloat*) _in.blob();
+    if (reals[CALL_ClearBufferfv]) REAL(ClearBufferfv)(buffer, drawbuffer, value);
+}
+
+/* ------------------------------ Control -------------------------------- */
+
+static void bindTables() {
+#define KINDS(name, k)                                                      \
+    static_assert(sizeof(k) - 1 == Arity<decltype(gl3w##name)>::value, #name " kinds");  \
+    kinds[CALL_##name] = k;
+    GLCAP_SIMPLE(KINDS)
+#undef KINDS
+
+#define HOOK(name, hook, player) players[CALL_##name] = player;
+    GLCAP_HOOKS
+#undef HOOK
+}
+
+static void install() {
+    bindTables();
+#define HOOK(name, hook, player)                \
+    reals[CALL_##name] = (Proc) gl3w##name;     \
+    if (gl3w##name) gl3w##name = hook;
+    GLCAP_HOOKS
+#undef HOOK
+}
+
+// Restores entry points nothing hooked over since
+static void uninstall() {
+#define HOOK(name, hook, player)                                    \
+    if (gl3w##name == hook) gl3w##name = (decltype(gl3w##name)) reals[CALL_##name];
+    GLCAP_HOOKS
+#undef HOOK
+}
+
+extern bool start(const char* _path, GLuint _frames, GLuint _width, GLuint _height) {
+    if (recording || out) return false;
+
+    out = fopen(_path, "wb");
+    if (!out) {
+        fprintf(stderr, "GL capture: unable to open %s\n", _path);
+        return false;
+    }
+
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, GLCAPTURE_MAGIC, 4);
+    header.version = GLCAPTURE_VERSION;
+    header.width = _width;
+    header.height = _height;
+    fwrite(&header, sizeof(header), 1, out);
+    written = sizeof(header);
+
+    framesWanted = std::max(_frames, 1u);
+    framesDone = 0;
+    frameStarts.clear();
+    pending.reserve(GLCAPTURE_FLUSH_BYTES);
+
+    install();
+    recording = true;
+    fprintf(stdout, "GL capture: recording setup and %u frames to %s\n", framesWanted, _path);
+    return true;
+}
+
+extern void beginFrame() {
+    if (recording) frameStarts.push_back(offset());
+}
+
+extern void endFrame() {
+    if (!recording) return;
+    if (++framesDone >= framesWanted) stop();
+    else if (pending.size() > GLCAPTURE_FLUSH_BYTES) flush();
+}
+
+extern void stop() {
+    if (!recording) return;
+    recording = false;
+    uninstall();
+
+    // Starts of complete frames, then where the last one ends
+    GLuint64 end = framesDone < frameStarts.size() ? frameStarts[framesDone] : offset();
+    frameStarts.resize(framesDone);
+    frameStarts.push_back(end);
+
+    flush();
+    header.frames = framesDone;
+    header.index = written;
+    fwrite(&frameStarts[0], sizeof(GLuint64), frameStarts.size(), out);
+    fseek(out, 0, SEEK_SET);
+    fwrite(&header, sizeof(header), 1, out);
+    fclose(out);
+    out = NULL;
+
+    fprintf(stdout, "GL capture: %u frames, %.2f MB\n", framesDone, written / (1024.0 * 1024.0));
+    std::vector<GLubyte>().swap(pending);
+}
+
+extern bool capturing() { return recording; }
+
+/* ------------------------------ Replay --------------------------------- */
+
+bool Replay::load(const char* _path) {
+    FILE* fp = fopen(_path, "rb");
+    if (!fp) {
+        fprintf(stderr, "GL replay: unable to open %s\n", _path);
+        return false;
+    }
+
+    fseek(fp, 0, SEEK_END);
+    long size = ftell(fp);
+    fseek(fp, 0, SEEK_SET);
+    data.resize(size > 0 ? size : 0);
+    bool read = size > 0 && fread(&data[0], 1, size, fp) == (size_t) size;
+    fclose(fp);
+
+    if (!read || data.size() < sizeof(Header)) {
+        fprintf(stderr, "GL replay: %s is truncated\n", _path);
+        return false;
+    }
+    memcpy(&head, &data[0], sizeof(Header));
+    if (memcmp(head.magic, GLCAPTURE_MAGIC, 4) || head.version != GLCAPTURE_VERSION) {
+        fprintf(stderr, "GL replay: %s is not a version %u capture\n", _path, GLCAPTURE_VERSION);
+        return false;
+    }
+    if (head.index < sizeof(Header) || head.index > data.size() ||
+        (data.size() - head.index) / sizeof(GLuint64) < (GLuint64) head.frames + 1) {
+        fprintf(stderr, "GL replay: %s was not finished\n", _path);
+        return false;
+    }
+
+    // Segments run in order between the header and the index
+    starts.resize(head.frames + 1);
+    memcpy(&starts[0], &data[head.index], starts.size() * sizeof(GLuint64));
+    for (size_t i = 0; i < starts.size(); ++i) {
+        if (starts[i] < (i ? starts[i - 1] : sizeof(Header)) || starts[i] > head.index) {
+            fprintf(stderr, "GL replay: %s has a bad offset for frame %lu\n", _path, (unsigned long) i);
+            starts.clear();
+            return false;
+        }
+    }
+
+    // Calls go straight to the replaying context
+    bindTables();
+#define HOOK(name, hook, player) reals[CALL_##name] = (Proc) gl3w##name;
+    GLCAP_HOOKS
+#undef HOOK
+    for (size_t i = 0; i < sizeof(names) / sizeof(names[0]); ++i) names[i].clear();
+    uniforms.clear();
+    currentProgram = 0;
+    return true;
+}
+
+GLuint Replay::playSetup() { return play(sizeof(Header), starts[0]); }
+
+GLuint Replay::playFrame(GLuint _frame) {
+    return _frame < head.frames ? play(starts[_frame], starts[_frame + 1]) : 0;
+}
+
+GLuint Replay::play(GLuint64 _begin, GLuint64 _end) {
+    Reader in(&data[0], _begin, _end);
+    GLuint calls = 0;
+    while (!in.done()) {
+        GLuint64 at = in.position();
+        GLushort call = in.get<GLushort>();
+        if (call >= CALL_SZ || in.failed()) {
+            fprintf(stderr, "GL replay: bad call %u at %llu\n", call, (unsigned long long) at);
+            return 0;
+        }
+        players[call](in);
+        if (in.failed()) {
+            fprintf(stderr, "GL replay: call %u at %llu runs past its segment\n",
+                call, (unsigned long long) at);
+            return 0;
+        }
+        calls++;
+    }
+    return calls;
+}
+
+}  // namespace glcapture
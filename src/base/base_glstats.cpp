@@ -0,0 +1,124 @@
+#include <base_glstats.h>
+
+/**
+ * @author: Methusael Murmu
+ */
+
+namespace glstats {
+
+static Counters counters;
+static bool hooked = false;
+
+// Triangles a draw of _count vertices assembles
+static GLuint64 triangles(GLenum _mode, GLsizei _count, GLsizei _instances = 1) {
+    GLuint64 prims = 0;
+    switch (_mode) {
+        case GL_TRIANGLES:
+            prims = _count / 3; break;
+        case GL_TRIANGLE_STRIP:
+        case GL_TRIANGLE_FAN:
+            prims = _count > 2 ? _count - 2 : 0; break;
+        case GL_TRIANGLES_ADJACENCY:
+            prims = _count / 6; break;
+        case GL_TRIANGLE_STRIP_ADJACENCY:
+            prims = _count > 4 ? (_count - 4) / 2 : 0; break;
+    }
+    return prims * (GLuint64) _instances;
+}
+
+/* Wrappers keep the real entry point in real<Name> and take its place in
+ * gl3w<Name>, which the gl<Name> macros resolve to */
+#define HOOK_STATE(name, PFN, params, args)             \
+    static PFN real##name;                              \
+    static void APIENTRY count##name params {           \
+        counters.stateChanges++;                        \
+        real##name args;                                \
+    }
+
+#define HOOK_DRAW(name, PFN, params, args, mode, verts, instances)   \
+    static PFN real##name;                                          \
+    static void APIENTRY count##name params {                       \
+        counters.draws++;                                           \
+        counters.triangles += triangles(mode, verts, instances);    \
+        real##name args;                                            \
+    }
+
+#define HOOK_INSTALL(name)                  \
+    real##name = gl3w##name;                \
+    if (real##name) gl3w##name = count##name;
+
+HOOK_DRAW(DrawArrays, PFNGLDRAWARRAYSPROC,
+    (GLenum m, GLint f, GLsizei c), (m, f, c), m, c, 1)
+HOOK_DRAW(DrawElements, PFNGLDRAWELEMENTSPROC,
+    (GLenum m, GLsizei c, GLenum t, const void* i), (m, c, t, i), m, c, 1)
+HOOK_DRAW(DrawRangeElements, PFNGLDRAWRANGEELEMENTSPROC,
+    (GLenum m, GLuint s, GLuint e, GLsizei c, GLenum t, const void* i),
+    (m, s, e, c, t, i), m, c, 1)
+HOOK_DRAW(DrawElementsBaseVertex, PFNGLDRAWELEMENTSBASEVERTEXPROC,
+    (GLenum m, GLsizei c, GLenum t, const void* i, GLint b), (m, c, t, i, b), m, c, 1)
+HOOK_DRAW(DrawArraysInstanced, PFNGLDRAWARRAYSINSTANCEDPROC,
+    (GLenum m, GLint f, GLsizei c, GLsizei n), (m, f, c, n), m, c, n)
+HOOK_DRAW(DrawElementsInstanced, PFNGLDRAWELEMENTSINSTANCEDPROC,
+    (GLenum m, GLsizei c, GLenum t, const void* i, GLsizei n), (m, c, t, i, n), m, c, n)
+HOOK_DRAW(DrawElementsInstancedBaseVertex, PFNGLDRAWELEMENTSINSTANCEDBASEVERTEXPROC,
+    (GLenum m, GLsizei c, GLenum t, const void* i, GLsizei n, GLint b),
+    (m, c, t, i, n, b), m, c, n)
+
+HOOK_STATE(UseProgram, PFNGLUSEPROGRAMPROC, (GLuint p), (p))
+HOOK_STATE(BindTexture, PFNGLBINDTEXTUREPROC, (GLenum t, GLuint n), (t, n))
+HOOK_STATE(BindSampler, PFNGLBINDSAMPLERPROC, (GLuint u, GLuint s), (u, s))
+HOOK_STATE(BindVertexArray, PFNGLBINDVERTEXARRAYPROC, (GLuint a), (a))
+HOOK_STATE(BindFramebuffer, PFNGLBINDFRAMEBUFFERPROC, (GLenum t, GLuint f), (t, f))
+HOOK_STATE(Enable, PFNGLENABLEPROC, (GLenum c), (c))
+HOOK_STATE(Disable, PFNGLDISABLEPROC, (GLenum c), (c))
+HOOK_STATE(BlendFunc, PFNGLBLENDFUNCPROC, (GLenum s, GLenum d), (s, d))
+HOOK_STATE(BlendFuncSeparate, PFNGLBLENDFUNCSEPARATEPROC,
+    (GLenum sc, GLenum dc, GLenum sa, GLenum da), (sc, dc, sa, da))
+HOOK_STATE(DepthFunc, PFNGLDEPTHFUNCPROC, (GLenum f), (f))
+HOOK_STATE(DepthMask, PFNGLDEPTHMASKPROC, (GLboolean f), (f))
+HOOK_STATE(CullFace, PFNGLCULLFACEPROC, (GLenum m), (m))
+HOOK_STATE(PolygonOffset, PFNGLPOLYGONOFFSETPROC, (GLfloat f, GLfloat u), (f, u))
+HOOK_STATE(Viewport, PFNGLVIEWPORTPROC, (GLint x, GLint y, GLsizei w, GLsizei h), (x, y, w, h))
+
+extern void install() {
+    if (hooked) return;
+
+    HOOK_INSTALL(DrawArrays)
+    HOOK_INSTALL(DrawElements)
+    HOOK_INSTALL(DrawRangeElements)
+    HOOK_INSTALL(DrawElementsBaseVertex)
+    HOOK_INSTALL(DrawArraysInstanced)
+    HOOK_INSTALL(DrawElementsInstanced)
+    HOOK_INSTALL(DrawElementsInstancedBaseVertex)
+
+    HOOK_INSTALL(UseProgram)
+    HOOK_INSTALL(BindTexture)
+    HOOK_INSTALL(BindSampler)
+    HOOK_INSTALL(BindVertexArray)
+    HOOK_INSTALL(BindFramebuffer)
+    HOOK_INSTALL(Enable)
+    HOOK_INSTALL(Disable)
+    HOOK_INSTALL(BlendFunc)
+    HOOK_INSTALL(BlendFuncSeparate)
+    HOOK_INSTALL(DepthFunc)
+    HOOK_INSTALL(DepthMask)
+    HOOK_INSTALL(CullFace)
+    HOOK_INSTALL(PolygonOffset)
+    HOOK_INSTALL(Viewport)
+
+    hooked = true;
+}
+
+extern bool installed() { return hooked; }
+
+extern const Counters& current() { return counters; }
+
+extern Counters take() {
+    Counters taken = counters;
+    counters = Counters();
+    return taken;
+}
+
+extern void reset() { counters = Counters(); }
+
+}  // namespace glstats
@@ -0,0 +1,624 @@
+#include <base_gpumem.h>
+#include <base_metrics.h>
+
+#include <ctype.h>
+#include <algorithm>
+#include <map>
+
+/**
+ * @author: Methusael Murmu
+ */
+
+namespace gpumem {
+
+static inline GLdouble megabytes(GLuint64 _bytes) { return _bytes / (1024.0 * 1024.0); }
+
+// One level of one face (or of all layers) of a texture
+struct Image {
+    GLsizei width, height, depth;
+    GLuint64 bytes;
+};
+
+struct Object {
+    Object(): category(CATEGORY_SZ), owner(0), bytes(0) {}
+
+    Category category;  // CATEGORY_SZ until storage is given
+    GLuint owner;
+    GLuint64 bytes;
+    std::map<GLuint, Image> images;  // Textures, by face << 16 | level
+};
+
+struct Owner {
+    std::string name;
+    Usage usage;
+};
+
+typedef std::map<GLuint, Object> t_objects;
+
+static t_objects buffers, textures, renderbuffers;
+static std::vector<Owner> ownerTable(1);  // Untagged first
+static std::vector<GLuint> ownerStack;
+static Usage totals[CATEGORY_SZ];
+static GLuint64 totalBytes = 0, totalObjects = 0, peak = 0, budgetBytes = 0;
+static bool overBudget = false, hooked = false;
+
+static metrics::Gauge* gaugeTotal = NULL;
+static metrics::Gauge* gauges[CATEGORY_SZ];
+
+static const char* kCategoryNames[CATEGORY_SZ] = {
+    "Vertex", "Index", "Buffer", "Texture", "Depth", "Renderbuffer"
+};
+
+extern const char* categoryName(Category _category) {
+    return _category < CATEGORY_SZ ? kCategoryNames[_category] : "Unknown";
+}
+
+/* ------------------------------ Formats -------------------------------- */
+
+static GLuint texelBytes(GLenum _format) {
+    switch (_format) {
+        case GL_RED: case GL_R8: case GL_R8I: case GL_R8UI: case GL_R8_SNORM:
+        case GL_STENCIL_INDEX8:
+            return 1;
+        case GL_RG: case GL_RG8: case GL_RG8I: case GL_RG8UI: case GL_R16F:
+        case GL_R16: case GL_R16I: case GL_R16UI: case GL_DEPTH_COMPONENT16:
+            return 2;
+        case GL_RG16F: case GL_RG16: case GL_RG16I: case GL_RG16UI: case GL_R32F:
+        case GL_R32I: case GL_R32UI: case GL_R11F_G11F_B10F: case GL_RGB10_A2:
+        case GL_RGB9_E5:
+            return 4;
+        case GL_RGB16F: case GL_RGBA16F: case GL_RGB16: case GL_RGBA16: case GL_RG32F:
+        case GL_RG32I: case GL_RG32UI: case GL_DEPTH32F_STENCIL8:
+            return 8;
+        case GL_RGB32F: case GL_RGB32I: case GL_RGB32UI:
+            return 12;
+        case GL_RGBA32F: case GL_RGBA32I: case GL_RGBA32UI:
+            return 16;
+        default:  // 8 bit RGB(A), sRGB, 24 and 32 bit depth
+            return 4;
+    }
+}
+
+static bool isDepth(GLenum _format) {
+    switch (_format) {
+        case GL_DEPTH_COMPONENT: case GL_DEPTH_COMPONENT16: case GL_DEPTH_COMPONENT24:
+        case GL_DEPTH_COMPONENT32: case GL_DEPTH_COMPONENT32F: case GL_DEPTH_STENCIL:
+        case GL_DEPTH24_STENCIL8: case GL_DEPTH32F_STENCIL8:
+            return true;
+        default:
+            return false;
+    }
+}
+
+/* ------------------------------ Bindings ------------------------------- */
+
+/* Bindings are followed through the bind hooks rather than queried with
+ * glGetIntegerv, which can stall the driver, on every storage call; the
+ * element array binding belongs to the vertex array bound */
+
+enum BufferSlot {
+    ARRAY_SLOT, UNIFORM_SLOT, TEXTURE_BUFFER_SLOT, PIXEL_PACK_SLOT, PIXEL_UNPACK_SLOT,
+    COPY_READ_SLOT, COPY_WRITE_SLOT, TRANSFORM_FEEDBACK_SLOT, DRAW_INDIRECT_SLOT, BUFFER_SLOT_SZ
+};
+
+enum TextureSlot {
+    TEX_1D_SLOT, TEX_2D_SLOT, TEX_3D_SLOT, TEX_1D_ARRAY_SLOT, TEX_2D_ARRAY_SLOT,
+    TEX_RECTANGLE_SLOT, TEX_CUBE_MAP_SLOT, TEX_CUBE_MAP_ARRAY_SLOT, TEX_2D_MULTISAMPLE_SLOT,
+    TEX_2D_MULTISAMPLE_ARRAY_SLOT, TEXTURE_SLOT_SZ
+};
+
+static GLuint boundBuffers[BUFFER_SLOT_SZ];
+static std::map<GLuint, GLuint> vaoElements;  // Element array buffer of each vertex array
+static GLuint boundVao = 0, boundRenderbuffer = 0, activeUnit = 0;
+static std::vector<GLuint> boundTextures(TEXTURE_SLOT_SZ);  // TEXTURE_SLOT_SZ per unit
+
+static GLint bufferSlot(GLenum _target) {
+    switch (_target) {
+        case GL_ARRAY_BUFFER: return ARRAY_SLOT;
+        case GL_UNIFORM_BUFFER: return UNIFORM_SLOT;
+        case GL_TEXTURE_BUFFER: return TEXTURE_BUFFER_SLOT;
+        case GL_PIXEL_PACK_BUFFER: return PIXEL_PACK_SLOT;
+        case GL_PIXEL_UNPACK_BUFFER: return PIXEL_UNPACK_SLOT;
+        case GL_COPY_READ_BUFFER: return COPY_READ_SLOT;
+        case GL_COPY_WRITE_BUFFER: return COPY_WRITE_SLOT;
+        case GL_TRANSFORM_FEEDBACK_BUFFER: return TRANSFORM_FEEDBACK_SLOT;
+        case GL_DRAW_INDIRECT_BUFFER: return DRAW_INDIRECT_SLOT;
+        default: return -1;
+    }
+}
+
+// Slot of a texture target, cube faces also give their index
+static GLint textureSlot(GLenum _target, GLuint& _face) {
+    _face = 0;
+    if (_target >= GL_TEXTURE_CUBE_MAP_POSITIVE_X && _target <= GL_TEXTURE_CUBE_MAP_NEGATIVE_Z) {
+        _face = _target - GL_TEXTURE_CUBE_MAP_POSITIVE_X;
+        return TEX_CUBE_MAP_SLOT;
+    }
+
+    switch (_target) {
+        case GL_TEXTURE_1D: return TEX_1D_SLOT;
+        case GL_TEXTURE_2D: return TEX_2D_SLOT;
+        case GL_TEXTURE_3D: return TEX_3D_SLOT;
+        case GL_TEXTURE_1D_ARRAY: return TEX_1D_ARRAY_SLOT;
+        case GL_TEXTURE_2D_ARRAY: return TEX_2D_ARRAY_SLOT;
+        case GL_TEXTURE_RECTANGLE: return TEX_RECTANGLE_SLOT;
+        case GL_TEXTURE_CUBE_MAP: return TEX_CUBE_MAP_SLOT;
+        case GL_TEXTURE_CUBE_MAP_ARRAY: return TEX_CUBE_MAP_ARRAY_SLOT;
+        case GL_TEXTURE_2D_MULTISAMPLE: return TEX_2D_MULTISAMPLE_SLOT;
+        case GL_TEXTURE_2D_MULTISAMPLE_ARRAY: return TEX_2D_MULTISAMPLE_ARRAY_SLOT;
+        default: return -1;  // Proxies and buffer textures hold no storage of their own
+    }
+}
+
+static GLuint boundBuffer(GLenum _target) {
+    if (_target == GL_ELEMENT_ARRAY_BUFFER) {
+        std::map<GLuint, GLuint>::iterator itr = vaoElements.find(boundVao);
+        return itr != vaoElements.end() ? itr->second : 0;
+    }
+    GLint slot = bufferSlot(_target);
+    return slot < 0 ? 0 : boundBuffers[slot];
+}
+
+static GLuint boundTexture(GLenum _target, GLuint& _face) {
+    GLint slot = textureSlot(_target, _face);
+    return slot < 0 ? 0 : boundTextures[activeUnit * TEXTURE_SLOT_SZ + slot];
+}
+
+// Deleted objects are unbound wherever the current context has them
+static void unbind(GLuint* _bound, size_t _count, GLuint _id) {
+    for (size_t i = 0; i < _count; ++i)
+        if (_bound[i] == _id) _bound[i] = 0;
+}
+
+/* ------------------------------ Accounting ----------------------------- */
+
+static void tally(Category _category, GLuint _owner, GLuint64 _bytes, bool _add) {
+    Usage& cat = totals[_category];
+    Usage& own = ownerTable[_owner].usage;
+    if (_add) {
+        cat.bytes += _bytes; cat.objects++;
+        own.bytes += _bytes; own.objects++;
+        totalBytes += _bytes; totalObjects++;
+    } else {
+        cat.bytes -= _bytes; cat.objects--;
+        own.bytes -= _bytes; own.objects--;
+        totalBytes -= _bytes; totalObjects--;
+    }
+    if (gauges[_category]) gauges[_category]->set((GLdouble) cat.bytes);
+}
+
+static void checkBudget() {
+    peak = std::max(peak, totalBytes);
+    if (gaugeTotal) gaugeTotal->set((GLdouble) totalBytes);
+    if (!budgetBytes) return;
+
+    if (!overBudget && totalBytes > budgetBytes) {
+        overBudget = true;
+        std::vector<std::pair<std::string, Usage> > list = owners();
+        fprintf(stderr, "GPU memory: %.1f MB is over the %.1f MB budget, %s holds the most (%.1f MB)\n",
+            megabytes(totalBytes), megabytes(budgetBytes), list[0].first.c_str(), megabytes(list[0].second.bytes));
+    } else if (overBudget && totalBytes < GPUMEM_BUDGET_REARM * budgetBytes) {
+        overBudget = false;
+    }
+}
+
+// Moves _obj to _category at _bytes, the owner stays
+static void account(Object& _obj, Category _category, GLuint64 _bytes) {
+    if (_obj.category == _category && _obj.bytes == _bytes) return;  // Orphaned at the same size
+    if (_obj.bytes) tally(_obj.category, _obj.owner, _obj.bytes, false);
+    _obj.category = _category;
+    _obj.bytes = _bytes;
+    if (_bytes) tally(_category, _obj.owner, _bytes, true);
+    checkBudget();
+}
+
+static void create(t_objects& _objects, GLsizei _n, const GLuint* _ids) {
+    GLuint owner = ownerStack.empty() ? 0 : ownerStack.back();
+    for (GLsizei i = 0; i < _n; ++i) {
+        Object& obj = _objects[_ids[i]];
+        if (obj.bytes) account(obj, obj.category, 0);
+        obj = Object();
+        obj.owner = owner;
+    }
+}
+
+static void release(t_objects& _objects, GLsizei _n, const GLuint* _ids) {
+    for (GLsizei i = 0; i < _n; ++i) {
+        t_objects::iterator itr = _objects.find(_ids[i]);
+        if (itr == _objects.end()) continue;
+        if (itr->second.bytes) account(itr->second, itr->second.category, 0);
+        _objects.erase(itr);
+    }
+}
+
+// Objects made before install() or without glGen* are charged to whoever is current
+static Object* lookup(t_objects& _objects, GLuint _id) {
+    if (!_id) return NULL;
+    t_objects::iterator itr = _objects.find(_id);
+    if (itr != _objects.end()) return &itr->second;
+    create(_objects, 1, &_id);
+    return &_objects[_id];
+}
+
+static void retallyTexture(Object& _tex, bool _depth) {
+    GLuint64 bytes = 0;
+    for (std::map<GLuint, Image>::iterator itr = _tex.images.begin(); itr != _tex.images.end(); ++itr)
+        bytes += itr->second.bytes;
+    account(_tex, _depth ? DEPTH_TEXTURE : TEXTURE, bytes);
+}
+
+static void setImage(GLenum _target, GLint _level, GLenum _format, GLsizei _w, GLsizei _h,
+                     GLsizei _d, GLsizei _samples, GLuint64 _bytes = 0) {
+    GLuint face;
+    Object* tex = lookup(textures, boundTexture(_target, face));
+    if (!tex) return;
+
+    Image img;
+    img.width = _w; img.height = _h; img.depth = _d;
+    img.bytes = _bytes ? _bytes : (GLuint64) _w * _h * _d * texelBytes(_format) * std::max(_samples, 1);
+    tex->images[face << 16 | _level] = img;
+    retallyTexture(*tex, isDepth(_format));
+}
+
+// Every level down to 1x1 from each face's level 0, _volume halves depth too
+static void setChain(Object& _tex, GLuint _faces, GLsizei _levels, bool _depth, bool _volume) {
+    for (GLuint f = 0; f < _faces; ++f) {
+        std::map<GLuint, Image>::iterator base = _tex.images.find(f << 16);
+        if (base == _tex.images.end()) continue;
+
+        Image top = base->second;
+        GLuint64 texels = (GLuint64) top.width * top.height * top.depth;
+        Image img = top;
+        for (GLsizei level = 1; level < _levels; ++level) {
+            if (img.width == 1 && img.height == 1 && (!_volume || img.depth == 1)) break;
+            img.width = std::max(img.width / 2, 1);
+            img.height = std::max(img.height / 2, 1);
+            if (_volume) img.depth = std::max(img.depth / 2, 1);
+            img.bytes = texels ? top.bytes * img.width * img.height * img.depth / texels : 0;
+            _tex.images[f << 16 | level] = img;
+        }
+    }
+    retallyTexture(_tex, _depth);
+}
+
+/* ------------------------------ Hooks ---------------------------------- */
+
+// Same scheme as glstats: real<Name> keeps the entry point track<Name> replaces
+#define HOOK_INSTALL(name)                  \
+    real##name = gl3w##name;                \
+    if (real##name) gl3w##name = track##name;
+
+static PFNGLGENBUFFERSPROC realGenBuffers;
+static PFNGLGENTEXTURESPROC realGenTextures;
+static PFNGLGENRENDERBUFFERSPROC realGenRenderbuffers;
+static PFNGLDELETEBUFFERSPROC realDeleteBuffers;
+static PFNGLDELETETEXTURESPROC realDeleteTextures;
+static PFNGLDELETERENDERBUFFERSPROC realDeleteRenderbuffers;
+static PFNGLBINDBUFFERPROC realBindBuffer;
+static PFNGLBINDBUFFERBASEPROC realBindBufferBase;
+static PFNGLBINDBUFFERRANGEPROC realBindBufferRange;
+static PFNGLBINDVERTEXARRAYPROC realBindVertexArray;
+static PFNGLDELETEVERTEXARRAYSPROC realDeleteVertexArrays;
+static PFNGLACTIVETEXTUREPROC realActiveTexture;
+static PFNGLBINDTEXTUREPROC realBindTexture;
+static PFNGLBINDRENDERBUFFERPROC realBindRenderbuffer;
+static PFNGLBUFFERDATAPROC realBufferData;
+static PFNGLTEXIMAGE1DPROC realTexImage1D;
+static PFNGLTEXIMAGE2DPROC realTexImage2D;
+static PFNGLTEXIMAGE3DPROC realTexImage3D;
+static PFNGLCOMPRESSEDTEXIMAGE2DPROC realCompressedTexImage2D;
+static PFNGLTEXIMAGE2DMULTISAMPLEPROC realTexImage2DMultisample;
+static PFNGLTEXSTORAGE2DPROC realTexStorage2D;
+static PFNGLTEXSTORAGE3DPROC realTexStorage3D;
+static PFNGLGENERATEMIPMAPPROC realGenerateMipmap;
+static PFNGLRENDERBUFFERSTORAGEPROC realRenderbufferStorage;
+static PFNGLRENDERBUFFERSTORAGEMULTISAMPLEPROC realRenderbufferStorageMultisample;
+
+static void APIENTRY trackGenBuffers(GLsizei n, GLuint* ids) {
+    realGenBuffers(n, ids);
+    create(buffers, n, ids);
+}
+
+static void APIENTRY trackGenTextures(GLsizei n, GLuint* ids) {
+    realGenTextures(n, ids);
+    create(textures, n, ids);
+}
+
+static void APIENTRY trackGenRenderbuffers(GLsizei n, GLuint* ids) {
+    realGenRenderbuffers(n, ids);
+    create(renderbuffers, n, ids);
+}
+
+static void APIENTRY trackDeleteBuffers(GLsizei n, const GLuint* ids) {
+    release(buffers, n, ids);
+    for (GLsizei i = 0; i < n; ++i) {
+        if (!ids[i]) continue;
+        unbind(boundBuffers, BUFFER_SLOT_SZ, ids[i]);
+        std::map<GLuint, GLuint>::iterator itr = vaoElements.find(boundVao);
+        if (itr != vaoElements.end() && itr->second == ids[i]) itr->second = 0;
+    }
+    realDeleteBuffers(n, ids);
+}
+
+static void APIENTRY trackDeleteTextures(GLsizei n, const GLuint* ids) {
+    release(textures, n, ids);
+    for (GLsizei i = 0; i < n; ++i)
+        if (ids[i]) unbind(&boundTextures[0], boundTextures.size(), ids[i]);
+    realDeleteTextures(n, ids);
+}
+
+static void APIENTRY trackDeleteRenderbuffers(GLsizei n, const GLuint* ids) {
+    release(renderbuffers, n, ids);
+    for (GLsizei i = 0; i < n; ++i)
+        if (ids[i]) unbind(&boundRenderbuffer, 1, ids[i]);
+    realDeleteRenderbuffers(n, ids);
+}
+
+static void APIENTRY trackBindBuffer(GLenum t, GLuint id) {
+    realBindBuffer(t, id);
+
+    GLint slot = bufferSlot(t);
+    if (slot >= 0) boundBuffers[slot] = id;
+    else if (t == GL_ELEMENT_ARRAY_BUFFER) vaoElements[boundVao] = id;
+}
+
+// Indexed binds set the generic binding too
+static void APIENTRY trackBindBufferBase(GLenum t, GLuint index, GLuint id) {
+    realBindBufferBase(t, index, id);
+
+    GLint slot = bufferSlot(t);
+    if (slot >= 0) boundBuffers[slot] = id;
+}
+
+static void APIENTRY trackBindBufferRange(GLenum t, GLuint index, GLuint id, GLintptr offset,
+                                          GLsizeiptr size) {
+    realBindBufferRange(t, index, id, offset, size);
+
+    GLint slot = bufferSlot(t);
+    if (slot >= 0) boundBuffers[slot] = id;
+}
+
+static void APIENTRY trackBindVertexArray(GLuint id) {
+    realBindVertexArray(id);
+    boundVao = id;
+}
+
+static void APIENTRY trackDeleteVertexArrays(GLsizei n, const GLuint* ids) {
+    for (GLsizei i = 0; i < n; ++i) {
+        if (!ids[i]) continue;
+        vaoElements.erase(ids[i]);
+        if (ids[i] == boundVao) boundVao = 0;
+    }
+    realDeleteVertexArrays(n, ids);
+}
+
+static void APIENTRY trackActiveTexture(GLenum unit) {
+    realActiveTexture(unit);
+
+    activeUnit = unit - GL_TEXTURE0;
+    if (boundTextures.size() < (activeUnit + 1) * TEXTURE_SLOT_SZ)
+        boundTextures.resize((activeUnit + 1) * TEXTURE_SLOT_SZ, 0);
+}
+
+static void APIENTRY trackBindTexture(GLenum t, GLuint id) {
+    realBindTexture(t, id);
+
+    GLuint face;
+    GLint slot = textureSlot(t, face);
+    if (slot >= 0) boundTextures[activeUnit * TEXTURE_SLOT_SZ + slot] = id;
+}
+
+static void APIENTRY trackBindRenderbuffer(GLenum t, GLuint id) {
+    realBindRenderbuffer(t, id);
+    boundRenderbuffer = id;
+}
+
+static void APIENTRY trackBufferData(GLenum t, GLsizeiptr size, const void* data, GLenum usage) {
+    realBufferData(t, size, data, usage);
+
+    Object* buf = lookup(buffers, boundBuffer(t));
+    if (!buf) return;
+    Category category = t == GL_ARRAY_BUFFER ? VERTEX_BUFFER :
+        t == GL_ELEMENT_ARRAY_BUFFER ? INDEX_BUFFER : OTHER_BUFFER;
+    account(*buf, category, (GLuint64) size);
+}
+
+static void APIENTRY trackTexImage1D(GLenum t, GLint l, GLint ifmt, GLsizei w, GLint b,
+                                     GLenum fmt, GLenum type, const void* px) {
+    realTexImage1D(t, l, ifmt, w, b, fmt, type, px);
+    setImage(t, l, ifmt, w, 1, 1, 1);
+}
+
+static void APIENTRY trackTexImage2D(GLenum t, GLint l, GLint ifmt, GLsizei w, GLsizei h,
+                                     GLint b, GLenum fmt, GLenum type, const void* px) {
+    realTexImage2D(t, l, ifmt, w, h, b, fmt, type, px);
+    setImage(t, l, ifmt, w, h, 1, 1);
+}
+
+static void APIENTRY trackTexImage3D(GLenum t, GLint l, GLint ifmt, GLsizei w, GLsizei h,
+                                     GLsizei d, GLint b, GLenum fmt, GLenum type, const void* px) {
+    realTexImage3D(t, l, ifmt, w, h, d, b, fmt, type, px);
+    setImage(t, l, ifmt, w, h, d, 1);
+}
+
+static void APIENTRY trackCompressedTexImage2D(GLenum t, GLint l, GLenum ifmt, GLsizei w,
+                                               GLsizei h, GLint b, GLsizei size, const void* px) {
+    realCompressedTexImage2D(t, l, ifmt, w, h, b, size, px);
+    setImage(t, l, ifmt, w, h, 1, 1, size);
+}
+
+static void APIENTRY trackTexImage2DMultisample(GLenum t, GLsizei s, GLenum ifmt, GLsizei w,
+                                                GLsizei h, GLboolean fixed) {
+    realTexImage2DMultisample(t, s, ifmt, w, h, fixed);
+    setImage(t, 0, ifmt, w, h, 1, s);
+}
+
+static void APIENTRY trackTexStorage2D(GLenum t, GLsizei levels, GLenum ifmt, GLsizei w, GLsizei h) {
+    realTexStorage2D(t, levels, ifmt, w, h);
+
+    GLuint face, faces = t == GL_TEXTURE_CUBE_MAP ? 6 : 1;
+    Object* tex = lookup(textures, boundTexture(t, face));
+    if (!tex) return;
+    tex->images.clear();
+
+    Image img;
+    img.width = w; img.height = h; img.depth = 1;
+    img.bytes = (GLuint64) w * h * texelBytes(ifmt);
+    for (GLuint f = 0; f < faces; ++f) tex->images[f << 16] = img;
+    setChain(*tex, faces, levels, isDepth(ifmt), false);
+}
+
+static void APIENTRY trackTexStorage3D(GLenum t, GLsizei levels, GLenum ifmt, GLsizei w,
+                                       GLsizei h, GLsizei d) {
+    realTexStorage3D(t, levels, ifmt, w, h, d);
+
+    GLuint face;
+    Object* tex = lookup(textures, boundTexture(t, face));
+    if (!tex) return;
+    tex->images.clear();
+
+    Image img;
+    img.width = w; img.height = h; img.depth = d;
+    img.bytes = (GLuint64) w * h * d * texelBytes(ifmt);
+    tex->images[0] = img;
+    setChain(*tex, 1, levels, isDepth(ifmt), t == GL_TEXTURE_3D);
+}
+
+static void APIENTRY trackGenerateMipmap(GLenum t) {
+    realGenerateMipmap(t);
+
+    GLuint face;
+    Object* tex = lookup(textures, boundTexture(t, face));
+    if (!tex) return;
+    setChain(*tex, t == GL_TEXTURE_CUBE_MAP ? 6 : 1, 32, tex->category == DEPTH_TEXTURE,
+        t == GL_TEXTURE_3D);
+}
+
+static void APIENTRY trackRenderbufferStorage(GLenum t, GLenum ifmt, GLsizei w, GLsizei h) {
+    realRenderbufferStorage(t, ifmt, w, h);
+
+    Object* rb = lookup(renderbuffers, boundRenderbuffer);
+    if (rb) account(*rb, RENDERBUFFER, (GLuint64) w * h * texelBytes(ifmt));
+}
+
+static void APIENTRY trackRenderbufferStorageMultisample(GLenum t, GLsizei s, GLenum ifmt,
+                                                         GLsizei w, GLsizei h) {
+    realRenderbufferStorageMultisample(t, s, ifmt, w, h);
+
+    Object* rb = lookup(renderbuffers, boundRenderbuffer);
+    if (rb) account(*rb, RENDERBUFFER, (GLuint64) w * h * texelBytes(ifmt) * std::max(s, 1));
+}
+
+extern void install() {
+    if (hooked) return;
+
+    HOOK_INSTALL(GenBuffers)
+    HOOK_INSTALL(GenTextures)
+    HOOK_INSTALL(GenRenderbuffers)
+    HOOK_INSTALL(DeleteBuffers)
+    HOOK_INSTALL(DeleteTextures)
+    HOOK_INSTALL(DeleteRenderbuffers)
+    HOOK_INSTALL(BindBuffer)
+    HOOK_INSTALL(BindBufferBase)
+    HOOK_INSTALL(BindBufferRange)
+    HOOK_INSTALL(BindVertexArray)
+    HOOK_INSTALL(DeleteVertexArrays)
+    HOOK_INSTALL(ActiveTexture)
+    HOOK_INSTALL(BindTexture)
+    HOOK_INSTALL(BindRenderbuffer)
+    HOOK_INSTALL(BufferData)
+    HOOK_INSTALL(TexImage1D)
+    HOOK_INSTALL(TexImage2D)
+    HOOK_INSTALL(TexImage3D)
+    HOOK_INSTALL(CompressedTexImage2D)
+    HOOK_INSTALL(TexImage2DMultisample)
+    HOOK_INSTALL(TexStorage2D)
+    HOOK_INSTALL(TexStorage3D)
+    HOOK_INSTALL(GenerateMipmap)
+    HOOK_INSTALL(RenderbufferStorage)
+    HOOK_INSTALL(RenderbufferStorageMultisample)
+
+    metrics::Registry& registry = metrics::Registry::instance();
+    gaugeTotal = &registry.gauge("gpu.bytes");
+    for (GLuint c = 0; c < CATEGORY_SZ; ++c) {
+        std::string name = std::string("gpu.bytes.") + kCategoryNames[c];
+        std::transform(name.begin(), name.end(), name.begin(), ::tolower);
+        gauges[c] = &registry.gauge(name);
+    }
+
+    hooked = true;
+}
+
+extern bool installed() { return hooked; }
+
+/* ------------------------------ Queries -------------------------------- */
+
+extern Usage total() {
+    Usage usage;
+    usage.bytes = totalBytes;
+    usage.objects = totalObjects;
+    return usage;
+}
+
+extern Usage usage(Category _category) { return totals[_category]; }
+
+extern GLuint64 peakBytes() { return peak; }
+
+static bool largerFirst(const std::pair<std::string, Usage>& a, const std::pair<std::string, Usage>& b) {
+    return a.second.bytes > b.second.bytes;
+}
+
+extern std::vector<std::pair<std::string, Usage> > owners() {
+    std::vector<std::pair<std::string, Usage> > list;
+    for (size_t i = 0; i < ownerTable.size(); ++i) {
+        if (!ownerTable[i].usage.objects) continue;
+        list.push_back(std::make_pair(i ? ownerTable[i].name : std::string(GPUMEM_UNTAGGED),
+            ownerTable[i].usage));
+    }
+    std::sort(list.begin(), list.end(), largerFirst);
+    return list;
+}
+
+extern void setBudget(GLuint64 _bytes) {
+    budgetBytes = _bytes;
+    overBudget = false;
+    checkBudget();
+}
+
+extern GLuint64 budget() { return budgetBytes; }
+
+extern void report(FILE* _fp) {
+    fprintf(_fp, "GPU memory: %.2f MB in %llu objects, peak %.2f MB", megabytes(totalBytes),
+        (unsigned long long) totalObjects, megabytes(peak));
+    if (budgetBytes) fprintf(_fp, ", budget %.2f MB", megabytes(budgetBytes));
+    fputc('\n', _fp);
+
+    for (GLuint c = 0; c < CATEGORY_SZ; ++c) {
+        if (!totals[c].objects) continue;
+        fprintf(_fp, "  %-24s %10.2f MB %6llu\n", kCategoryNames[c], megabytes(totals[c].bytes),
+            (unsigned long long) totals[c].objects);
+    }
+
+    std::vector<std::pair<std::string, Usage> > list = owners();
+    if (!list.empty()) fprintf(_fp, "  By owner:\n");
+    for (size_t i = 0; i < list.size(); ++i) {
+        fprintf(_fp, "  %-24s %10.2f MB %6llu\n", list[i].first.c_str(), megabytes(list[i].second.bytes),
+            (unsigned long long) list[i].second.objects);
+    }
+}
+
+/* ------------------------------ Owners --------------------------------- */
+
+OwnerScope::OwnerScope(const std::string& _owner) {
+    GLuint idx = 1;
+    while (idx < ownerTable.size() && ownerTable[idx].name != _owner) ++idx;
+    if (idx == ownerTable.size()) {
+        ownerTable.push_back(Owner());
+        ownerTable.back().name = _owner;
+    }
+    ownerStack.push_back(idx);
+}
+
+OwnerScope::~OwnerScope() { ownerStack.pop_back(); }
+
+}  // namespace gpumem
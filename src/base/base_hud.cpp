@@ -0,0 +1,170 @@
+#include <base_hud.h>
+#include <base_gpumem.h>
+#include <base_profiler.h>
+#include <base_util.h>
+
+#include <stdio.h>
+#include <unistd.h>
+#include <algorithm>
+
+/**
+ * @author: Methusael Murmu
+ */
+
+// Memory info extensions, reported in KB
+#define GPU_MEMORY_INFO_TOTAL_AVAILABLE_MEMORY_NVX 0x9048
+#define GPU_MEMORY_INFO_CURRENT_AVAILABLE_VIDMEM_NVX 0x9049
+#define TEXTURE_FREE_MEMORY_ATI 0x87FC
+
+namespace glf {
+
+// Resident set of the process in MB, 0 where /proc is missing
+static GLdouble residentMB() {
+    FILE* fp = fopen("/proc/self/statm", "r");
+    if (!fp) return 0.0;
+
+    unsigned long size = 0, resident = 0;
+    int read = fscanf(fp, "%lu %lu", &size, &resident);
+    fclose(fp);
+    return read == 2 ? resident * (GLdouble) sysconf(_SC_PAGESIZE) / (1024.0 * 1024.0) : 0.0;
+}
+
+static inline GLdouble megabytes(GLuint64 _bytes) { return _bytes / (1024.0 * 1024.0); }
+
+static std::string countStr(GLuint64 _n) {
+    char buf[32];
+    if (_n >= 1000000) snprintf(buf, sizeof(buf), "%.2fM", _n / 1.0e6);
+    else if (_n >= 10000) snprintf(buf, sizeof(buf), "%.1fK", _n / 1.0e3);
+    else snprintf(buf, sizeof(buf), "%llu", (unsigned long long) _n);
+    return buf;
+}
+
+PerfHUD::PerfHUD(): head(0), count(0), lastTime(-1.0), lastRefresh(0.0),
+    probed(false), memNVX(false), memATI(false) {}
+
+void PerfHUD::frameUpdated(GLdouble _time, const glstats::Counters& _gl) {
+    if (lastTime >= 0.0) {
+        history[head] = (GLfloat) (1000.0 * (_time - lastTime));
+        head = (head + 1) % HUD_HISTORY;
+        count = std::min(count + 1, (GLuint) HUD_HISTORY);
+    }
+    lastTime = _time;
+    gl = _gl;
+
+    if (_time - lastRefresh > HUD_REFRESH) {
+        refresh();
+        lastRefresh = _time;
+    }
+}
+
+void PerfHUD::refresh() {
+    char buf[160];
+    lines.clear();
+
+    if (count) {
+        std::vector<GLfloat> sorted(history, history + count);
+        std::sort(sorted.begin(), sorted.end());
+        GLdouble sum = 0.0;
+        for (GLuint i = 0; i < count; ++i) sum += sorted[i];
+
+        GLdouble mean = sum / count;
+        snprintf(buf, sizeof(buf), "Frame %.2f ms (%.0f fps)  p50 %.2f  p95 %.2f  p99 %.2f  max %.2f",
+            mean, mean > 0.0 ? 1000.0 / mean : 0.0, sorted[count / 2],
+            sorted[(count * 95) / 100], sorted[(count * 99) / 100], sorted[count - 1]);
+        lines.push_back(buf);
+    }
+
+    snprintf(buf, sizeof(buf), "Draws %s  Triangles %s  State changes %s",
+        countStr(gl.draws).c_str(), countStr(gl.triangles).c_str(),
+        countStr(gl.stateChanges).c_str());
+    lines.push_back(buf);
+
+    // Outermost GPU zones of the latest profiled frame
+    const prof::Profiler& profiler = prof::Profiler::instance();
+    if (profiler.enabled() && profiler.hasFrame()) {
+        const prof::Frame& frame = profiler.lastFrame();
+        GLuint listed = 0;
+        for (size_t i = 0; i < frame.zones.size() && listed < HUD_MAX_PASSES; ++i) {
+            const prof::Zone& z = frame.zones[i];
+            if (!z.gpu || z.depth > 1) continue;
+            snprintf(buf, sizeof(buf), "GPU %*s%s %.3f ms", 2 * z.depth, "", z.name, z.gpuMs());
+            lines.push_back(buf);
+            listed++;
+        }
+    }
+
+    if (!probed) {
+        memNVX = util::has_extension("GL_NVX_gpu_memory_info");
+        memATI = util::has_extension("GL_ATI_meminfo");
+        probed = true;
+    }
+
+    GLint freeKB[4] = { 0, 0, 0, 0 }, totalKB = 0;
+    if (memNVX) {
+        glGetIntegerv(GPU_MEMORY_INFO_CURRENT_AVAILABLE_VIDMEM_NVX, freeKB);
+        glGetIntegerv(GPU_MEMORY_INFO_TOTAL_AVAILABLE_MEMORY_NVX, &totalKB);
+        snprintf(buf, sizeof(buf), "Memory %.1f MB resident, GPU %.0f of %.0f MB free",
+            residentMB(), freeKB[0] / 1024.0, totalKB / 1024.0);
+    } else if (memATI) {
+        glGetIntegerv(TEXTURE_FREE_MEMORY_ATI, freeKB);
+        snprintf(buf, sizeof(buf), "Memory %.1f MB resident, GPU %.0f MB free",
+            residentMB(), freeKB[0] / 1024.0);
+    } else {
+        snprintf(buf, sizeof(buf), "Memory %.1f MB resident", residentMB());
+    }
+    lines.push_back(buf);
+
+    // Allocations gpumem tracked, by category, then the largest owners
+    gpumem::Usage gpu = gpumem::total();
+    if (!gpu.objects) return;
+
+    std::string line;
+    snprintf(buf, sizeof(buf), "GPU alloc %.1f MB", megabytes(gpu.bytes));
+    line = buf;
+    if (gpumem::budget()) {
+        snprintf(buf, sizeof(buf), " of %.0f MB", megabytes(gpumem::budget()));
+        line += buf;
+    }
+    for (GLuint c = 0; c < gpumem::CATEGORY_SZ; ++c) {
+        gpumem::Usage use = gpumem::usage((gpumem::Category) c);
+        if (!use.objects) continue;
+        snprintf(buf, sizeof(buf), "  %s %.1f", gpumem::categoryName((gpumem::Category) c),
+            megabytes(use.bytes));
+        line += buf;
+    }
+    lines.push_back(line);
+
+    std::vector<std::pair<std::string, gpumem::Usage> > owners = gpumem::owners();
+    line = "GPU owners";
+    for (size_t i = 0; i < owners.size() && i < HUD_MAX_OWNERS; ++i) {
+        snprintf(buf, sizeof(buf), "  %s %.1f", owners[i].first.c_str(),
+            megabytes(owners[i].second.bytes));
+        line += buf;
+    }
+    lines.push_back(line);
+}
+
+void PerfHUD::queue(text::FontRenderer& _renderer, GLfloat _x, GLfloat _y,
+                    GLfloat _scale, GLfloat _unit) {
+    const GLfloat lineHeight = 14.0f * _unit;
+    for (size_t i = 0; i < lines.size(); ++i) {
+        _y -= lineHeight;
+        _renderer.queueText(lines[i], _x, _y, _scale);
+    }
+
+    // Graph: a bar per frame, oldest left, with lines at 60 and 30 fps
+    const GLfloat height = 50.0f * _unit, bar = _unit;
+    GLfloat base = _y - 8.0f * _unit - height;
+    _renderer.queueQuad(_x, base - _unit, HUD_HISTORY * bar, _unit);
+    _renderer.queueQuad(_x, base + height * (1000.0f / 60.0f) / HUD_GRAPH_MS, HUD_HISTORY * bar, 0.5f * _unit);
+    _renderer.queueQuad(_x, base + height * (1000.0f / 30.0f) / HUD_GRAPH_MS, HUD_HISTORY * bar, 0.5f * _unit);
+
+    GLuint first = count < HUD_HISTORY ? 0 : head;
+    for (GLuint i = 0; i < count; ++i) {
+        GLfloat ms = history[(first + i) % HUD_HISTORY];
+        GLfloat h = std::min(ms / HUD_GRAPH_MS, 1.0f) * height;
+        _renderer.queueQuad(_x + i * bar, base, 0.75f * bar, std::max(h, _unit));
+    }
+}
+
+}  // namespace glf
@@ -0,0 +1,122 @@
+#include <base_jobs.h>
+#include <base_metrics.h>
+
+/**
+ * @author: Methusael Murmu
+ */
+
+namespace jobs {
+
+// Worker threads know their system and queue, everyone else uses queue 0
+static thread_local const JobSystem* tlsSystem = NULL;
+static thread_local GLuint tlsIndex = 0;
+
+JobSystem::JobSystem(GLuint _threads): queued(0), sleeping(0), quit(false) {
+    GLuint count = _threads ? _threads : std::max(1u, std::thread::hardware_concurrency());
+    for (GLuint i = 0; i < count; ++i) queues.push_back(new Queue());
+    for (GLuint i = 1; i < count; ++i) workers.push_back(std::thread(&JobSystem::work, this, i));
+}
+
+JobSystem::~JobSystem() {
+    {
+        std::lock_guard<std::mutex> guard(sleepLock);
+        quit = true;
+    }
+    wake.notify_all();
+
+    for (size_t i = 0; i < workers.size(); ++i) workers[i].join();
+    for (size_t i = 0; i < queues.size(); ++i) delete queues[i];
+}
+
+JobSystem& JobSystem::instance() {
+    static JobSystem system;
+    return system;
+}
+
+void JobSystem::run(const Job& _job) {
+    if (_job.counter) _job.counter->pending.fetch_add(1, std::memory_order_relaxed);
+    if (!push(self(), _job)) {
+        static metrics::Counter& inlined = metrics::Registry::instance().counter("jobs.inlined");
+        inlined.add();
+        execute(_job);
+        return;
+    }
+
+    // Pairs with the sleeping/queued check in work(), one side always sees the other
+    queued.fetch_add(1);
+    if (sleeping.load() > 0) {
+        { std::lock_guard<std::mutex> guard(sleepLock); }
+        wake.notify_one();
+    }
+}
+
+void JobSystem::wait(const JobCounter& _counter) {
+    GLuint me = self();
+    while (!_counter.done())
+        if (!runOne(me)) std::this_thread::yield();
+}
+
+GLuint JobSystem::self() const {
+    return tlsSystem == this ? tlsIndex : 0;
+}
+
+bool JobSystem::push(GLuint _queue, const Job& _job) {
+    Queue& q = *queues[_queue];
+    std::lock_guard<std::mutex> guard(q.lock);
+    if (q.tail - q.head == JOB_QUEUE_SZ) return false;
+
+    q.jobs[q.tail++ % JOB_QUEUE_SZ] = _job;
+    return true;
+}
+
+bool JobSystem::pop(GLuint _queue, Job& _job) {
+    Queue& q = *queues[_queue];
+    std::lock_guard<std::mutex> guard(q.lock);
+    if (q.tail == q.head) return false;
+
+    _job = q.jobs[--q.tail % JOB_QUEUE_SZ];
+    return true;
+}
+
+bool JobSystem::steal(GLuint _queue, Job& _job) {
+    Queue& q = *queues[_queue];
+    std::lock_guard<std::mutex> guard(q.lock);
+    if (q.tail == q.head) return false;
+
+    _job = q.jobs[q.head++ % JOB_QUEUE_SZ];
+    return true;
+}
+
+// Own newest job first, else the oldest job of the next queue that has one
+bool JobSystem::runOne(GLuint _self) {
+    Job job;
+    bool found = pop(_self, job);
+    for (GLuint i = 1; !found && i < queues.size(); ++i)
+        found = steal((_self + i) % queues.size(), job);
+    if (!found) return false;
+
+    queued.fetch_sub(1);
+    execute(job);
+    return true;
+}
+
+void JobSystem::execute(const Job& _job) {
+    if (_job.after) wait(*_job.after);
+    _job.fn(_job.data, _job.begin, _job.end);
+    if (_job.counter) _job.counter->pending.fetch_sub(1, std::memory_order_release);
+}
+
+void JobSystem::work(GLuint _index) {
+    tlsSystem = this; tlsIndex = _index;
+
+    while (!quit) {
+        if (runOne(_index)) continue;
+
+        std::unique_lock<std::mutex> lock(sleepLock);
+        sleeping.fetch_add(1);
+        while (queued.load() <= 0 && !quit) wake.wait(lock);
+        sleeping.fetch_sub(1);
+    }
+}
+
+}  // namespace jobs
@@ -0,0 +1,316 @@
+#include <base_metrics.h>
+
+#include <math.h>
+#include <algorithm>
+#include <chrono>
+
+/**
+ * @author: Methusael Murmu
+ */
+
+#define METRICS_SUB_COUNT (1u << METRICS_SUB_BITS)
+#define METRICS_HALF_COUNT (METRICS_SUB_COUNT >> 1)
+#define METRICS_MAX_VALUE ((1ull << METRICS_MAX_BITS) - 1)
+
+namespace metrics {
+
+static const std::chrono::steady_clock::time_point origin = std::chrono::steady_clock::now();
+
+extern GLuint bucketOf(GLuint64 _value) {
+    _value = std::min(_value, (GLuint64) METRICS_MAX_VALUE);
+    if (_value < METRICS_SUB_COUNT) return (GLuint) _value;
+
+    GLuint shift = 63 - __builtin_clzll(_value) - (METRICS_SUB_BITS - 1);
+    return shift * METRICS_HALF_COUNT + (GLuint) (_value >> shift);
+}
+
+extern GLuint64 bucketLow(GLuint _bucket) {
+    if (_bucket < METRICS_SUB_COUNT) return _bucket;
+
+    GLuint shift = (_bucket - METRICS_SUB_COUNT) / METRICS_HALF_COUNT + 1;
+    return (GLuint64) (_bucket - shift * METRICS_HALF_COUNT) << shift;
+}
+
+extern GLuint64 bucketHigh(GLuint _bucket) {
+    if (_bucket < METRICS_SUB_COUNT) return _bucket;
+
+    GLuint shift = (_bucket - METRICS_SUB_COUNT) / METRICS_HALF_COUNT + 1;
+    return ((GLuint64) (_bucket - shift * METRICS_HALF_COUNT + 1) << shift) - 1;
+}
+
+/* ------------------------------ Histogram ------------------------------ */
+
+void Histogram::record(GLuint64 _value, GLuint64 _count) {
+    if (!_count) return;
+
+    counts[bucketOf(_value)] += _count;
+    total += _count;
+    sum += _value * _count;
+    lowest = std::min(lowest, _value);
+    highest = std::max(highest, _value);
+}
+
+void Histogram::merge(const Histogram& _other) {
+    if (!_other.total) return;
+
+    for (GLuint i = 0; i < METRICS_BUCKETS; ++i) counts[i] += _other.counts[i];
+    total += _other.total;
+    sum += _other.sum;
+    lowest = std::min(lowest, _other.lowest);
+    highest = std::max(highest, _other.highest);
+}
+
+void Histogram::reset() {
+    std::fill(counts, counts + METRICS_BUCKETS, 0);
+    total = sum = highest = 0;
+    lowest = ~0ull;
+}
+
+GLuint64 Histogram::percentile(GLdouble _percent) const {
+    if (!total) return 0;
+
+    GLuint64 target = (GLuint64) ceil(std::min(_percent, 100.0) / 100.0 * total);
+    target = std::max(target, (GLuint64) 1);
+
+    GLuint64 seen = 0;
+    for (GLuint i = 0; i < METRICS_BUCKETS; ++i) {
+        seen += counts[i];
+        if (seen >= target) return std::min(bucketHigh(i), highest);
+    }
+    return highest;
+}
+
+Summary Histogram::summary() const {
+    Summary s;
+    s.count = total;
+    s.min = min(); s.max = max(); s.mean = mean();
+    s.p50 = percentile(50.0); s.p90 = percentile(90.0);
+    s.p99 = percentile(99.0); s.p999 = percentile(99.9);
+    return s;
+}
+
+/* ------------------------------ Recorder ------------------------------- */
+
+Recorder::Recorder(): active(0) {
+    clear(halves[0]); clear(halves[1]);
+    halves[0].writers = halves[1].writers = 0;
+}
+
+void Recorder::clear(Half& _half) {
+    for (GLuint i = 0; i < METRICS_BUCKETS; ++i)
+        _half.counts[i].store(0, std::memory_order_relaxed);
+    _half.total.store(0, std::memory_order_relaxed);
+    _half.sum.store(0, std::memory_order_relaxed);
+    _half.lowest.store(~0ull, std::memory_order_relaxed);
+    _half.highest.store(0, std::memory_order_relaxed);
+}
+
+void Recorder::record(GLuint64 _value) {
+    for (;;) {
+        // Announce the write, then make sure the half didn't flip meanwhile
+        GLuint idx = active.load();
+        Half& half = halves[idx];
+        half.writers.fetch_add(1);
+        if (active.load() != idx) {
+            half.writers.fetch_sub(1);
+            continue;
+        }
+
+        half.counts[bucketOf(_value)].fetch_add(1, std::memory_order_relaxed);
+        half.total.fetch_add(1, std::memory_order_relaxed);
+        half.sum.fetch_add(_value, std::memory_order_relaxed);
+
+        GLuint64 low = half.lowest.load(std::memory_order_relaxed);
+        while (_value < low && !half.lowest.compare_exchange_weak(low, _value,
+            std::memory_order_relaxed)) {}
+        GLuint64 high = half.highest.load(std::memory_order_relaxed);
+        while (_value > high && !half.highest.compare_exchange_weak(high, _value,
+            std::memory_order_relaxed)) {}
+
+        half.writers.fetch_sub(1);
+        return;
+    }
+}
+
+void Recorder::takeInterval(Histogram& _interval) {
+    std::lock_guard<std::mutex> guard(readLock);
+
+    GLuint idx = active.load();
+    active.store(idx ^ 1);
+    Half& half = halves[idx];
+    while (half.writers.load() != 0) std::this_thread::yield();
+
+    _interval.reset();
+    for (GLuint i = 0; i < METRICS_BUCKETS; ++i)
+        _interval.counts[i] = half.counts[i].load(std::memory_order_relaxed);
+    _interval.total = half.total.load(std::memory_order_relaxed);
+    _interval.sum = half.sum.load(std::memory_order_relaxed);
+    _interval.lowest = half.lowest.load(std::memory_order_relaxed);
+    _interval.highest = half.highest.load(std::memory_order_relaxed);
+    clear(half);
+
+    totals.merge(_interval);
+}
+
+Summary Recorder::totalSummary() {
+    std::lock_guard<std::mutex> guard(readLock);
+    return totals.summary();
+}
+
+/* ------------------------------ Registry ------------------------------- */
+
+template <typename T>
+static T& lookup(std::map<std::string, T*>& _map, const std::string& _name) {
+    typename std::map<std::string, T*>::iterator itr = _map.find(_name);
+    if (itr != _map.end()) return *itr->second;
+
+    T* metric = new T();
+    _map[_name] = metric;
+    return *metric;
+}
+
+template <typename T>
+static void release(std::map<std::string, T*>& _map) {
+    for (typename std::map<std::string, T*>::iterator itr = _map.begin(); itr != _map.end(); ++itr)
+        delete itr->second;
+    _map.clear();
+}
+
+static void writeName(FILE* _fp, const std::string& _name) {
+    fputc('"', _fp);
+    for (size_t i = 0; i < _name.size(); ++i) {
+        if (_name[i] == '"' || _name[i] == '\\') fputc('\\', _fp);
+        if ((unsigned char) _name[i] >= 0x20) fputc(_name[i], _fp);
+    }
+    fputc('"', _fp);
+}
+
+static void writeSummary(FILE* _fp, const Summary& _s) {
+    fprintf(_fp, "{\"count\":%llu,\"min\":%llu,\"max\":%llu,\"mean\":%.3f,"
+        "\"p50\":%llu,\"p90\":%llu,\"p99\":%llu,\"p999\":%llu}",
+        (unsigned long long) _s.count, (unsigned long long) _s.min,
+        (unsigned long long) _s.max, _s.mean, (unsigned long long) _s.p50,
+        (unsigned long long) _s.p90, (unsigned long long) _s.p99,
+        (unsigned long long) _s.p999);
+}
+
+Registry& Registry::instance() {
+    static Registry registry;
+    return registry;
+}
+
+Registry::~Registry() {
+    stopExport();
+    release(counters);
+    release(gauges);
+    release(histograms);
+}
+
+Counter& Registry::counter(const std::string& _name) {
+    std::lock_guard<std::mutex> guard(lock);
+    return lookup(counters, _name);
+}
+
+Gauge& Registry::gauge(const std::string& _name) {
+    std::lock_guard<std::mutex> guard(lock);
+    return lookup(gauges, _name);
+}
+
+Recorder& Registry::histogram(const std::string& _name) {
+    std::lock_guard<std::mutex> guard(lock);
+    return lookup(histograms, _name);
+}
+
+Snapshot Registry::snapshot() {
+    Snapshot snap;
+    snap.time = std::chrono::duration<GLdouble>(std::chrono::steady_clock::now() - origin).count();
+
+    std::lock_guard<std::mutex> guard(lock);
+    for (std::map<std::string, Counter*>::iterator itr = counters.begin(); itr != counters.end(); ++itr)
+        snap.counters.push_back(std::make_pair(itr->first, itr->second->get()));
+    for (std::map<std::string, Gauge*>::iterator itr = gauges.begin(); itr != gauges.end(); ++itr)
+        snap.gauges.push_back(std::make_pair(itr->first, itr->second->get()));
+
+    Histogram interval;
+    for (std::map<std::string, Recorder*>::iterator itr = histograms.begin();
+        itr != histograms.end(); ++itr) {
+        Snapshot::Series series;
+        series.name = itr->first;
+        itr->second->takeInterval(interval);
+        series.interval = interval.summary();
+        series.total = itr->second->totalSummary();
+        snap.histograms.push_back(series);
+    }
+    return snap;
+}
+
+// One JSON object per line
+void Registry::write(FILE* _fp, const Snapshot& _snap) {
+    fprintf(_fp, "{\"time\":%.3f,\"counters\":{", _snap.time);
+    for (size_t i = 0; i < _snap.counters.size(); ++i) {
+        if (i) fputc(',', _fp);
+        writeName(_fp, _snap.counters[i].first);
+        fprintf(_fp, ":%llu", (unsigned long long) _snap.counters[i].second);
+    }
+
+    fprintf(_fp, "},\"gauges\":{");
+    for (size_t i = 0; i < _snap.gauges.size(); ++i) {
+        if (i) fputc(',', _fp);
+        writeName(_fp, _snap.gauges[i].first);
+        fprintf(_fp, ":%.6g", _snap.gauges[i].second);
+    }
+
+    fprintf(_fp, "},\"histograms\":{");
+    for (size_t i = 0; i < _snap.histograms.size(); ++i) {
+        if (i) fputc(',', _fp);
+        writeName(_fp, _snap.histograms[i].name);
+        fprintf(_fp, ":{\"interval\":");
+        writeSummary(_fp, _snap.histograms[i].interval);
+        fprintf(_fp, ",\"total\":");
+        writeSummary(_fp, _snap.histograms[i].total);
+        fputc('}', _fp);
+    }
+    fprintf(_fp, "}}\n");
+}
+
+bool Registry::startExport(const char* _path, GLdouble _interval) {
+    stopExport();
+
+    FILE* fp = fopen(_path, "a");
+    if (!fp) {
+        fprintf(stderr, "Metrics: unable to open %s\n", _path);
+        return false;
+    }
+
+    exportQuit = false;
+    exporter = std::thread(&Registry::exportLoop, this, fp, std::max(_interval, 0.01));
+    return true;
+}
+
+void Registry::stopExport() {
+    if (!exporter.joinable()) return;
+
+    {
+        std::lock_guard<std::mutex> guard(exportLock);
+        exportQuit = true;
+    }
+    exportWake.notify_all();
+    exporter.join();
+}
+
+// Writes a last snapshot on the way out, so short runs still leave a line
+void Registry::exportLoop(FILE* _fp, GLdouble _interval) {
+    std::chrono::duration<GLdouble> period(_interval);
+    std::unique_lock<std::mutex> wait(exportLock);
+
+    for (bool quit = false; !quit;) {
+        quit = exportWake.wait_for(wait, period, [this] { return exportQuit; });
+        wait.unlock();
+        write(_fp, snapshot());
+        fflush(_fp);
+        wait.lock();
+    }
+    fclose(_fp);
+}
+
+}  // namespace metrics
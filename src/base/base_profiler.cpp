@@ -0,0 +1,316 @@
+#include <base_profiler.h>
+#include <base_metrics.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <set>
+
+/**
+ * @author: Methusael Murmu
+ */
+
+#define PROF_FRAME_THREAD (PROF_GPU_THREAD + 1)  // Trace track of the frames themselves
+#define PROF_NO_QUERY (~0u)
+
+namespace prof {
+
+static const std::chrono::steady_clock::time_point origin = std::chrono::steady_clock::now();
+
+// Threads are numbered in the order they first open a zone
+static std::atomic<GLuint> threadCount(0);
+static thread_local GLuint tlsThread = ~0u;
+static thread_local std::vector<Zone> tlsOpen;
+
+static bool zoneOrder(const Zone& _a, const Zone& _b) {
+    if (_a.thread != _b.thread) return _a.thread < _b.thread;
+    if (_a.start != _b.start) return _a.start < _b.start;
+    return _a.depth < _b.depth;
+}
+
+static void writeName(FILE* _fp, const char* _name) {
+    fputc('"', _fp);
+    for (const char* c = _name; *c; ++c) {
+        if (*c == '"' || *c == '\\') fputc('\\', _fp);
+        if ((unsigned char) *c >= 0x20) fputc(*c, _fp);
+    }
+    fputc('"', _fp);
+}
+
+Profiler::Profiler(): active(false), inFrame(false), published(false),
+    frameIndex(0), dropped(0), traceLeft(0) {
+    current.index = 0;
+    current.start = current.end = 0.0;
+}
+
+Profiler& Profiler::instance() {
+    static Profiler profiler;
+    return profiler;
+}
+
+GLdouble Profiler::now() const {
+    return std::chrono::duration<GLdouble, std::micro>(
+        std::chrono::steady_clock::now() - origin).count();
+}
+
+void Profiler::beginFrame() {
+    if (!active || inFrame) return;
+
+    // Zones closed before the first frame, kept only for a capture already running
+    if (frameIndex == 0) {
+        std::lock_guard<std::mutex> guard(lock);
+        if (traceLeft && !current.zones.empty()) {
+            current.end = now();
+            std::sort(current.zones.begin(), current.zones.end(), zoneOrder);
+            trace.push_back(current);
+        }
+        current.zones.clear();
+    }
+
+    frameIndex++;
+    Slot& slot = slots[frameIndex % PROF_GPU_FRAMES];
+    if (slot.pending) resolve(slot);
+    slot.used = 0;
+    slot.records.clear();
+
+    // Maps GPU timestamps onto the CPU clock; the GL time is taken once the
+    // commands so far reached the server, close enough for a timeline
+    GLint64 gpuNow = 0;
+    glGetInteger64v(GL_TIMESTAMP, &gpuNow);
+    GLdouble cpuNow = now();
+    slot.gpuOffset = cpuNow - gpuNow / 1000.0;
+
+    std::lock_guard<std::mutex> guard(lock);
+    current.index = frameIndex;
+    current.start = cpuNow;
+    inFrame = true;
+}
+
+void Profiler::endFrame() {
+    if (!inFrame) return;
+
+    Slot& slot = slots[frameIndex % PROF_GPU_FRAMES];
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        slot.frame.index = current.index;
+        slot.frame.start = current.start;
+        slot.frame.end = now();
+        slot.frame.zones.swap(current.zones);
+        current.zones.clear();
+    }
+    slot.pending = true;
+    inFrame = false;
+}
+
+void Profiler::beginZone(const char* _name) {
+    if (!active) return;
+    if (tlsThread == ~0u) tlsThread = threadCount++;
+
+    Zone zone;
+    zone.name = _name;
+    zone.thread = tlsThread;
+    zone.depth = tlsOpen.size();
+    zone.start = zone.end = now();
+    zone.gpuStart = zone.gpuEnd = 0.0;
+    zone.gpu = false;
+    tlsOpen.push_back(zone);
+}
+
+void Profiler::endZone() {
+    closeZone();
+}
+
+// Returns the closed zone's index in the current frame
+GLuint Profiler::closeZone() {
+    if (tlsOpen.empty()) return PROF_NO_QUERY;
+
+    Zone zone = tlsOpen.back();
+    tlsOpen.pop_back();
+    zone.end = now();
+
+    std::lock_guard<std::mutex> guard(lock);
+    current.zones.push_back(zone);
+    return current.zones.size() - 1;
+}
+
+void Profiler::beginGpuZone(const char* _name) {
+    if (!active) return;
+    beginZone(_name);
+
+    // Outside a frame only the CPU side is timed
+    GpuOpen open = { _name, PROF_NO_QUERY };
+    if (inFrame) {
+        Slot& slot = slots[frameIndex % PROF_GPU_FRAMES];
+        open.begin = query(slot);
+        glQueryCounter(slot.queries[open.begin], GL_TIMESTAMP);
+    }
+    gpuOpen.push_back(open);
+}
+
+void Profiler::endGpuZone() {
+    if (gpuOpen.empty()) return;
+
+    GpuOpen open = gpuOpen.back();
+    gpuOpen.pop_back();
+    if (open.begin == PROF_NO_QUERY || !inFrame) {
+        closeZone();
+        return;
+    }
+
+    Slot& slot = slots[frameIndex % PROF_GPU_FRAMES];
+    GpuRecord record;
+    record.begin = open.begin;
+    record.end = query(slot);
+    glQueryCounter(slot.queries[record.end], GL_TIMESTAMP);
+
+    record.zone = closeZone();
+    if (record.zone != PROF_NO_QUERY) slot.records.push_back(record);
+}
+
+GLuint Profiler::query(Slot& _slot) {
+    if (_slot.used == _slot.queries.size()) {
+        GLuint q;
+        glGenQueries(1, &q);
+        _slot.queries.push_back(q);
+    }
+    return _slot.used++;
+}
+
+void Profiler::resolve(Slot& _slot) {
+    _slot.pending = false;
+
+    // Queries complete in order: the last one available means all are
+    GLint available = 1;
+    if (_slot.used)
+        glGetQueryObjectiv(_slot.queries[_slot.used - 1], GL_QUERY_RESULT_AVAILABLE, &available);
+
+    if (available) {
+        for (size_t i = 0; i < _slot.records.size(); ++i) {
+            const GpuRecord& r = _slot.records[i];
+            GLuint64 begin, end;
+            glGetQueryObjectui64v(_slot.queries[r.begin], GL_QUERY_RESULT, &begin);
+            glGetQueryObjectui64v(_slot.queries[r.end], GL_QUERY_RESULT, &end);
+
+            Zone& zone = _slot.frame.zones[r.zone];
+            zone.gpu = true;
+            zone.gpuStart = begin / 1000.0 + _slot.gpuOffset;
+            zone.gpuEnd = end / 1000.0 + _slot.gpuOffset;
+        }
+    } else {
+        static metrics::Counter& late = metrics::Registry::instance().counter("profiler.gpu_dropped");
+        late.add();
+        dropped++;
+    }
+    publish(_slot.frame);
+}
+
+void Profiler::publish(Frame& _frame) {
+    std::sort(_frame.zones.begin(), _frame.zones.end(), zoneOrder);
+    last.index = _frame.index;
+    last.start = _frame.start;
+    last.end = _frame.end;
+    last.zones.swap(_frame.zones);
+    published = true;
+
+    if (!traceLeft) return;
+    trace.push_back(last);
+    if (--traceLeft == 0) {
+        if (writeTrace()) {
+            fprintf(stdout, "Profiler: wrote %u frames to %s\n",
+                (GLuint) trace.size(), tracePath.c_str());
+        }
+        std::vector<Frame>().swap(trace);
+    }
+}
+
+void Profiler::print(FILE* _out) const {
+    if (!published) return;
+
+    fprintf(_out, "Frame %u: %.3f ms\n", last.index, last.ms());
+    GLuint thread = ~0u;
+    for (size_t i = 0; i < last.zones.size(); ++i) {
+        const Zone& z = last.zones[i];
+        if (z.thread != thread) {
+            fprintf(_out, "  Thread %u\n", z.thread);
+            thread = z.thread;
+        }
+
+        GLint indent = 2 * z.depth;
+        fprintf(_out, "    %*s%-*s %8.3f ms", indent, "", std::max(1, 32 - indent), z.name, z.cpuMs());
+        if (z.gpu) fprintf(_out, "  %8.3f ms gpu", z.gpuMs());
+        fprintf(_out, "\n");
+    }
+}
+
+void Profiler::captureTrace(const char* _path, GLuint _frames) {
+    tracePath = _path;
+    traceLeft = std::max(1u, _frames);
+    trace.clear();
+    active = true;
+    fprintf(stdout, "Profiler: capturing %u frames\n", traceLeft);
+}
+
+void Profiler::dispose() {
+    for (GLuint i = 0; i < PROF_GPU_FRAMES; ++i) {
+        Slot& slot = slots[i];
+        if (!slot.queries.empty())
+            glDeleteQueries(slot.queries.size(), &slot.queries[0]);
+        slot.queries.clear();
+        slot.records.clear();
+        slot.used = 0;
+        slot.pending = false;
+    }
+}
+
+// Complete ("X") events per zone, GPU zones again on their own track
+bool Profiler::writeTrace() const {
+    FILE* fp = fopen(tracePath.c_str(), "w");
+    if (!fp) {
+        fprintf(stderr, "Profiler: unable to write trace %s\n", tracePath.c_str());
+        return false;
+    }
+
+    std::set<GLuint> threads;
+    for (size_t f = 0; f < trace.size(); ++f)
+        for (size_t i = 0; i < trace[f].zones.size(); ++i)
+            threads.insert(trace[f].zones[i].thread);
+
+    fprintf(fp, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+    for (std::set<GLuint>::const_iterator t = threads.begin(); t != threads.end(); ++t) {
+        fprintf(fp, "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":%u,"
+            "\"args\":{\"name\":\"Thread %u\"}},\n", *t, *t);
+    }
+    fprintf(fp, "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":%u,"
+        "\"args\":{\"name\":\"GPU\"}},\n", PROF_GPU_THREAD);
+    fprintf(fp, "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":%u,"
+        "\"args\":{\"name\":\"Frames\"}}", PROF_FRAME_THREAD);
+
+    for (size_t f = 0; f < trace.size(); ++f) {
+        const Frame& frame = trace[f];
+        fprintf(fp, ",\n{\"name\":\"Frame %u\",\"cat\":\"frame\",\"ph\":\"X\",\"pid\":0,"
+            "\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f}", frame.index, PROF_FRAME_THREAD,
+            frame.start, frame.end - frame.start);
+
+        for (size_t i = 0; i < frame.zones.size(); ++i) {
+            const Zone& z = frame.zones[i];
+            fprintf(fp, ",\n{\"name\":");
+            writeName(fp, z.name);
+            fprintf(fp, ",\"cat\":\"cpu\",\"ph\":\"X\",\"pid\":0,\"tid\":%u,"
+                "\"ts\":%.3f,\"dur\":%.3f}", z.thread, z.start, z.end - z.start);
+            if (!z.gpu) continue;
+
+            fprintf(fp, ",\n{\"name\":");
+            writeName(fp, z.name);
+            fprintf(fp, ",\"cat\":\"gpu\",\"ph\":\"X\",\"pid\":0,\"tid\":%u,"
+                "\"ts\":%.3f,\"dur\":%.3f}", PROF_GPU_THREAD, z.gpuStart, z.gpuEnd - z.gpuStart);
+        }
+    }
+    fprintf(fp, "\n]}\n");
+
+    bool ok = !ferror(fp);
+    fclose(fp);
+    if (!ok) fprintf(stderr, "Profiler: error writing trace %s\n", tracePath.c_str());
+    return ok;
+}
+
+}  // namespace prof
@@ -7,6 +7,7 @@
  */
 
 #include <base_shader.h>
+#include <base_profiler.h>
 
 namespace glf {
 
@@ -17,6 +18,7 @@ extern GLuint load(const char* file, GLenum shader_type) {
     size_t fsize;
     GLint status = 0;
     GLuint result = 0;
+    PROFILE_ZONE("Shader compile");
 
     fp = fopen(file, "rb");
     CHECK(fp, file_error);
@@ -90,6 +92,7 @@ extern GLuint linkFromShaders(const GLuint* shaders,
                        int shader_count,
                        bool delete_shaders) {
     register int i;
+    PROFILE_ZONE("Shader link");
     GLuint program = glCreateProgram();
 
     for (i = 0; i < shader_count; ++i)
@@ -1,6 +1,8 @@
 #include <base_util.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <errno.h>
+#include <string.h>
 #include <time.h>
 
 /**
@@ -39,6 +41,50 @@ glm::vec3 color_random() {
 }
 
 extern
-void show_fps(GLfloat fps) { printf("FPS: %f\n", fps); }
+void show_fps(GLfloat fps, const metrics::Summary& frameTimes) {
+    printf("FPS: %f (frame min %.2f, p99 %.2f, max %.2f ms)\n", fps,
+        frameTimes.min / 1000.0, frameTimes.p99 / 1000.0, frameTimes.max / 1000.0);
+}
+
+extern
+bool has_extension(const char* name) {
+    GLint i, count = 0;
+    glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+
+    for (i = 0; i < count; ++i) {
+        const GLubyte* ext = glGetStringi(GL_EXTENSIONS, i);
+        if (ext && !strcmp(reinterpret_cast<const char*>(ext), name))
+            return true;
+    }
+
+    return false;
+}
+
+static int64_t monotonic_ns() {
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t) ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+void FrameLimiter::wait() {
+    if (!period_ns) return;
+
+    // First frame, or more than a frame behind: start over rather than rush
+    int64_t now = monotonic_ns();
+    if (now > deadline_ns + period_ns) {
+        deadline_ns = now + period_ns;
+        return;
+    }
+
+    int64_t wake = deadline_ns - spin_ns;
+    if (wake > now) {
+        timespec ts;
+        ts.tv_sec = wake / 1000000000; ts.tv_nsec = wake % 1000000000;
+        while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) == EINTR) {}
+    }
+    while (monotonic_ns() < deadline_ns) {}
+
+    deadline_ns += period_ns;
+}
 
 }  // namespace util
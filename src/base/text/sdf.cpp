@@ -0,0 +1,91 @@
+#include <text/sdf.h>
+
+#include <math.h>
+#include <algorithm>
+
+/**
+ * Signed distance field generation (Implements sdf.h)
+ * @author: Methusael Murmu
+ */
+
+namespace text {
+
+static const GLfloat kInf = 1e20f;
+
+/* 1D squared distance transform (Felzenszwalb & Huttenlocher)
+ * f holds 0 on features and kInf elsewhere, d receives squared distances */
+static void edt1d(const GLfloat* f, GLfloat* d, GLint* v, GLfloat* z, GLint n) {
+    GLint k = 0, q;
+    GLfloat s;
+
+    v[0] = 0; z[0] = -kInf; z[1] = kInf;
+    for (q = 1; q < n; ++q) {
+        do {
+            s = ((f[q] + q * q) - (f[v[k]] + v[k] * v[k])) / (2 * q - 2 * v[k]);
+        } while (s <= z[k] && --k >= 0);
+
+        v[++k] = q;
+        z[k] = s; z[k + 1] = kInf;
+    }
+
+    for (q = 0, k = 0; q < n; ++q) {
+        while (z[k + 1] < q) ++k;
+        d[q] = (q - v[k]) * (q - v[k]) + f[v[k]];
+    }
+}
+
+// 2D squared distance transform in place, columns then rows
+static void edt2d(std::vector<GLfloat>& grid, GLint w, GLint h) {
+    GLint n = std::max(w, h), x, y;
+    std::vector<GLfloat> f(n), d(n), z(n + 1);
+    std::vector<GLint> v(n);
+
+    for (x = 0; x < w; ++x) {
+        for (y = 0; y < h; ++y) f[y] = grid[y * w + x];
+        edt1d(&f[0], &d[0], &v[0], &z[0], h);
+        for (y = 0; y < h; ++y) grid[y * w + x] = d[y];
+    }
+    for (y = 0; y < h; ++y) {
+        edt1d(&grid[y * w], &d[0], &v[0], &z[0], w);
+        std::copy(d.begin(), d.begin() + w, grid.begin() + y * w);
+    }
+}
+
+void generateSDF(const GlyphBitmap& _hires, GLuint _upscale, GLuint _spread,
+                 GLuint _offsetX, GLuint _offsetY, GlyphBitmap& _sdf) {
+    GLuint pad = _spread * _upscale;
+    _sdf.width = (_offsetX + _hires.width + _upscale - 1) / _upscale + 2 * _spread;
+    _sdf.rows = (_offsetY + _hires.rows + _upscale - 1) / _upscale + 2 * _spread;
+    _sdf.pixels.assign(_sdf.width * _sdf.rows, 0);
+
+    // High resolution grid covering the whole field
+    GLint w = _sdf.width * _upscale, h = _sdf.rows * _upscale, x, y;
+    std::vector<GLfloat> outside(w * h, kInf), inside(w * h, 0.0f);
+
+    for (y = 0; y < (GLint) _hires.rows; ++y) {
+        for (x = 0; x < (GLint) _hires.width; ++x) {
+            if (_hires.pixels[y * _hires.width + x] < 128) continue;
+
+            GLint idx = (y + pad + _offsetY) * w + x + pad + _offsetX;
+            outside[idx] = 0.0f;
+            inside[idx] = kInf;
+        }
+    }
+    edt2d(outside, w, h);
+    edt2d(inside, w, h);
+
+    // Sample block centers, distances in target texels
+    GLfloat range = 2.0f * _spread * _upscale;
+    for (y = 0; y < (GLint) _sdf.rows; ++y) {
+        for (x = 0; x < (GLint) _sdf.width; ++x) {
+            GLint idx = (y * _upscale + _upscale / 2) * w + x * _upscale + _upscale / 2;
+            GLfloat dist = sqrtf(outside[idx]) - sqrtf(inside[idx]);
+            GLfloat val = 0.5f - dist / range;
+
+            _sdf.pixels[y * _sdf.width + x] =
+                static_cast<GLubyte>(std::min(std::max(val, 0.0f), 1.0f) * 255.0f + 0.5f);
+        }
+    }
+}
+
+}  // namespace text
@@ -1,5 +1,12 @@
 #include <text/text.h>
+#include <base_util.h>
+#include <base_jobs.h>
+#include <base_profiler.h>
+#include <base_gpumem.h>
 
+#include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
 #include <algorithm>
 
 /**
@@ -9,74 +16,131 @@
 
 namespace text {
 
-/* A basic font set loader (maximum number of characters defined by MAX_CHAR_SZ)
- * Creates an individual struct Char for each character loaded, with separate
- * texture for each.
- * TODO: Create a texture atlas instead (use distance fields perhaps?) */
+/* Layout of a distance field glyph cache file, followed by its glyph records
+ * Size and modification time of the font file tell a replaced font apart */
+struct SDFCacheHeader {
+    char magic[4];
+    GLuint version, height, spread, upscale, count;
+    int64_t fontBytes, fontTime;
+};
+
+// Glyph record, followed by size.x * size.y distance texels
+struct SDFCacheGlyph {
+    GLuint code;
+    GLint size[2], bearing[2];
+    int64_t advance;
+};
+
+static const char kSDFMagic[4] = { 'G', 'S', 'D', 'F' };
+static const GLuint kNoCell = ~0u;
+
+/* A basic font loader
+ * Only opens the face and creates an empty atlas, glyphs are rasterized on use */
 GLint FontData::loadFonts(const GLchar* font_file, GLint height) {
     if (isValid()) return 1;
 
-    FT_Library ft;
+    GLint err = openFace(font_file, height);
+    if (err) return err;
+
+    // Cells fit any glyph of the face
+    GLuint w = FT_MulFix(face->bbox.xMax - face->bbox.xMin, face->size->metrics.x_scale) >> 6;
+    GLuint h = FT_MulFix(face->bbox.yMax - face->bbox.yMin, face->size->metrics.y_scale) >> 6;
+    cellSize = std::max(w, h) + 1 + GLYPH_PADDING;
+    maxHeight = (face->size->metrics.ascender - face->size->metrics.descender) >> 6;
+
+    this->height = height;
+    sdf = false;
+    createObjects();
+    return 0;
+}
+
+/* Distance field font loader
+ * Glyph outlines are rasterized SDF_UPSCALE times larger and turned into
+ * distance fields on use. Fields are kept in a disk cache next to the font file */
+GLint FontData::loadSDF(const GLchar* font_file, GLint height) {
+    if (isValid()) return 1;
+
+    GLint err = openFace(font_file, height * SDF_UPSCALE);
+    if (err) return err;
+
+    GLuint w = FT_MulFix(face->bbox.xMax - face->bbox.xMin, face->size->metrics.x_scale) >> 6;
+    GLuint h = FT_MulFix(face->bbox.yMax - face->bbox.yMin, face->size->metrics.y_scale) >> 6;
+    cellSize = std::max(w, h) / SDF_UPSCALE + 2 + 2 * SDF_SPREAD + GLYPH_PADDING;
+    maxHeight = ((face->size->metrics.ascender - face->size->metrics.descender) >> 6) / SDF_UPSCALE;
+
+    this->height = height;
+    sdf = true;
+    cachePath = std::string(font_file) + "." + util::itos(height) + ".sdf";
+    struct stat info;
+    if (stat(font_file, &info) == 0) {
+        fontBytes = info.st_size;
+        fontTime = info.st_mtime;
+    } else {
+        fontBytes = fontTime = 0;
+    }
+    readCache();
+    createObjects();
+    return 0;
+}
+
+GLint FontData::openFace(const GLchar* font_file, GLuint pixelHeight) {
     if (FT_Init_FreeType(&ft)) {
         fprintf(stdout, "Text: Failed to init FreetType\n");
         return 2;
     }
 
-    FT_Face face;
     if (FT_New_Face(ft, font_file, 0, &face)) {
         fprintf(stdout, "Text: Failed to create font face (%s)\n", font_file);
+        FT_Done_FreeType(ft);
         return 3;
     }
 
-    FT_Set_Pixel_Sizes(face, 0, height);
-    FT_GlyphSlot slot = face->glyph;
+    FT_Set_Pixel_Sizes(face, 0, pixelHeight);
+    return 0;
+}
 
-    maxHeight = 0;
-    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+// Creates the (cleared) atlas and vertex storage for glyph batches
+void FontData::createObjects() {
+    GPU_OWNER("Font atlas");
+    cellSize = std::min(cellSize, (GLuint) GLYPH_ATLAS_SIZE / 4);
+    cellsPerRow = GLYPH_ATLAS_SIZE / cellSize;
+    batchStamp = 1;
+    evictions = 0;
+    cacheDirty = false;
 
-    for (GLubyte i = 0; i < MAX_CHAR_SZ; ++i) {
-        if (FT_Load_Char(face, i, FT_LOAD_RENDER)) {
-            fprintf(stdout, "Text: Failed to load glyph: %c\n", i);
-            memset(&charMap[i], 0, sizeof(Char));
-            continue;
-        }
+    freeCells.clear();
+    for (GLuint c = cellCount(); c-- > 0;) freeCells.push_back(c);
 
-        // Generate and load textures
-        GLuint texId;
-        glGenTextures(1, &texId);
-        glBindTexture(GL_TEXTURE_2D, texId);
-        glTexImage2D(GL_TEXTURE_2D, 0, GL_RED,
-            slot->bitmap.width, slot->bitmap.rows, 0,
-            GL_RED, GL_UNSIGNED_BYTE, slot->bitmap.buffer);
-
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-        glBindTexture(GL_TEXTURE_2D, 0);
-
-        Char st_char = {
-            texId,
-            glm::ivec2(slot->bitmap.width, slot->bitmap.rows),
-            glm::ivec2(slot->bitmap_left, slot->bitmap_top),
-            slot->advance.x
-        };
+    std::vector<GLubyte> clear(GLYPH_ATLAS_SIZE * GLYPH_ATLAS_SIZE, 0);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    glGenTextures(1, &texId);
+    glBindTexture(GL_TEXTURE_2D, texId);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RED, GLYPH_ATLAS_SIZE, GLYPH_ATLAS_SIZE,
+        0, GL_RED, GL_UNSIGNED_BYTE, &clear[0]);
 
-        charMap[i] = st_char;
-        maxHeight = std::max(maxHeight, slot->bitmap.rows);
-    }
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
 
-    glPixelStorei(GL_UNPACK_ALIGNMENT, 0);
-    FT_Done_Face(face);
-    FT_Done_FreeType(ft);
+    // Full coverage (or deep inside, for distance fields) across the whole
+    // cell, so sampling its center is solid under linear filtering
+    GLuint cell = freeCells.back();
+    freeCells.pop_back();
+    GLuint x = (cell % cellsPerRow) * cellSize, y = (cell / cellsPerRow) * cellSize;
+    std::vector<GLubyte> fill(cellSize * cellSize, 0xff);
+    glTexSubImage2D(GL_TEXTURE_2D, 0, x, y, cellSize, cellSize, GL_RED, GL_UNSIGNED_BYTE, &fill[0]);
+    solid = (glm::vec2(x, y) + 0.5f * cellSize) / (GLfloat) GLYPH_ATLAS_SIZE;
+
+    glBindTexture(GL_TEXTURE_2D, 0);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
 
-    // Generate the quads
+    // Sized on first flush
     glGenVertexArrays(1, &vAO);
     glGenBuffers(1, &vBO);
     glBindVertexArray(vAO);
 
     glBindBuffer(GL_ARRAY_BUFFER, vBO);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(GLfloat) * 16, NULL, GL_DYNAMIC_DRAW);
     glVertexAttribPointer(0, 4, GL_FLOAT, GL_FALSE, 4 * sizeof(GLfloat), BUFFER_OFFSET(0));
     glEnableVertexAttribArray(0);
     glBindBuffer(GL_ARRAY_BUFFER, 0);
@@ -85,58 +149,408 @@ GLint FontData::loadFonts(const GLchar* font_file, GLint height) {
     valid = true;
 }
 
+void FontData::require(const std::vector<GLuint>& codes) {
+    if (!isValid()) return;
+
+    // Resident glyphs join the batch first, so inserting the misses can't evict them
+    std::vector<GLuint> misses;
+    for (size_t i = 0; i < codes.size(); ++i) {
+        std::unordered_map<GLuint, Entry>::iterator itr = glyphs.find(codes[i]);
+        if (itr != glyphs.end()) touch(itr->second);
+        else misses.push_back(codes[i]);
+    }
+    if (misses.empty()) return;
+
+    std::sort(misses.begin(), misses.end());
+    misses.erase(std::unique(misses.begin(), misses.end()), misses.end());
+
+    // FreeType faces aren't thread safe, so rasterization stays serial
+    std::vector<GLuint> pending;
+    std::vector<Raster> rasters(misses.size());
+    std::vector<GlyphBitmap> hires(misses.size());
+    std::vector<glm::uvec2> offsets(misses.size());
+
+    for (size_t i = 0; i < misses.size(); ++i) {
+        std::unordered_map<GLuint, Raster>::const_iterator cached = sdfCache.find(misses[i]);
+        if (sdf && cached != sdfCache.end()) {
+            insert(misses[i], cached->second);
+        } else if (rasterize(misses[i], rasters[i], hires[i], offsets[i])) {
+            if (sdf) pending.push_back(i);
+            else insert(misses[i], rasters[i]);
+        }
+    }
+    if (pending.empty()) return;
+
+    // Distance transforms are independent per glyph
+    jobs::JobSystem::instance().parallelFor(0, pending.size(),
+        pending.size() < SDF_PARALLEL_MIN ? pending.size() : 1, [&](GLuint _begin, GLuint _end) {
+            for (GLuint p = _begin; p < _end; ++p) {
+                GLuint i = pending[p];
+                if (hires[i].pixels.empty()) continue;
+                generateSDF(hires[i], SDF_UPSCALE, SDF_SPREAD,
+                    offsets[i].x, offsets[i].y, rasters[i].bitmap);
+            }
+        });
+
+    for (size_t p = 0; p < pending.size(); ++p) {
+        Raster& raster = rasters[pending[p]];
+        raster.ch.size = glm::ivec2(raster.bitmap.width, raster.bitmap.rows);
+
+        sdfCache[misses[pending[p]]] = raster;
+        cacheDirty = true;
+        insert(misses[pending[p]], raster);
+    }
+}
+
+const Char* FontData::glyph(GLuint code) {
+    if (!glyphs.count(code)) require(std::vector<GLuint>(1, code));
+    return resident(code);
+}
+
+const Char* FontData::resident(GLuint code) {
+    std::unordered_map<GLuint, Entry>::iterator itr = glyphs.find(code);
+    if (itr == glyphs.end()) return NULL;
+
+    touch(itr->second);
+    return &itr->second.ch;
+}
+
+GLfloat FontData::kerning(GLuint left, GLuint right) const {
+    if (!isValid() || !FT_HAS_KERNING(face)) return 0.0f;
+
+    FT_Vector delta;
+    if (FT_Get_Kerning(face, FT_Get_Char_Index(face, left),
+            FT_Get_Char_Index(face, right), FT_KERNING_DEFAULT, &delta))
+        return 0.0f;
+
+    return delta.x / 64.0f / (sdf ? SDF_UPSCALE : 1);
+}
+
+void FontData::touch(Entry& entry) {
+    if (entry.cell == kNoCell) return;
+
+    lruList.splice(lruList.begin(), lruList, entry.lru);
+    entry.stamp = batchStamp;
+}
+
+/* Renders a glyph with FreeType
+ * Coverage glyphs are complete in _raster, distance field glyphs leave their
+ * high resolution image and its texel grid offset in _hires and _offset */
+bool FontData::rasterize(GLuint code, Raster& raster,
+                         GlyphBitmap& hires, glm::uvec2& offset) {
+    if (FT_Load_Char(face, code, FT_LOAD_RENDER)) {
+        fprintf(stdout, "Text: Failed to load glyph: U+%04X\n", code);
+        return false;
+    }
+
+    FT_GlyphSlot slot = face->glyph;
+    const FT_Bitmap& bmp = slot->bitmap;
+    GlyphBitmap& image = sdf ? hires : raster.bitmap;
+
+    image.width = bmp.width;
+    image.rows = bmp.rows;
+    image.pixels.resize(bmp.width * bmp.rows);
+    for (GLuint row = 0; row < bmp.rows; ++row) {
+        memcpy(&image.pixels[row * bmp.width],
+            bmp.buffer + row * bmp.pitch, bmp.width);
+    }
+
+    raster.ch = Char();
+    if (!sdf) {
+        raster.ch.size = glm::ivec2(bmp.width, bmp.rows);
+        raster.ch.bearing = glm::ivec2(slot->bitmap_left, slot->bitmap_top);
+        raster.ch.advance = slot->advance.x;
+        return true;
+    }
+
+    // Align the outline to the target texel grid, then extend by the spread
+    GLint left = (GLint) floorf((GLfloat) slot->bitmap_left / SDF_UPSCALE);
+    GLint top = (GLint) ceilf((GLfloat) slot->bitmap_top / SDF_UPSCALE);
+    offset = glm::uvec2(slot->bitmap_left - left * SDF_UPSCALE,
+        top * SDF_UPSCALE - slot->bitmap_top);
+
+    raster.ch.bearing = glm::ivec2(left - SDF_SPREAD, top + SDF_SPREAD);
+    raster.ch.advance = slot->advance.x / SDF_UPSCALE;
+    return true;
+}
+
+// Uploads a glyph into a free (or the least recently used) atlas cell
+bool FontData::insert(GLuint code, const Raster& raster) {
+    Entry entry;
+    entry.ch = raster.ch;
+    entry.cell = kNoCell;
+    entry.stamp = batchStamp;
+
+    const GlyphBitmap& bmp = raster.bitmap;
+    if (bmp.width + GLYPH_PADDING > cellSize || bmp.rows + GLYPH_PADDING > cellSize) {
+        fprintf(stdout, "Text: Glyph too large for atlas cell: U+%04X\n", code);
+        entry.ch.size = glm::ivec2(0);
+    }
+
+    // Blank glyphs only need their metrics
+    if (!entry.ch.size.x || !entry.ch.size.y) {
+        glyphs[code] = entry;
+        return true;
+    }
+
+    if (freeCells.empty()) {
+        GLuint victim = lruList.back();
+        Entry& old = glyphs[victim];
+        if (old.stamp == batchStamp) {
+            fprintf(stdout, "Text: Glyph atlas full in one batch, U+%04X dropped\n", code);
+            return false;
+        }
+
+        freeCells.push_back(old.cell);
+        lruList.pop_back();
+        glyphs.erase(victim);
+        evictions++;
+    }
+
+    entry.cell = freeCells.back();
+    freeCells.pop_back();
+
+    GLuint x = (entry.cell % cellsPerRow) * cellSize;
+    GLuint y = (entry.cell / cellsPerRow) * cellSize;
+    GLfloat texel = 1.0f / GLYPH_ATLAS_SIZE;
+    entry.ch.uvMin = glm::vec2(x, y) * texel;
+    entry.ch.uvMax = glm::vec2(x + bmp.width, y + bmp.rows) * texel;
+
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    glBindTexture(GL_TEXTURE_2D, texId);
+    glTexSubImage2D(GL_TEXTURE_2D, 0, x, y, bmp.width, bmp.rows,
+        GL_RED, GL_UNSIGNED_BYTE, &bmp.pixels[0]);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+
+    lruList.push_front(code);
+    entry.lru = lruList.begin();
+    glyphs[code] = entry;
+    return true;
+}
+
+// Loads cached distance field glyphs (no GL work), ignored if made with other settings
+void FontData::readCache() {
+    FILE* file = fopen(cachePath.c_str(), "rb");
+    if (!file) return;
+
+    SDFCacheHeader hdr;
+    bool ok = fread(&hdr, sizeof(hdr), 1, file) == 1 &&
+        !memcmp(hdr.magic, kSDFMagic, sizeof(kSDFMagic)) &&
+        hdr.version == SDF_CACHE_VERSION && hdr.height == height &&
+        hdr.spread == SDF_SPREAD && hdr.upscale == SDF_UPSCALE &&
+        hdr.fontBytes == fontBytes && hdr.fontTime == fontTime;
+
+    // No glyph is larger than an atlas cell, a record claiming so is corrupt
+    GLint limit = std::min(cellSize, (GLuint) GLYPH_ATLAS_SIZE / 4);
+    bool corrupt = false;
+    for (GLuint i = 0; ok && i < hdr.count; ++i) {
+        SDFCacheGlyph rec;
+        if (fread(&rec, sizeof(rec), 1, file) != 1 || rec.size[0] < 0 || rec.size[1] < 0 ||
+                rec.size[0] > limit || rec.size[1] > limit) {
+            corrupt = true;
+            break;
+        }
+
+        Raster raster;
+        raster.ch = Char();
+        raster.ch.size = glm::ivec2(rec.size[0], rec.size[1]);
+        raster.ch.bearing = glm::ivec2(rec.bearing[0], rec.bearing[1]);
+        raster.ch.advance = rec.advance;
+        raster.bitmap.width = rec.size[0];
+        raster.bitmap.rows = rec.size[1];
+        raster.bitmap.pixels.resize(rec.size[0] * rec.size[1]);
+
+        if (!raster.bitmap.pixels.empty() && fread(&raster.bitmap.pixels[0], 1,
+                raster.bitmap.pixels.size(), file) != raster.bitmap.pixels.size()) {
+            corrupt = true;
+            break;
+        }
+        sdfCache[rec.code] = raster;
+    }
+    fclose(file);
+
+    if (corrupt) {
+        fprintf(stdout, "Text: Discarding corrupt font cache (%s)\n", cachePath.c_str());
+        sdfCache.clear();
+    }
+}
+
+void FontData::writeCache() const {
+    FILE* file = fopen(cachePath.c_str(), "wb");
+    if (!file) {
+        fprintf(stdout, "Text: Failed to write font cache (%s)\n", cachePath.c_str());
+        return;
+    }
+
+    SDFCacheHeader hdr = {
+        { kSDFMagic[0], kSDFMagic[1], kSDFMagic[2], kSDFMagic[3] },
+        SDF_CACHE_VERSION, height, SDF_SPREAD, SDF_UPSCALE,
+        (GLuint) sdfCache.size(), fontBytes, fontTime
+    };
+    fwrite(&hdr, sizeof(hdr), 1, file);
+
+    std::unordered_map<GLuint, Raster>::const_iterator itr;
+    for (itr = sdfCache.begin(); itr != sdfCache.end(); ++itr) {
+        const Char& ch = itr->second.ch;
+        SDFCacheGlyph rec = {
+            itr->first, { ch.size.x, ch.size.y },
+            { ch.bearing.x, ch.bearing.y }, ch.advance
+        };
+
+        fwrite(&rec, sizeof(rec), 1, file);
+        if (!itr->second.bitmap.pixels.empty()) {
+            fwrite(&itr->second.bitmap.pixels[0], 1,
+                itr->second.bitmap.pixels.size(), file);
+        }
+    }
+    fclose(file);
+}
+
 void FontData::clean() {
     if (!isValid()) return;
 
-    for (GLint i = 0; i < MAX_CHAR_SZ; ++i)
-        glDeleteTextures(1, &charMap[i].texId);
+    if (sdf && cacheDirty) writeCache();
+
+    glDeleteTextures(1, &texId);
     glDeleteBuffers(1, &vBO);
     glDeleteVertexArrays(1, &vAO);
 
+    FT_Done_Face(face);
+    FT_Done_FreeType(ft);
+
+    glyphs.clear();
+    sdfCache.clear();
+    lruList.clear();
+    freeCells.clear();
+
     valid = false;
 }
 
-/* Renders a given string on a quad
- * The text rendering shader must be provided by the calling method
- * Not recommended for production purposes (ad-hoc inefficient implementation) */
-void FontRenderer::renderText(const glf::Shader* _shader, const std::string& str,
+void FontRenderer::queueText(const std::string& str,
                 GLfloat x, GLfloat y, GLfloat scale) {
     if (!initCalled || !font->isValid()) return;
+    layout(str, x, y, scale, batch);
+}
+
+void FontRenderer::queueQuad(GLfloat x, GLfloat y, GLfloat w, GLfloat h) {
+    if (!initCalled || !font->isValid()) return;
+
+    const glm::vec2& uv = font->solidUV();
+    const GLfloat quad[6][4] = {
+        { x,     y + h, uv.x, uv.y }, { x,     y, uv.x, uv.y }, { x + w, y + h, uv.x, uv.y },
+        { x + w, y + h, uv.x, uv.y }, { x,     y, uv.x, uv.y }, { x + w, y,     uv.x, uv.y }
+    };
+    batch.insert(batch.end(), &quad[0][0], &quad[0][0] + 24);
+}
+
+/* Appends the glyph quads of a UTF-8 string
+ * Two triangles per glyph, texture coords inverted on Y axis */
+void FontRenderer::layout(const std::string& str, GLfloat x, GLfloat y,
+                GLfloat scale, std::vector<GLfloat>& _verts) {
+    GLfloat xpos, ypos, w, h;
+    size_t i;
+
+    codes.clear();
+    for (i = 0; i < str.size();) codes.push_back(decodeUTF8(str, i));
+    // Misses are rasterized once here; any the atlas couldn't take are skipped
+    font->require(codes);
+
+    _verts.reserve(_verts.size() + codes.size() * 24);
+    for (i = 0; i < codes.size(); ++i) {
+        const Char* st_char = font->resident(codes[i]);
+        if (!st_char) continue;
+        if (i) x += font->kerning(codes[i - 1], codes[i]) * scale;
+
+        // Infer position from metrics
+        w = st_char->size.x * scale;
+        h = st_char->size.y * scale;
+        xpos = x + st_char->bearing.x * scale;
+        ypos = y - (st_char->size.y - st_char->bearing.y) * scale;
+        x += (st_char->advance >> 6) * scale;
+        if (!st_char->size.x || !st_char->size.y) continue;
+
+        const GLfloat quad[6][4] = {
+            { xpos,     ypos + h, st_char->uvMin.x, st_char->uvMin.y },
+            { xpos,     ypos,     st_char->uvMin.x, st_char->uvMax.y },
+            { xpos + w, ypos + h, st_char->uvMax.x, st_char->uvMin.y },
+            { xpos + w, ypos + h, st_char->uvMax.x, st_char->uvMin.y },
+            { xpos,     ypos,     st_char->uvMin.x, st_char->uvMax.y },
+            { xpos + w, ypos,     st_char->uvMax.x, st_char->uvMax.y }
+        };
+        _verts.insert(_verts.end(), &quad[0][0], &quad[0][0] + 24);
+    }
+}
+
+/* Uploads the batch with one (orphaning) buffer store and draws it at once
+ * The text rendering shader must be provided by the calling method */
+void FontRenderer::flush(const glf::Shader* _shader) {
+    if (!initCalled || !font->isValid() || batch.empty()) return;
+    PROFILE_GPU_ZONE("Text");
 
     _shader->use();
     glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, font->texId);
     glBindVertexArray(font->vAO);
 
-    Char st_char;
-    std::string::const_iterator itr;
-    GLfloat xpos, ypos, w, h;
+    glBindBuffer(GL_ARRAY_BUFFER, font->vBO);
+    glBufferData(GL_ARRAY_BUFFER, batch.size() * sizeof(GLfloat),
+        &batch[0], GL_STREAM_DRAW);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
 
-    for (itr = str.begin(); itr != str.end(); ++itr) {
-        st_char = font->charMap[*itr];
+    // Render
+    glDrawArrays(GL_TRIANGLES, 0, batch.size() / 4);
+    glBindVertexArray(0);
 
-        // Infer position from metrics
-        w = st_char.size.x * scale;
-        h = st_char.size.y * scale;
-        xpos = x + st_char.bearing.x * scale;
-        ypos = y - (st_char.size.y - st_char.bearing.y) * scale;
-
-        // Update quad vertices
-        qVert[0][0] = xpos;     qVert[0][1] = ypos + h;
-        qVert[1][0] = xpos;     qVert[1][1] = ypos;
-        qVert[2][0] = xpos + w; qVert[2][1] = ypos + h;
-        qVert[3][0] = xpos + w; qVert[3][1] = ypos;
-
-        glBindTexture(GL_TEXTURE_2D, st_char.texId);
-        glBindBuffer(GL_ARRAY_BUFFER, font->vBO);
-        glBufferSubData(GL_ARRAY_BUFFER, 0, sizeof(qVert), qVert);
+    batch.clear();
+    font->endBatch();
+}
+
+// Lays the mesh out into its own static buffer when stale, then draws it
+void FontRenderer::renderText(const glf::Shader* _shader, TextMesh& mesh) {
+    if (!initCalled || !font->isValid()) return;
+    PROFILE_GPU_ZONE("Text");
+
+    if (mesh.dirty || mesh.font != font || mesh.evictions != font->evictionCount()) {
+        std::vector<GLfloat> verts;
+        for (size_t i = 0; i < mesh.lines.size(); ++i) {
+            const TextLine& line = mesh.lines[i];
+            layout(line.str, line.x, line.y, line.scale, verts);
+        }
+
+        if (!mesh.vAO) {
+            GPU_OWNER("Text");
+            glGenVertexArrays(1, &mesh.vAO);
+            glGenBuffers(1, &mesh.vBO);
+            glBindVertexArray(mesh.vAO);
+
+            glBindBuffer(GL_ARRAY_BUFFER, mesh.vBO);
+            glVertexAttribPointer(0, 4, GL_FLOAT, GL_FALSE, 4 * sizeof(GLfloat),
+                BUFFER_OFFSET(0));
+            glEnableVertexAttribArray(0);
+            glBindVertexArray(0);
+        }
+
+        glBindBuffer(GL_ARRAY_BUFFER, mesh.vBO);
+        glBufferData(GL_ARRAY_BUFFER, verts.size() * sizeof(GLfloat),
+            verts.empty() ? NULL : &verts[0], GL_STATIC_DRAW);
         glBindBuffer(GL_ARRAY_BUFFER, 0);
 
-        // Render
-        glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
-        x += (st_char.advance >> 6) * scale;
+        mesh.vertCount = verts.size() / 4;
+        mesh.font = font;
+        mesh.evictions = font->evictionCount();
+        mesh.dirty = false;
     }
+    if (!mesh.vertCount) return;
 
+    _shader->use();
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, font->texId);
+    glBindVertexArray(mesh.vAO);
+    glDrawArrays(GL_TRIANGLES, 0, mesh.vertCount);
     glBindVertexArray(0);
+
+    font->endBatch();
 }
 
 const GLchar* const FontRenderer::kTextUniform = "text";
@@ -0,0 +1,351 @@
+#include <base_app.h>
+#include <base_util.h>
+#include <base_shader.h>
+#include <3d/camera.h>
+#include <3d/model.h>
+#include <3d/skin.h>
+#include <animator/anim.h>
+#include <animator/clip_compress.h>
+
+#include <external/glm/vec3.hpp>
+#include <external/glm/mat4x4.hpp>
+#include <external/glm/gtc/type_ptr.hpp>
+#include <external/glm/gtc/matrix_transform.hpp>
+
+#include <vector>
+
+/**
+ * Crowd of skinned characters: posed on a simulation thread one frame ahead of
+ * rendering, skinned in the vertex shader
+ * @author: Methusael Murmu
+ */
+
+// Any rigged and animated model Assimp reads will do
+#define CROWD_MODEL "media/data/models/crowd/crowd.dae"
+#define CROWD_GRID 20           // Characters per grid row
+#define CROWD_GRID_MAX 64
+#define CROWD_SPACING 2.0f
+#define CROWD_REPORT_INTERVAL 2.0
+#define PALETTE_UNIT 3
+
+class Crowd: public glf::BaseApp {
+ public:
+    Crowd(): serial(1) {
+        util::set_color4f1(bg_col, 0.05f, 0.05f, 0.06f);
+        first_call = true;
+        parallel = true;
+        compressed = true;
+        morphRebuilds = 0;
+        morphsPaused = false;
+        lastReport = poseTime = 0.0;
+        poseFrames = 0;
+    }
+
+    void setup() {
+        setTitle("Skinned Crowd");
+        info.width = 1366; info.height = 768;
+        info.flags.fullscreen = 1;
+        info.flags.cursor = 0;
+        info.samples = 4;
+
+        enableFPSDisplay(true);
+        enableStatsDisplay(true);
+        enablePipelining(true);
+        exportMetrics("crowd_metrics.jsonl");
+        poseMetric = &metrics::Registry::instance().histogram("crowd.pose_us");
+    }
+
+    void startup() {
+        scene_shader.load("media/crowd/shaders/crowd.vert", glf::Shader::VERTEX);
+        scene_shader.load("media/crowd/shaders/crowd.frag", glf::Shader::FRAGMENT);
+        scene_shader.compile(); scene_shader.use();
+
+        morph_shader.load("media/crowd/shaders/morph.vert", glf::Shader::VERTEX);
+        morph_shader.load("media/crowd/shaders/morph.frag", glf::Shader::FRAGMENT);
+        morph_shader.compile();
+        scene_shader.use();
+
+        text_shader.load("media/crowd/shaders/text.vert", glf::Shader::VERTEX);
+        text_shader.load("media/crowd/shaders/text.frag", glf::Shader::FRAGMENT);
+        text_shader.compile();
+        setBaseTextShader(&text_shader);
+
+        glEnable(GL_DEPTH_TEST);
+        glEnable(GL_MULTISAMPLE);
+
+#define uni_loc(_shader, _name) \
+    glGetUniformLocation(_shader.getProgram(), _name)
+
+        loc_model       = uni_loc(scene_shader, "model");
+        loc_proj_view   = uni_loc(scene_shader, "proj_view");
+        loc_joint_count = uni_loc(scene_shader, "joint_count");
+        loc_grid_width  = uni_loc(scene_shader, "grid_width");
+        glUniform1i(uni_loc(scene_shader, "palette"), PALETTE_UNIT);
+        glUniform1i(uni_loc(scene_shader, "morph_positions"), MORPH_TEX_UNIT);
+        glUniform1i(uni_loc(scene_shader, "morph_normals"), MORPH_TEX_UNIT + 1);
+        glUniform1f(uni_loc(scene_shader, "grid_spacing"), CROWD_SPACING);
+        glUniform3f(uni_loc(scene_shader, "ambience"), 0.15f, 0.15f, 0.15f);
+        glUniform3fv(uni_loc(scene_shader, "light_dir"), 1,
+            glm::value_ptr(glm::normalize(glm::vec3(-0.4f, -1.0f, -0.3f))));
+#undef uni_loc
+
+        shader_tex_info.loadTextureLocations(scene_shader, glf::TEX_DIFFUSE, 1);
+
+        proj_mat = glm::perspective(cam.fov(),
+            (GLfloat) getWidth() / getHeight(), 0.1f, 500.0f);
+        cam.position(glm::vec3(0.0f, 8.0f, CROWD_GRID * CROWD_SPACING));
+        cam.front(glm::vec3(0.0f, -0.3f, -1.0f));
+        cam.speed(16.0f);
+
+        character.load(CROWD_MODEL, true);
+        if (!character.skinned()) {
+            // Static models stand in with a single identity joint
+            fprintf(stdout, "%s has no skeleton, drawing it unanimated\n", CROWD_MODEL);
+            glVertexAttribI4ui(glf::ATTR_JOINTS_ID, 0, 0, 0, 0);
+            glVertexAttrib4f(glf::ATTR_WEIGHTS_ID, 1.0f, 0.0f, 0.0f, 0.0f);
+        }
+        jointCount = std::max(1u, character.getSkeleton().size());
+        compressClips();
+        setupMorphs();
+        glUniform1i(loc_joint_count, jointCount);
+
+        setCrowd(CROWD_GRID);
+        workers = jobs::JobSystem::instance().threadCount();
+        drawTimer.init();
+
+        fprintf(stdout, "Crowd: [UP/DOWN] resize grid, [P] toggle parallel posing (%u threads), "
+            "[C] toggle compressed clips, [M] pause morphs\n", workers);
+    }
+
+    void shutdown() {
+        palette.dispose();
+        drawTimer.dispose();
+    }
+
+    // Camera, poses and morph weights of the next frame, off the GL thread
+    void simulate(double elapsedTime, double duration) {
+        update_state(duration);
+        CrowdFrame& frame = frames.back();
+
+        double start = glfwGetTime();
+        if (character.skinned()) {
+            jobs::JobSystem& threads = parallel ? jobs::JobSystem::instance() : serial;
+            if (compressed && !packedJobs.empty()) {
+                for (GLuint i = 0; i < packedJobs.size(); ++i) {
+                    packedJobs[i].time = elapsedTime + i * 0.37f;
+                    packedJobs[i].palette = &frame.palettes[i * jointCount];
+                }
+                anim::runPoseJobs(packedJobs, threads);
+            } else {
+                for (GLuint i = 0; i < jobs.size(); ++i) {
+                    jobs[i].time = elapsedTime + i * 0.37f;
+                    jobs[i].palette = &frame.palettes[i * jointCount];
+                }
+                anim::runPoseJobs(jobs, threads);
+            }
+        }
+        frame.poseTime = glfwGetTime() - start;
+        poseMetric->record((GLuint64) (1.0e6 * frame.poseTime));
+
+        morphAnimators.animate(duration);
+        for (GLuint i = 0; i < morphs.size(); ++i)
+            frame.morphWeights[i] = morphs[i].value();
+        frame.view = cam.viewMat();
+    }
+
+    void syncFrame() { frames.swap(); }
+
+#define _vp(f) glm::value_ptr(f)
+
+    void render(double elapsedTime, double duration) {
+        const CrowdFrame& frame = frames.front();
+        glClearBufferfv(GL_COLOR, 0, bg_col);
+        glClear(GL_DEPTH_BUFFER_BIT);
+        poseTime += frame.poseTime;
+        poseFrames++;
+
+        // Weights that didn't move since last frame keep their blended deltas
+        for (GLuint i = 0; i < frame.morphWeights.size(); ++i)
+            character.morphWeight(i, frame.morphWeights[i]);
+        character.updateMorphs(morph_shader);
+
+        // Ship all palettes at once
+        drawTimer.begin();
+        palette.upload(&frame.palettes[0], frame.palettes.size());
+        palette.bind(PALETTE_UNIT);
+
+        scene_shader.use();
+        glUniformMatrix4fv(loc_proj_view, 1, GL_FALSE, _vp(proj_mat * frame.view));
+        glUniformMatrix4fv(loc_model, 1, GL_FALSE, _vp(character.modelMat()));
+        character.render(&shader_tex_info);
+        drawTimer.end();
+
+        if (elapsedTime - lastReport > CROWD_REPORT_INTERVAL) {
+            fprintf(stdout, "%u characters x %u joints: pose %.3f ms (%s, %s clip), draw %.3f ms\n",
+                grid * grid, jointCount, 1000.0 * poseTime / poseFrames,
+                parallel ? "parallel" : "serial",
+                compressed && !packedJobs.empty() ? "compressed" : "raw", drawTimer.average());
+            gpumem::Usage gpu = gpumem::total();
+            fprintf(stdout, "GPU memory: %.1f MB in %llu objects, peak %.1f MB\n",
+                gpu.bytes / (1024.0 * 1024.0), (unsigned long long) gpu.objects,
+                gpumem::peakBytes() / (1024.0 * 1024.0));
+            if (!morphs.empty()) {
+                fprintf(stdout, "%u morph channels: %u mesh rebuilds\n", character.morphChannels(),
+                    character.morphRebuilds() - morphRebuilds);
+                morphRebuilds = character.morphRebuilds();
+            }
+            drawTimer.reset();
+            poseTime = 0.0; poseFrames = 0;
+            lastReport = elapsedTime;
+        }
+    }
+#undef _vp
+
+    void update_state(double duration) {
+        if (testKeyState(GLFW_KEY_W, GLFW_PRESS))
+            cam.processMove(glf3d::CAM_MOVE_FORWARD, duration);
+        if (testKeyState(GLFW_KEY_S, GLFW_PRESS))
+            cam.processMove(glf3d::CAM_MOVE_BACKWARD, duration);
+        if (testKeyState(GLFW_KEY_A, GLFW_PRESS))
+            cam.processMove(glf3d::CAM_STRAFE_LEFT, duration);
+        if (testKeyState(GLFW_KEY_D, GLFW_PRESS))
+            cam.processMove(glf3d::CAM_STRAFE_RIGHT, duration);
+    }
+
+    void onKeyPress(int key, int mods) {
+        glf::BaseApp::onKeyPress(key, mods);
+
+        switch (key) {
+            case GLFW_KEY_UP: setCrowd(std::min(grid + 4, (GLuint) CROWD_GRID_MAX)); break;
+            case GLFW_KEY_DOWN: setCrowd(std::max(grid, 5u) - 4); break;
+            case GLFW_KEY_P: parallel = !parallel; break;
+            case GLFW_KEY_C: compressed = !compressed; break;
+            case GLFW_KEY_M:
+                morphsPaused = !morphsPaused;
+                if (morphsPaused) morphAnimators.pause();
+                else morphAnimators.play();
+                break;
+        }
+    }
+
+    void onMouseMove(float x, float y) {
+        if (first_call) {
+            mlast_x = x; mlast_y = y;
+            first_call = false;
+        }
+
+        cam.processLook(x - mlast_x, mlast_y - y);
+        mlast_x = x; mlast_y = y;
+    }
+
+ private:
+    // OpenGL data
+    GLfloat bg_col[4];
+    glf::Shader scene_shader, text_shader, morph_shader;
+    glf::ShaderTextureInfo shader_tex_info;
+    glf3d::PaletteBuffer palette;
+    util::GPUTimer drawTimer;
+
+    GLint loc_model, loc_proj_view, loc_joint_count, loc_grid_width;
+    glm::mat4 proj_mat;
+
+    glf3d::FreeCamera cam;
+    glf3d::Model character;
+
+    // What render() draws, simulate() fills the back copy
+    struct CrowdFrame {
+        std::vector<glm::mat4> palettes;  // One slice per character
+        std::vector<GLfloat> morphWeights;
+        glm::mat4 view;
+        double poseTime;
+    };
+    util::DoubleBuffer<CrowdFrame> frames;
+
+    // Crowd state, one pose per character
+    GLuint grid, jointCount, workers;
+    jobs::JobSystem serial;  // Calling thread only
+    std::vector<anim::SkeletonPose> poses;
+    std::vector<anim::PoseJob> jobs;
+    std::vector<anim::PackedPoseJob> packedJobs;
+    bool parallel, compressed;
+
+    // First clip packed into a blob, sampled instead of the raw one on [C]
+    std::vector<GLubyte> clipBlob;
+    anim::CompressedClip packedClip;
+
+    double lastReport, poseTime;
+    GLuint poseFrames;
+    metrics::Recorder* poseMetric;  // Pose times of every frame, exported
+
+    // One animator per morph channel, the same weights for every character
+    std::vector<anim::PropertyAnimator<GLfloat> > morphs;
+    anim::AnimatorRegistry<GLfloat> morphAnimators;
+    GLuint morphRebuilds;
+    bool morphsPaused;
+
+    GLfloat mlast_x, mlast_y;
+    bool first_call;
+
+    void setCrowd(GLuint _grid) {
+        grid = _grid;
+        GLuint count = grid * grid;
+
+        for (GLuint i = 0; i < 2; ++i) {
+            frames[i].palettes.assign(count * jointCount, glm::mat4(1.0f));
+            frames[i].poseTime = 0.0;
+        }
+        poses.assign(count, anim::SkeletonPose());
+        jobs.resize(count);
+        packedJobs.resize(packedClip.valid() ? count : 0);
+        if (character.skinned()) {
+            const anim::AnimationClip* clip =
+                character.getClips().empty() ? NULL : &character.getClips()[0];
+            for (GLuint i = 0; i < count; ++i) {
+                poses[i].setSkeleton(&character.getSkeleton());
+                jobs[i].pose = &poses[i]; jobs[i].clip = clip;
+                jobs[i].time = 0.0f; jobs[i].palette = NULL;
+            }
+            for (GLuint i = 0; i < packedJobs.size(); ++i) {
+                packedJobs[i].pose = &poses[i]; packedJobs[i].clip = &packedClip;
+                packedJobs[i].time = 0.0f; packedJobs[i].palette = NULL;
+            }
+        }
+
+        palette.init(frames[0].palettes.size());
+        character.renderContext().shouldDrawInstanced = true;
+        character.renderContext().instanceAmount = count;
+        scene_shader.use();
+        glUniform1i(loc_grid_width, grid);
+    }
+
+    // Channels swing between 0 and 1 out of phase with each other
+    void setupMorphs() {
+        morphs.resize(character.morphChannels());
+        frames[0].morphWeights.assign(morphs.size(), 0.0f);
+        frames[1].morphWeights.assign(morphs.size(), 0.0f);
+        for (GLuint i = 0; i < morphs.size(); ++i) {
+            morphs[i].set(0.0f, 1.0f, 1.0f + 0.5f * i);
+            morphs[i].setLoopType(anim::LOOP_REVERSE);
+            morphs[i].setInterpolator(anim::InterpolatorFactory<GLfloat>::create(anim::SINE));
+            morphAnimators.add(&morphs[i]);
+        }
+    }
+
+    // Reports every clip of the model, keeps the first one for playback
+    void compressClips() {
+        const std::vector<anim::AnimationClip>& clips = character.getClips();
+        std::vector<GLubyte> blob;
+        anim::CompressedClip packed;
+
+        for (GLuint i = 0; i < clips.size(); ++i) {
+            anim::ClipCompressor::compress(clips[i], anim::ClipCompression(), blob);
+            if (!packed.load(&blob[0], blob.size())) continue;
+            anim::printClipReport(anim::ClipCompressor::measure(clips[i], packed));
+            if (i == 0) clipBlob.swap(blob);
+        }
+
+        if (!clipBlob.empty()) packedClip.load(&clipBlob[0], clipBlob.size());
+    }
+};
+
+DECLARE_MAIN(Crowd);
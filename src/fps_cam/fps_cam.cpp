@@ -27,11 +27,15 @@ const glm::vec3 cube_pos[] = {
     glm::vec3(-1.3f,  1.0f, -1.5f)
 };
 
+// Camera and texture mix advance at this rate, rendering interpolates between updates
+#define FPS_CAM_STEP (1.0 / 30.0)
+#define FPS_CAM_RATE 120.0
+
 class FPSCamDemo: public glf::BaseApp {
  public:
     FPSCamDemo() {
         util::set_color4f1(bg_col, 0.8f, 0.8f, 0.8f);
-        tex_mix = 0.2f; first_call = true;
+        tex_mix = prev_tex_mix = 0.2f; first_call = true;
     }
 
     void setup() {
@@ -39,6 +43,12 @@ class FPSCamDemo: public glf::BaseApp {
         info.width = 1366; info.height = 768;
         info.flags.fullscreen = 1;
         info.flags.cursor = 0;
+        setFixedTimestep(FPS_CAM_STEP);
+
+        // Paced without vsync, mouse look applied right before drawing
+        setFrameLimit(FPS_CAM_RATE);
+        enableLateLatching(true);
+        enablePacingReport(true);
     }
 
     void startup() {
@@ -156,6 +166,7 @@ class FPSCamDemo: public glf::BaseApp {
         cam.position(glm::vec3(0.0f, 0.0f, 5.0f));
         cam.front(glm::vec3(0.0f) - cam.position());
         cam.speed(4.0f);  // 4 units in 1 second
+        prev_cam_pos = cam.position();
 
         // Configure cubes
         glm::vec3 rot_axis = glm::vec3(1.0f, 0.3f, 0.5f);
@@ -171,19 +182,25 @@ class FPSCamDemo: public glf::BaseApp {
         glDeleteVertexArrays(1, &vAO);
     }
 
-    void render(double elapsedTime, double duration) {
+    void update(double step) {
+        prev_cam_pos = cam.position();
+        prev_tex_mix = tex_mix;
+        update_state(step);
+    }
+
+    void render(double elapsedTime, double duration, double alpha) {
         // Clear to background
         glClearBufferfv(GL_COLOR, 0, bg_col);
         glClear(GL_DEPTH_BUFFER_BIT);
 
-        // Update object states
-        update_state(duration);
+        // Between the last two updates
+        glm::mat4 view = cam.viewMatAt(glm::mix(prev_cam_pos, cam.position(), (GLfloat) alpha));
 
         glBindVertexArray(vAO);
-        glVertexAttrib1f(TEX_MIX_ID, tex_mix);
+        glVertexAttrib1f(TEX_MIX_ID, LINEAR_IP((GLfloat) alpha, prev_tex_mix, tex_mix));
 
         for (int i = 0; i < kCubeSize; ++i) {
-            glm::mat4 tmat = proj_mat * cam.viewMat() * cubes[i].modelMat();
+            glm::mat4 tmat = proj_mat * view * cubes[i].modelMat();
             glUniformMatrix4fv(trans_loc, 1, GL_FALSE, glm::value_ptr(tmat));
             glDrawArrays(GL_TRIANGLES, 0, kVertsSize);
         }
@@ -236,7 +253,7 @@ class FPSCamDemo: public glf::BaseApp {
 
     // OpenGL data
     glf::Shader shader;
-    GLfloat bg_col[4], tex_mix;
+    GLfloat bg_col[4], tex_mix, prev_tex_mix;
     GLuint vAO, vBO, tex[kTexSize];
 
     // Transform data
@@ -245,6 +262,7 @@ class FPSCamDemo: public glf::BaseApp {
 
     // 3d objects
     glf3d::FreeCamera cam;
+    glm::vec3 prev_cam_pos;  // Position before the last update
     glf3d::Object3D cubes[kCubeSize];
 
     // 3d object state data
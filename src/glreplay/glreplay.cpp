@@ -0,0 +1,136 @@
+#include <base.h>
+#include <base_glcapture.h>
+#include <base_glstats.h>
+#include <base_metrics.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <algorithm>
+#include <chrono>
+
+/**
+ * Plays a GL capture (--capture on any demo) back in a hidden window, with
+ * no app or asset loading in the way, and times the frames: submission on
+ * the CPU, and submission through glFinish() for the GPU side. Setup runs
+ * once, then the captured frames loop
+ * Usage: glreplay <capture> [loops]
+ * @author: Methusael Murmu
+ */
+
+typedef std::chrono::high_resolution_clock Clock;
+
+static inline GLuint64 microsSince(const Clock::time_point& start) {
+    return std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - start).count();
+}
+
+static void printTimes(const char* _label, const metrics::Histogram& _h) {
+    printf("%-22s %8.3f ms p50 %8.3f ms p99 %8.3f ms max\n", _label,
+        _h.percentile(50.0) / 1000.0, _h.percentile(99.0) / 1000.0, _h.max() / 1000.0);
+}
+
+static GLenum drainErrors() {
+    GLenum first = GL_NO_ERROR, error;
+    while ((error = glGetError()) != GL_NO_ERROR)
+        if (first == GL_NO_ERROR) first = error;
+    return first;
+}
+
+int main(int argc, char* argv[]) {
+    if (argc < 2) {
+        fprintf(stderr, "Usage: %s <capture> [loops]\n", argv[0]);
+        return 1;
+    }
+    GLuint loops = argc > 2 ? std::max(1, atoi(argv[2])) : 100;
+
+    // Header first, the window has to match the captured framebuffer
+    glcapture::Header header;
+    FILE* fp = fopen(argv[1], "rb");
+    if (!fp || fread(&header, sizeof(header), 1, fp) != 1) {
+        fprintf(stderr, "Unable to read %s\n", argv[1]);
+        if (fp) fclose(fp);
+        return 1;
+    }
+    fclose(fp);
+
+    if (!glfwInit()) {
+        fprintf(stderr, "Failed to initialize GLFW\n");
+        return -1;
+    }
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+    glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+    glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
+    glfwWindowHint(GLFW_VISIBLE, GL_FALSE);
+
+    GLFWwindow* window = glfwCreateWindow(std::max(header.width, 1u),
+        std::max(header.height, 1u), "glreplay", NULL, NULL);
+    if (!window) {
+        fprintf(stderr, "Failed to create window\n");
+        glfwTerminate();
+        return -2;
+    }
+    glfwMakeContextCurrent(window);
+    glfwSwapInterval(0);
+
+    if (gl3wInit()) {
+        fprintf(stderr, "Failed to initialize OpenGL\n");
+        glfwTerminate();
+        return -3;
+    }
+    // Replayed calls go through the counters like the app's did
+    glstats::install();
+
+    glcapture::Replay replay;
+    if (!replay.load(argv[1])) {
+        glfwTerminate();
+        return 1;
+    }
+    if (!replay.frames()) {
+        fprintf(stderr, "%s holds no frames\n", argv[1]);
+        glfwTerminate();
+        return 1;
+    }
+
+    Clock::time_point start = Clock::now();
+    GLuint setupCalls = replay.playSetup();
+    glFinish();
+    GLuint64 setupUs = microsSince(start);
+    if (GLenum error = drainErrors())
+        fprintf(stderr, "GL error 0x%04x during setup\n", error);
+
+    metrics::Histogram submit, complete;
+    GLuint64 calls = 0;
+    bool failed = false;
+    glstats::reset();
+    for (GLuint loop = 0; loop < loops && !failed; ++loop) {
+        for (GLuint f = 0; f < replay.frames(); ++f) {
+            start = Clock::now();
+            GLuint frameCalls = replay.playFrame(f);
+            submit.record(microsSince(start));
+            glFinish();
+            complete.record(microsSince(start));
+
+            if (!frameCalls) { failed = true; break; }
+            calls += frameCalls;
+        }
+        if (loop == 0) {
+            if (GLenum error = drainErrors())
+                fprintf(stderr, "GL error 0x%04x replaying the frames\n", error);
+        }
+    }
+    glstats::Counters counts = glstats::take();
+
+    GLuint64 played = std::max(submit.count(), (GLuint64) 1);
+    printf("%s: %ux%u, %u frames, %.2f MB\n", argv[1], header.width, header.height,
+        replay.frames(), replay.bytes() / (1024.0 * 1024.0));
+    printf("Setup:                 %8.3f ms, %u calls\n", setupUs / 1000.0, setupCalls);
+    printf("Frames played:         %8llu (%u loops)\n", (unsigned long long) submit.count(), loops);
+    printf("Calls per frame:       %8.1f, %.1f draws, %.0f triangles\n", (GLdouble) calls / played,
+        (GLdouble) counts.draws / played, (GLdouble) counts.triangles / played);
+    printTimes("Submit:", submit);
+    printTimes("Submit + glFinish:", complete);
+
+    glfwTerminate();
+    return failed ? 2 : 0;
+}
@@ -3,6 +3,7 @@
 #include <3d/camera.h>
 #include <3d/object.h>
 #include <3d/model.h>
+#include <3d/shadow.h>
 #include <base_shader.h>
 #include <animator/anim.h>
 
@@ -28,6 +29,12 @@ struct LightShaderData {
 #define NUM_LIGHTS 1
 #define DEPTH_RES_WIDTH 1024
 #define DEPTH_RES_HEIGHT 1024
+#define SHADOW_REPORT_INTERVAL 2.0
+
+// Cascaded shadow setup (resolution per cascade, cascade count up to MAX_CASCADES)
+#define CSM_RES 1024
+#define CSM_CASCADES 3
+#define CSM_DISTANCE 40.0f
 
 LightShaderData light_data[NUM_LIGHTS] = {
     { glf3d::SUN, glm::vec3(0.0f, 10.0f, 12.0f), glm::vec3(0.0f, -1.0f, -1.0f),
@@ -41,9 +48,11 @@ const glm::vec3 kSpotLightOffset = glm::vec3(0.05f, -0.5f, -0.1f);
 
 class ShadowMap: public glf::BaseApp {
  public:
-    ShadowMap() {
+    ShadowMap(): csm(CSM_CASCADES, CSM_RES) {
         util::set_color4f1(bg_col, 0.005f, 0.005f, 0.005f);
         first_call = true;
+        lastReport = 0.0;
+        csmEnabled = true;
 
         scaleBiasMat = glm::mat4(
             glm::vec4(0.5f, 0.0f, 0.0f, 0.0f),
@@ -61,9 +70,13 @@ class ShadowMap: public glf::BaseApp {
 
         enableFPSDisplay(true);
         enableStatsDisplay(true);
+        enableProfiler(true);
     }
 
     void startup() {
+        layeredSupported =
+            util::has_extension("GL_ARB_shader_viewport_layer_array") ||
+            util::has_extension("GL_AMD_vertex_shader_layer");
         setupShaders();
 
         // Cube vertex data
@@ -130,33 +143,16 @@ class ShadowMap: public glf::BaseApp {
         glBindBuffer(GL_ARRAY_BUFFER, 0);
         glBindVertexArray(0);  // Unbind vAO;
 
-        // Shadow buffers
-        glGenTextures(1, &depthTex);
-        glBindTexture(GL_TEXTURE_2D, depthTex);
-
-        glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT32, DEPTH_RES_WIDTH, DEPTH_RES_HEIGHT,
-            0, GL_DEPTH_COMPONENT, GL_FLOAT, NULL);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_BORDER);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_BORDER);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_COMPARE_MODE, GL_COMPARE_REF_TO_TEXTURE);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_COMPARE_FUNC, GL_LEQUAL);
-        glBindTexture(GL_TEXTURE_2D, 0);
-
-        glGenFramebuffers(1, &depthBuffer);
-        glBindFramebuffer(GL_FRAMEBUFFER, depthBuffer);
-        glFramebufferTexture(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, depthTex, 0);
-        glDrawBuffer(GL_NONE);
-
-        fprintf(stdout, "%s\x1b[0m\n",
-            glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE ?
-                "\x1b[32mShadow initialization complete" : "\x1b[31mShadow initialization failed");
-        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        // Shadow buffers: live shadow map and cached static caster depth
+        setupShadowBuffer(depthTex, depthBuffer);
+        setupShadowBuffer(depthCacheTex, depthCacheBuffer);
+        setupCascadeBuffers();
+        shadowTimer.init();
 
         // Configure transformations
+        cam.near(0.1f); cam.far(100.0f);
         pMat = glm::perspective(cam.fov(),
-            (GLfloat) getWidth() / getHeight(), 0.1f, 100.0f);
+            (GLfloat) getWidth() / getHeight(), cam.near(), cam.far());
         lpMat = glm::ortho(-10.0f, 10.0f, -10.0f, 10.0f, 1.0f, 20.0f);
 
         cam.position(glm::vec3(0, 4.0f, 10.0f));
@@ -173,6 +169,13 @@ class ShadowMap: public glf::BaseApp {
         model[PLANE].material.shininess(200.0f);
         model[PLANE].scalef(0.8f);
 
+        // The pavement's depth is only rendered when the light moves, the turning
+        // cyborg is drawn over a copy of it every frame
+        for (i = 0; i < MODEL_SZ; ++i) {
+            casterStatic[i] = i != BOX;
+            if (casterStatic[i]) shadowCache.addStatic(&model[i]);
+        }
+
         // Animation data
         light_rot.set(0.0f, 360.0f, 30.0f);
         light_rot.setLoopType(anim::LOOP_START);
@@ -180,7 +183,76 @@ class ShadowMap: public glf::BaseApp {
             anim::InterpolatorFactory<GLfloat>::create(anim::LINEAR));
         animReg.add(&light_rot);
 
+        model_rot.set(0.0f, 360.0f, 12.0f);
+        model_rot.setLoopType(anim::LOOP_START);
+        model_rot.setInterpolator(
+            anim::InterpolatorFactory<GLfloat>::create(anim::LINEAR));
+        animReg.add(&model_rot);
+
         glClearColor(bg_col[0], bg_col[1], bg_col[2], bg_col[3]);
+        fprintf(stdout, "Shadow cache: [C] toggle, [P] pause light\n");
+        fprintf(stdout, "Cascades: [M] toggle, [Up/Down] count%s\n",
+            layeredSupported ? " (single layered pass)" : "");
+    }
+
+    void setupCascadeBuffers() {
+        GPU_OWNER("Shadow maps");
+        glGenTextures(1, &csmTex);
+        glBindTexture(GL_TEXTURE_2D_ARRAY, csmTex);
+
+        glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_DEPTH_COMPONENT32, CSM_RES, CSM_RES,
+            MAX_CASCADES, 0, GL_DEPTH_COMPONENT, GL_FLOAT, NULL);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_COMPARE_MODE, GL_COMPARE_REF_TO_TEXTURE);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_COMPARE_FUNC, GL_LEQUAL);
+        glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+
+        // Layered target for the single pass, one target per layer otherwise
+        glGenFramebuffers(1, &csmBuffer);
+        glBindFramebuffer(GL_FRAMEBUFFER, csmBuffer);
+        glFramebufferTexture(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, csmTex, 0);
+        glDrawBuffer(GL_NONE);
+
+        glGenFramebuffers(MAX_CASCADES, csmLayerBuffer);
+        for (i = 0; i < MAX_CASCADES; ++i) {
+            glBindFramebuffer(GL_FRAMEBUFFER, csmLayerBuffer[i]);
+            glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, csmTex, 0, i);
+            glDrawBuffer(GL_NONE);
+        }
+
+        fprintf(stdout, "%s\x1b[0m\n",
+            glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE ?
+                "\x1b[32mCascade initialization complete" : "\x1b[31mCascade initialization failed");
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    }
+
+    void setupShadowBuffer(GLuint& tex, GLuint& fbo) {
+        GPU_OWNER("Shadow maps");
+        glGenTextures(1, &tex);
+        glBindTexture(GL_TEXTURE_2D, tex);
+
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT32, DEPTH_RES_WIDTH, DEPTH_RES_HEIGHT,
+            0, GL_DEPTH_COMPONENT, GL_FLOAT, NULL);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_BORDER);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_BORDER);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_COMPARE_MODE, GL_COMPARE_REF_TO_TEXTURE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_COMPARE_FUNC, GL_LEQUAL);
+        glBindTexture(GL_TEXTURE_2D, 0);
+
+        glGenFramebuffers(1, &fbo);
+        glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+        glFramebufferTexture(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, tex, 0);
+        glDrawBuffer(GL_NONE);
+
+        fprintf(stdout, "%s\x1b[0m\n",
+            glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE ?
+                "\x1b[32mShadow initialization complete" : "\x1b[31mShadow initialization failed");
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
     }
 
     void setupShaders() {
@@ -191,6 +263,15 @@ class ShadowMap: public glf::BaseApp {
             glf::Shader::FRAGMENT);
         shadow_shader.compile();
 
+        // gl_Layer can only be written from the vertex stage with extension support
+        if (layeredSupported) {
+            csm_shader.load("media/shadow_map/shaders/shadow_csm.vert",
+                glf::Shader::VERTEX);
+            csm_shader.load("media/shadow_map/shaders/shadow.frag",
+                glf::Shader::FRAGMENT);
+            csm_shader.compile();
+        }
+
         light_shader.load("media/shadow_map/shaders/light.vert",
             glf::Shader::VERTEX);
         light_shader.load("media/shadow_map/shaders/light.frag",
@@ -221,6 +302,10 @@ class ShadowMap: public glf::BaseApp {
         uniformScene.frag.cam_pos       = uni_loc(scene_shader, "cam_pos");
         uniformScene.frag.lcount        = uni_loc(scene_shader, "light_count");
         uniformScene.frag.shadowTex     = uni_loc(scene_shader, "shadow_tex");
+        uniformScene.frag.camFront      = uni_loc(scene_shader, "cam_front");
+        uniformScene.csm.enabled        = uni_loc(scene_shader, "csm_enabled");
+        uniformScene.csm.count          = uni_loc(scene_shader, "csm_count");
+        uniformScene.csm.tex            = uni_loc(scene_shader, "csm_tex");
 
         uniformScene.world.amb          = uni_loc(scene_shader, "world.ambience");
         uniformScene.material.shine     = uni_loc(scene_shader, "material.shininess");
@@ -242,6 +327,16 @@ class ShadowMap: public glf::BaseApp {
             uniformScene.light[i].epsilon    = get_uni(scene_prog, "light", "epsilon", i);
         }
 
+        for (i = 0; i < MAX_CASCADES; ++i) {
+            uniformScene.csm.split[i]   = get_uni(scene_prog, "csm_split", i);
+            uniformScene.csm.mat[i]     = get_uni(scene_prog, "csm_mat", i);
+        }
+        if (layeredSupported) {
+            for (i = 0; i < MAX_CASCADES; ++i)
+                uniformCSM.vert.lvpMat[i] = get_uni(csm_shader.getProgram(), "lvpMat", i);
+            uniformCSM.vert.lmMat = glGetUniformLocation(csm_shader.getProgram(), "lmMat");
+        }
+
 #undef scene_prog
 #undef get_uni
 
@@ -285,12 +380,20 @@ class ShadowMap: public glf::BaseApp {
         // Other static data
         glUniform1i(uniformScene.frag.lcount, NUM_LIGHTS);
         glUniform3f(uniformScene.world.amb, 0.8f, 0.8f, 0.8f);
+        // Keep the array shadow sampler off the units used by material textures
+        glUniform1i(uniformScene.csm.tex, 4);
     }
 
     void shutdown() {
+        shadowTimer.dispose();
         glDeleteTextures(1, &depthTex);
+        glDeleteTextures(1, &depthCacheTex);
         glDeleteBuffers(1, &vBO);
         glDeleteBuffers(1, &depthBuffer);
+        glDeleteFramebuffers(1, &depthCacheBuffer);
+        glDeleteTextures(1, &csmTex);
+        glDeleteFramebuffers(1, &csmBuffer);
+        glDeleteFramebuffers(MAX_CASCADES, csmLayerBuffer);
         glDeleteVertexArrays(VAO_SZ, vAO);
     }
 
@@ -303,28 +406,75 @@ class ShadowMap: public glf::BaseApp {
         lvpMat = lpMat * lvMat; shadowMat = scaleBiasMat * lvpMat;
 
         /* --------------------- Render shadow map --------------------- */
-        shadow_shader.use();
-        glBindFramebuffer(GL_FRAMEBUFFER, depthBuffer);
-        glViewport(0, 0, DEPTH_RES_WIDTH, DEPTH_RES_HEIGHT);
-
         glClearDepth(1.0f);
-        glClear(GL_DEPTH_BUFFER_BIT);
-
         glEnable(GL_POLYGON_OFFSET_FILL);
         glPolygonOffset(2.0f, 2.0f);
-
-        for (i = 0; i < MODEL_SZ; ++i) {
-            glUniformMatrix4fv(uniformShadow.vert.lmvpMat, 1, GL_FALSE, _vp(lvpMat * model[i].modelMat()));
-            model[i].render(&shader_tex_info);
+        shadowTimer.begin();
+        prof::Profiler::instance().beginGpuZone("Shadow pass");
+
+        bool cached = shadowCache.isEnabled();
+        if (csmEnabled) {
+            // Cascades follow the camera, so they are re-rendered every frame
+            csm.update(cam.viewMat(), cam.fov(), (GLfloat) getWidth() / getHeight(),
+                cam.near(), std::min(cam.far(), CSM_DISTANCE), light[0].direction());
+            renderCascades();
+            shadowCache.invalidate();
+        } else {
+            shadow_shader.use();
+            glViewport(0, 0, DEPTH_RES_WIDTH, DEPTH_RES_HEIGHT);
+
+            // Static depth is kept in its own map only if dynamic casters are drawn over it,
+            // otherwise the live shadow map doubles as the cache
+            bool split = cached && hasDynamicCasters();
+            if (shadowCache.stale(light[0])) {
+                renderCasters(split ? depthCacheBuffer : depthBuffer,
+                    cached ? glf3d::CASTER_STATIC : glf3d::CASTER_ALL);
+            }
+            if (split) {
+                glf3d::blitDepth(depthCacheBuffer, depthBuffer, DEPTH_RES_WIDTH, DEPTH_RES_HEIGHT);
+                renderCasters(depthBuffer, glf3d::CASTER_DYNAMIC, false);
+            }
         }
+
+        prof::Profiler::instance().endGpuZone();
+        shadowTimer.end();
         glDisable(GL_POLYGON_OFFSET_FILL);
         glBindFramebuffer(GL_FRAMEBUFFER, 0);
 
+        if (elapsedTime - lastReport > SHADOW_REPORT_INTERVAL) {
+            if (csmEnabled) {
+                fprintf(stdout, "Shadow pass [%u cascades @ %d]: %.3f ms\n",
+                    csm.count(), CSM_RES, shadowTimer.average());
+            } else {
+                fprintf(stdout, "Shadow pass [single @ %d, cache %s]: %.3f ms (%u rebuilds)\n",
+                    DEPTH_RES_WIDTH, cached ? "on" : "off", shadowTimer.average(),
+                    shadowCache.rebuildCount());
+            }
+            shadowTimer.reset();
+            lastReport = elapsedTime;
+        }
+
         /* ------------------------ Render scene ------------------------ */
+        prof::Profiler::instance().beginGpuZone("Scene pass");
         scene_shader.use();
         glViewport(0, 0, getWidth(), getHeight());
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
+        // Cascade data
+        glUniform1i(uniformScene.csm.enabled, csmEnabled);
+        if (csmEnabled) {
+            glActiveTexture(GL_TEXTURE4);
+            glBindTexture(GL_TEXTURE_2D_ARRAY, csmTex);
+            glUniform1i(uniformScene.csm.count, csm.count());
+            glUniform3fv(uniformScene.frag.camFront, 1, _vp(cam.front()));
+
+            for (i = 0; i < csm.count(); ++i) {
+                glUniform1f(uniformScene.csm.split[i], csm.splitDepth(i));
+                glUniformMatrix4fv(uniformScene.csm.mat[i], 1, GL_FALSE,
+                    _vp(scaleBiasMat * csm.lightViewProj(i)));
+            }
+        }
+
         // Bind to shadow texture uniform
         glActiveTexture(GL_TEXTURE3);
         glBindTexture(GL_TEXTURE_2D, depthTex);
@@ -354,6 +504,7 @@ class ShadowMap: public glf::BaseApp {
             model[i].render(&shader_tex_info);
         }
         glBindTexture(GL_TEXTURE_2D, 0);
+        prof::Profiler::instance().endGpuZone();
 
         /* -------------------------- Render Lights --------------------- */
         light_shader.use();
@@ -368,14 +519,75 @@ class ShadowMap: public glf::BaseApp {
         }
         glBindVertexArray(0);
     }
+
+    void renderCasters(GLuint fbo, glf3d::CasterFilter filter, bool clear = true) {
+        glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+        if (clear) glClear(GL_DEPTH_BUFFER_BIT);
+
+        for (i = 0; i < MODEL_SZ; ++i) {
+            if (!glf3d::casterSelected(casterStatic[i], filter)) continue;
+
+            glUniformMatrix4fv(uniformShadow.vert.lmvpMat, 1, GL_FALSE, _vp(lvpMat * model[i].modelMat()));
+            model[i].render(&shader_tex_info);
+        }
+    }
+
+    void renderCascades() {
+        GLuint c, count = csm.count();
+        glViewport(0, 0, CSM_RES, CSM_RES);
+
+        if (layeredSupported) {
+            // Single pass, each model instanced once per cascade
+            csm_shader.use();
+            glBindFramebuffer(GL_FRAMEBUFFER, csmBuffer);
+            glClear(GL_DEPTH_BUFFER_BIT);
+
+            for (c = 0; c < count; ++c) {
+                glUniformMatrix4fv(uniformCSM.vert.lvpMat[c], 1, GL_FALSE,
+                    _vp(csm.lightViewProj(c)));
+            }
+
+            for (i = 0; i < MODEL_SZ; ++i) {
+                glf3d::RenderContext& ctx = model[i].renderContext();
+                ctx.shouldDrawInstanced = true;
+                ctx.instanceAmount = count;
+
+                glUniformMatrix4fv(uniformCSM.vert.lmMat, 1, GL_FALSE, _vp(model[i].modelMat()));
+                model[i].render(&shader_tex_info);
+                ctx.shouldDrawInstanced = false;
+            }
+        } else {
+            shadow_shader.use();
+            for (c = 0; c < count; ++c) {
+                glBindFramebuffer(GL_FRAMEBUFFER, csmLayerBuffer[c]);
+                glClear(GL_DEPTH_BUFFER_BIT);
+
+                for (i = 0; i < MODEL_SZ; ++i) {
+                    glUniformMatrix4fv(uniformShadow.vert.lmvpMat, 1, GL_FALSE,
+                        _vp(csm.lightViewProj(c) * model[i].modelMat()));
+                    model[i].render(&shader_tex_info);
+                }
+            }
+        }
+    }
 #undef _vp
 
+    bool hasDynamicCasters() const {
+        for (GLuint m = 0; m < MODEL_SZ; ++m)
+            if (!casterStatic[m]) return true;
+        return false;
+    }
+
     // Ugly state machine
     void update_state(double duration) {
         // Handle animation
         animReg.animate(duration);
-        float rad = glm::radians(light_rot.value());
-        light[0].direction(glm::vec3(sin(rad), -1.0f, cos(rad)));
+        // Leave the light untouched while paused to keep the shadow cache valid
+        if (light_rot.status() == anim::RUNNING) {
+            float rad = glm::radians(light_rot.value());
+            light[0].direction(glm::vec3(sin(rad), -1.0f, cos(rad)));
+        }
+        model[BOX].rotate(glm::radians(model_rot.value()), glm::vec3(0.0f, 1.0f, 0.0f));
 
         // Handle keyboard input
         if (testKeyState(GLFW_KEY_W, GLFW_PRESS))
@@ -405,6 +617,31 @@ class ShadowMap: public glf::BaseApp {
         mlast_x = x; mlast_y = y;
     }
 
+    void onKeyPress(int key, int mods) {
+        glf::BaseApp::onKeyPress(key, mods);
+
+        switch (key) {
+            case GLFW_KEY_C:
+                shadowCache.enable(!shadowCache.isEnabled());
+                shadowTimer.reset();
+                break;
+            case GLFW_KEY_P:
+                if (light_rot.status() == anim::RUNNING) animReg.pause();
+                else animReg.play();
+                break;
+            case GLFW_KEY_M:
+                csmEnabled = !csmEnabled;
+                shadowTimer.reset();
+                break;
+            case GLFW_KEY_UP:
+            case GLFW_KEY_DOWN:
+                csm.count(csm.count() + (key == GLFW_KEY_UP ? 1 : -1));
+                shadowTimer.reset();
+                break;
+            default: break;
+        }
+    }
+
  private:
     enum VAOs { LIGHT, VAO_SZ };
     enum MODEL { BOX, PLANE, MODEL_SZ };
@@ -415,13 +652,16 @@ class ShadowMap: public glf::BaseApp {
     GLfloat bg_col[4];
     GLuint vAO[VAO_SZ], vBO;
     GLuint depthBuffer, depthTex;
-    glf::Shader scene_shader, light_shader, shadow_shader, text_shader;
+    GLuint depthCacheBuffer, depthCacheTex;
+    GLuint csmBuffer, csmTex, csmLayerBuffer[MAX_CASCADES];
+    glf::Shader scene_shader, light_shader, shadow_shader, csm_shader, text_shader;
     glf::ShaderTextureInfo shader_tex_info;
     GLuint i;  // Loop counter
 
     struct {
         struct { GLuint modelMat, transMat, normalMat, shadowMat; } vert;
-        struct { GLuint cam_pos, lcount, shadowTex; } frag;
+        struct { GLuint cam_pos, camFront, lcount, shadowTex; } frag;
+        struct { GLuint enabled, count, tex, split[MAX_CASCADES], mat[MAX_CASCADES]; } csm;
         struct { GLuint amb; } world;
         struct { GLuint shine, specint, amb; } material;
 
@@ -440,6 +680,10 @@ class ShadowMap: public glf::BaseApp {
         struct { GLuint lmvpMat; } vert;
     } uniformShadow;
 
+    struct {
+        struct { GLuint lmMat, lvpMat[MAX_CASCADES]; } vert;
+    } uniformCSM;
+
     // Transform data
     glm::mat4 lpMat, lvMat, lvpMat, shadowMat, scaleBiasMat;
     glm::mat4 pMat, vpMat, mvpMat;
@@ -449,13 +693,23 @@ class ShadowMap: public glf::BaseApp {
     glf3d::Light light[NUM_LIGHTS];
     glf3d::Model model[MODEL_SZ];
 
+    // Shadow cache state
+    bool casterStatic[MODEL_SZ];
+    glf3d::ShadowCache shadowCache;
+    util::GPUTimer shadowTimer;
+    double lastReport;
+
+    // Cascaded shadow state
+    glf3d::CascadedShadow csm;
+    bool csmEnabled, layeredSupported;
+
     // 3d object state data
     GLfloat mlast_x, mlast_y;
     bool first_call;
 
     // Animation data
     anim::AnimatorRegistry<GLfloat> animReg;
-    anim::PropertyAnimator<GLfloat> light_rot;
+    anim::PropertyAnimator<GLfloat> light_rot, model_rot;
 };
 
 DECLARE_MAIN(ShadowMap);
@@ -3,6 +3,7 @@
 #include <3d/camera.h>
 #include <3d/object.h>
 #include <3d/model.h>
+#include <3d/shadow.h>
 #include <base_shader.h>
 #include <animator/anim.h>
 #include <text/text.h>
@@ -24,15 +25,35 @@ struct LightShaderData {
     GLfloat inten, distance, scale;
 };
 
+// Depth cube with layered and per face framebuffers,
+// plus a depth moments cube for variance shadow maps (0 if unused)
+struct ShadowTarget {
+    GLuint tex, moments, fbo, faceFbo[6];
+};
+
 // Light setup
 #define SPOT_IDX 0      // Light to be used as spotlight
-#define NUM_LIGHTS 1
+#define NUM_LIGHTS 4
 #define DEPTH_RES_WIDTH 1024
 #define DEPTH_RES_HEIGHT 1024
+#define SHADOW_FAR_PLANE 100.0f
+#define SHADOW_REPORT_INTERVAL 2.0
+
+// Shadow atlas: tile sizes per cube face, reach of a light's visible shadows
+#define ATLAS_RES 4096
+#define ATLAS_MIN_TILE 64
+#define ATLAS_MAX_TILE 1024
+#define ATLAS_LIGHT_REACH 4.0f
 
 LightShaderData light_data[NUM_LIGHTS] = {
     { glf3d::POINT, glm::vec3(0.0f, 1.0f, 1.5f), glm::vec3(0.0f, -1.0f, -1.0f),
-      glm::vec3(1.0f), 0, 0, 1.0f, 30.0f, 0.05f }
+      glm::vec3(1.0f), 0, 0, 1.0f, 30.0f, 0.05f },
+    { glf3d::POINT, glm::vec3(1.5f, 2.5f, 0.0f), glm::vec3(0.0f, -1.0f, 0.0f),
+      glm::vec3(1.0f, 0.4f, 0.3f), 0, 0, 0.5f, 30.0f, 0.04f },
+    { glf3d::POINT, glm::vec3(-1.5f, 1.2f, -1.0f), glm::vec3(0.0f, -1.0f, 0.0f),
+      glm::vec3(0.3f, 0.5f, 1.0f), 0, 0, 0.5f, 30.0f, 0.04f },
+    { glf3d::POINT, glm::vec3(0.0f, 3.0f, -1.8f), glm::vec3(0.0f, -1.0f, 0.0f),
+      glm::vec3(0.4f, 1.0f, 0.4f), 0, 0, 0.4f, 30.0f, 0.04f }
 };
 
 // Vector constants
@@ -51,6 +72,22 @@ const glm::vec3 kLookVector[6][2] = {
     { glm::vec3( 0.0,  0.0, -1.0), kGlobalUp }
 };
 
+// Conservative test of a bounding sphere (relative to the light) against
+// the 90 degree frustum of a cube face
+bool cubeFaceVisible(GLuint face, const glm::vec3& rel, GLfloat radius) {
+    const glm::vec3& dir = kLookVector[face][0];
+    const glm::vec3& up = kLookVector[face][1];
+    GLfloat depth = glm::dot(rel, dir);
+
+    if (depth + radius < 0.0f || depth - radius > SHADOW_FAR_PLANE)
+        return false;
+
+    // Side plane normals are (dir +- axis) / sqrt(2)
+    GLfloat slack = radius * 1.41421356f;
+    return depth - fabs(glm::dot(rel, up)) >= -slack &&
+        depth - fabs(glm::dot(rel, glm::cross(dir, up))) >= -slack;
+}
+
 const glm::vec3 kCubePos[3] = {
     glm::vec3(0.0f, 2.501f, 0.0f),
     glm::vec3(2.0f, 3.501f, -2.0f),
@@ -59,9 +96,12 @@ const glm::vec3 kCubePos[3] = {
 
 class PointShadowMap: public glf::BaseApp {
  public:
-    PointShadowMap() {
+    PointShadowMap(): atlas(ATLAS_RES, ATLAS_MIN_TILE, ATLAS_MAX_TILE) {
         util::set_color4f1(bg_col, 0.005f, 0.005f, 0.005f);
+        shadowFilter = FILTER_PCF;
+        atlasEnabled = false;
         first_call = true;
+        lastReport = 0.0;
     }
 
     void setup() {
@@ -73,9 +113,16 @@ class PointShadowMap: public glf::BaseApp {
 
         enableFPSDisplay(true);
         enableStatsDisplay(true);
+        enableProfiler(true);
+        enableSDFText(true);
     }
 
     void startup() {
+        layeredSupported =
+            util::has_extension("GL_ARB_shader_viewport_layer_array") ||
+            util::has_extension("GL_AMD_vertex_shader_layer");
+        shadowPath = layeredSupported ? SHADOW_LAYERED : SHADOW_MULTIPASS;
+
         setupShaders();
         setBaseTextShader(&text_shader);  // To enable text rendering
 
@@ -141,14 +188,17 @@ class PointShadowMap: public glf::BaseApp {
         glBindBuffer(GL_ARRAY_BUFFER, 0);
         glBindVertexArray(0);  // Unbind vAO;
 
-        // Shadow
-        setupShadowBuffers();
+        // Shadow: live shadow cube and cached static caster depth
+        setupShadowBuffers(shadowLive);
+        setupShadowBuffers(shadowCached);
+        setupFilterBuffers();
+        setupAtlasBuffer();
 
         // Configure transformations
         pMat = glm::perspective(cam.fov(),
             (GLfloat) getWidth() / getHeight(), 0.1f, 100.0f);
         lpMat = glm::perspective(glm::radians(90.0f),
-            (GLfloat) DEPTH_RES_WIDTH / DEPTH_RES_HEIGHT, 1.0f, 100.0f);
+            (GLfloat) DEPTH_RES_WIDTH / DEPTH_RES_HEIGHT, 1.0f, SHADOW_FAR_PLANE);
 
         cam.position(glm::vec3(0, 1.5f, 4.0f));
         cam.front(glm::vec3(0.0) - cam.position());
@@ -167,18 +217,58 @@ class PointShadowMap: public glf::BaseApp {
         model[ROOM].material.shininess(200.0f);
         model[ROOM].scalef(0.8f);
 
+        // Static depth is only rendered when the light moves, the spinning first
+        // cube is drawn over a copy of it every frame
+        for (i = 0; i < MODEL_SZ; ++i) {
+            casterStatic[i] = i != BOX0;
+            if (casterStatic[i]) shadowCache.addStatic(&model[i]);
+        }
+
         // Configure animations
         for (i = 0; i < NUM_LIGHTS; ++i) {
             lightAnim[i].set(0.0, 360.0, i * 2.0f + 3.0f);
             lightAnim[i].setLoopType(anim::LOOP_START);
             animReg.add(&lightAnim[i]);
         }
+        boxSpin.set(0.0, 360.0, 6.0f);
+        boxSpin.setLoopType(anim::LOOP_START);
+        animReg.add(&boxSpin);
+
+        // Static uniforms, the layered program exists only where supported
+        for (i = 0; i < SHADOW_PATH_SZ; ++i) {
+            if (i == SHADOW_LAYERED && !layeredSupported) continue;
+            shadow_shader[i].use();
+            glUniform1f(uniformShadow[i].frag.farPlane, SHADOW_FAR_PLANE);
+        }
+        blur_shader.use();
+        glUniform1i(uniformBlur.planeSrc, 0);
+        glUniform1i(uniformBlur.cubeSrc, 1);
 
-        // Static uniforms
-        shadow_shader.use();
-        glUniform1f(uniformShadow.frag.farPlane, 100.0f);
         scene_shader.use();
-        glUniform1f(uniformScene.frag.farPlane, 100.0f);
+        glUniform1f(uniformScene.frag.farPlane, SHADOW_FAR_PLANE);
+        glUniform1i(uniformScene.frag.shadowTex, 3);
+        glUniform1i(uniformScene.frag.shadowCmpTex, 4);
+        glUniform1i(uniformScene.frag.vsmTex, 5);
+        glUniform1i(uniformScene.frag.shadowMode, shadowFilter);
+        glUniform1i(uniformScene.frag.atlasTex, 6);
+        glUniform1i(uniformScene.frag.atlasEnabled, atlasEnabled);
+        for (i = 0; i < 6; ++i) {
+            // Face basis of the lookAt views, to unroll cube lookups into atlas tiles
+            glm::vec3 right = glm::normalize(glm::cross(kLookVector[i][0], kLookVector[i][1]));
+            glUniform3fv(uniformScene.atlas.faceDir[i], 1, glm::value_ptr(kLookVector[i][0]));
+            glUniform3fv(uniformScene.atlas.faceRight[i], 1, glm::value_ptr(right));
+            glUniform3fv(uniformScene.atlas.faceUp[i], 1,
+                glm::value_ptr(glm::cross(right, kLookVector[i][0])));
+        }
+        shadowTimer.init();
+        sceneTimer.init();
+
+        fprintf(stdout, "Shadow path: %s [1] geometry, [2] layered%s, [3] multipass\n",
+            kShadowPathStr[shadowPath], layeredSupported ? "" : " (unsupported)");
+        fprintf(stdout, "Shadow cache: [C] toggle, [P] pause light\n");
+        fprintf(stdout, "Shadow filter: %s [F] cycle pcf / poisson / vsm\n",
+            kShadowFilterStr[shadowFilter]);
+        fprintf(stdout, "Shadow atlas: [T] toggle, shadows all %d lights\n", NUM_LIGHTS);
 
         // OpenGL functions
         glEnable(GL_DEPTH_TEST);
@@ -186,9 +276,10 @@ class PointShadowMap: public glf::BaseApp {
         glClearColor(bg_col[0], bg_col[1], bg_col[2], bg_col[3]);
     }
 
-    void setupShadowBuffers() {
-        glGenTextures(1, &depthTex);
-        glBindTexture(GL_TEXTURE_CUBE_MAP, depthTex);
+    void setupShadowBuffers(ShadowTarget& target, bool moments = false) {
+        GPU_OWNER("Shadow maps");
+        glGenTextures(1, &target.tex);
+        glBindTexture(GL_TEXTURE_CUBE_MAP, target.tex);
 
         for (i = 0; i < 6; ++i) {
             glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, 0, GL_DEPTH_COMPONENT,
@@ -201,26 +292,138 @@ class PointShadowMap: public glf::BaseApp {
         glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
         glBindTexture(GL_TEXTURE_CUBE_MAP, 0);
 
-        glGenFramebuffers(1, &depthBuffer);
-        glBindFramebuffer(GL_FRAMEBUFFER, depthBuffer);
-        glFramebufferTexture(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, depthTex, 0);
-        glDrawBuffer(GL_NONE);
+        target.moments = 0;
+        if (moments) {
+            glGenTextures(1, &target.moments);
+            glBindTexture(GL_TEXTURE_CUBE_MAP, target.moments);
+
+            for (i = 0; i < 6; ++i) {
+                glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, 0, GL_RG32F,
+                    DEPTH_RES_WIDTH, DEPTH_RES_HEIGHT, 0, GL_RG, GL_FLOAT, NULL);
+            }
+            glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+            glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+            glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+            glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+            glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+            glBindTexture(GL_TEXTURE_CUBE_MAP, 0);
+        }
+
+        glGenFramebuffers(1, &target.fbo);
+        glBindFramebuffer(GL_FRAMEBUFFER, target.fbo);
+        glFramebufferTexture(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, target.tex, 0);
+        if (moments) {
+            glFramebufferTexture(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, target.moments, 0);
+            glDrawBuffer(GL_COLOR_ATTACHMENT0);
+        } else {
+            glDrawBuffer(GL_NONE);
+        }
 
         fprintf(stdout, "%s\x1b[0m\n",
             glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE ?
                 "\x1b[32mShadow initialization complete" : "\x1b[31mShadow initialization failed");
+
+        // Per face targets for the multipass path and cache copies
+        glGenFramebuffers(6, target.faceFbo);
+        for (i = 0; i < 6; ++i) {
+            glBindFramebuffer(GL_FRAMEBUFFER, target.faceFbo[i]);
+            glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT,
+                GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, target.tex, 0);
+            if (moments) {
+                glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
+                    GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, target.moments, 0);
+                glDrawBuffer(GL_COLOR_ATTACHMENT0);
+            } else {
+                glDrawBuffer(GL_NONE);
+            }
+        }
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    }
+
+    // Resources for the cheaper filters: a depth compare sampler over the live cube,
+    // the variance shadow cube and a scratch target for its separable blur
+    void setupFilterBuffers() {
+        GPU_OWNER("Shadow maps");
+        glGenSamplers(1, &cmpSampler);
+        glSamplerParameteri(cmpSampler, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glSamplerParameteri(cmpSampler, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glSamplerParameteri(cmpSampler, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glSamplerParameteri(cmpSampler, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glSamplerParameteri(cmpSampler, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+        glSamplerParameteri(cmpSampler, GL_TEXTURE_COMPARE_MODE, GL_COMPARE_REF_TO_TEXTURE);
+        glSamplerParameteri(cmpSampler, GL_TEXTURE_COMPARE_FUNC, GL_LEQUAL);
+
+        setupShadowBuffers(shadowVsm, true);
+
+        glGenTextures(1, &blurTex);
+        glBindTexture(GL_TEXTURE_2D, blurTex);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RG32F,
+            DEPTH_RES_WIDTH, DEPTH_RES_HEIGHT, 0, GL_RG, GL_FLOAT, NULL);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glBindTexture(GL_TEXTURE_2D, 0);
+
+        glGenFramebuffers(1, &blurFbo);
+        glBindFramebuffer(GL_FRAMEBUFFER, blurFbo);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
+            GL_TEXTURE_2D, blurTex, 0);
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    }
+
+    // Single depth texture shared by the shadows of all lights
+    void setupAtlasBuffer() {
+        GPU_OWNER("Shadow maps");
+        glGenTextures(1, &atlasTex);
+        glBindTexture(GL_TEXTURE_2D, atlasTex);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT32F,
+            ATLAS_RES, ATLAS_RES, 0, GL_DEPTH_COMPONENT, GL_FLOAT, NULL);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_COMPARE_MODE, GL_COMPARE_REF_TO_TEXTURE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_COMPARE_FUNC, GL_LEQUAL);
+        glBindTexture(GL_TEXTURE_2D, 0);
+
+        glGenFramebuffers(1, &atlasFbo);
+        glBindFramebuffer(GL_FRAMEBUFFER, atlasFbo);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT,
+            GL_TEXTURE_2D, atlasTex, 0);
+        glDrawBuffer(GL_NONE);
+
+        fprintf(stdout, "%s\x1b[0m\n",
+            glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE ?
+                "\x1b[32mShadow atlas initialization complete" :
+                "\x1b[31mShadow atlas initialization failed");
         glBindFramebuffer(GL_FRAMEBUFFER, 0);
     }
 
     void setupShaders() {
         // Initiate shaders
-        shadow_shader.load("media/shadow_map_pl/shaders/shadow.vert",
+        shadow_shader[SHADOW_GEOM].load("media/shadow_map_pl/shaders/shadow.vert",
             glf::Shader::VERTEX);
-        shadow_shader.load("media/shadow_map_pl/shaders/shadow.frag",
+        shadow_shader[SHADOW_GEOM].load("media/shadow_map_pl/shaders/shadow.frag",
             glf::Shader::FRAGMENT);
-        shadow_shader.load("media/shadow_map_pl/shaders/shadow.geom",
+        shadow_shader[SHADOW_GEOM].load("media/shadow_map_pl/shaders/shadow.geom",
             glf::Shader::GEOMETRY);
-        shadow_shader.compile();
+        shadow_shader[SHADOW_GEOM].compile();
+
+        // gl_Layer can only be written from the vertex stage with extension support
+        if (layeredSupported) {
+            shadow_shader[SHADOW_LAYERED].load("media/shadow_map_pl/shaders/shadow_layer.vert",
+                glf::Shader::VERTEX);
+            shadow_shader[SHADOW_LAYERED].load("media/shadow_map_pl/shaders/shadow.frag",
+                glf::Shader::FRAGMENT);
+            shadow_shader[SHADOW_LAYERED].compile();
+        }
+
+        shadow_shader[SHADOW_MULTIPASS].load("media/shadow_map_pl/shaders/shadow_face.vert",
+            glf::Shader::VERTEX);
+        shadow_shader[SHADOW_MULTIPASS].load("media/shadow_map_pl/shaders/shadow.frag",
+            glf::Shader::FRAGMENT);
+        shadow_shader[SHADOW_MULTIPASS].compile();
 
         light_shader.load("media/shadow_map_pl/shaders/light.vert",
             glf::Shader::VERTEX);
@@ -228,9 +431,15 @@ class PointShadowMap: public glf::BaseApp {
             glf::Shader::FRAGMENT);
         light_shader.compile();
 
+        blur_shader.load("media/shadow_map_pl/shaders/blur.vert",
+            glf::Shader::VERTEX);
+        blur_shader.load("media/shadow_map_pl/shaders/blur.frag",
+            glf::Shader::FRAGMENT);
+        blur_shader.compile();
+
         text_shader.load("media/shadow_map_pl/shaders/text.vert",
             glf::Shader::VERTEX);
-        text_shader.load("media/shadow_map_pl/shaders/text.frag",
+        text_shader.load("media/shadow_map_pl/shaders/text_sdf.frag",
             glf::Shader::FRAGMENT);
         text_shader.compile();
 
@@ -252,6 +461,12 @@ class PointShadowMap: public glf::BaseApp {
         uniformScene.frag.lcount        = uni_loc(scene_shader, "light_count");
         uniformScene.frag.shadowTex     = uni_loc(scene_shader, "shadow_tex");
         uniformScene.frag.farPlane      = uni_loc(scene_shader, "farPlane");
+        uniformScene.frag.shadowCmpTex  = uni_loc(scene_shader, "shadow_cmp_tex");
+        uniformScene.frag.vsmTex        = uni_loc(scene_shader, "vsm_tex");
+        uniformScene.frag.shadowMode    = uni_loc(scene_shader, "shadow_mode");
+        uniformScene.frag.atlasTex      = uni_loc(scene_shader, "atlas_tex");
+        uniformScene.frag.atlasEnabled  = uni_loc(scene_shader, "atlas_enabled");
+        uniformScene.atlas.tile         = uni_loc(scene_shader, "atlas_tile");
 
         uniformScene.world.amb          = uni_loc(scene_shader, "world.ambience");
         uniformScene.material.shine     = uni_loc(scene_shader, "material.shininess");
@@ -272,15 +487,33 @@ class PointShadowMap: public glf::BaseApp {
             uniformScene.light[i].epsilon    = get_uni(scene_shader, "light", "epsilon", i);
         }
 
+        for (i = 0; i < 6; ++i) {
+            uniformScene.atlas.faceDir[i]   = util::uni_loc_i(scene_shader.getProgram(), "face_dir", i);
+            uniformScene.atlas.faceRight[i] = util::uni_loc_i(scene_shader.getProgram(), "face_right", i);
+            uniformScene.atlas.faceUp[i]    = util::uni_loc_i(scene_shader.getProgram(), "face_up", i);
+        }
+
 #undef get_uni
 
-        for (i = 0; i < 6; ++i) {
-            uniformShadow.geom.lvpMat[i]     = util::uni_loc_i(
-                shadow_shader.getProgram(), "lvpMat", i);
+        for (GLuint p = 0; p < SHADOW_PATH_SZ; ++p) {
+            if (p == SHADOW_LAYERED && !layeredSupported) continue;
+            for (i = 0; i < 6; ++i) {
+                uniformShadow[p].vert.lvpMat[i] = util::uni_loc_i(
+                    shadow_shader[p].getProgram(), "lvpMat", i);
+            }
+            uniformShadow[p].vert.lmMat     = uni_loc(shadow_shader[p], "lmMat");
+            uniformShadow[p].vert.faceIdx   = uni_loc(shadow_shader[p], "faceIdx");
+            uniformShadow[p].frag.lightPos  = uni_loc(shadow_shader[p], "lightPos");
+            uniformShadow[p].frag.farPlane  = uni_loc(shadow_shader[p], "farPlane");
         }
-        uniformShadow.vert.lmMat        = uni_loc(shadow_shader, "lmMat");
-        uniformShadow.frag.lightPos     = uni_loc(shadow_shader, "lightPos");
-        uniformShadow.frag.farPlane     = uni_loc(shadow_shader, "farPlane");
+        // Single face shader takes a plain matrix
+        uniformShadow[SHADOW_MULTIPASS].vert.lvpMat[0] =
+            uni_loc(shadow_shader[SHADOW_MULTIPASS], "lvpMat");
+
+        uniformBlur.planeSrc            = uni_loc(blur_shader, "plane_src");
+        uniformBlur.cubeSrc             = uni_loc(blur_shader, "cube_src");
+        uniformBlur.face                = uni_loc(blur_shader, "face");
+        uniformBlur.step                = uni_loc(blur_shader, "blur_step");
 
         uniformLight.vert.transMat      = uni_loc(light_shader, "transform");
         uniformLight.frag.col           = uni_loc(light_shader, "light_color");
@@ -324,9 +557,17 @@ class PointShadowMap: public glf::BaseApp {
     }
 
     void shutdown() {
-        glDeleteTextures(1, &depthTex);
+        shadowTimer.dispose();
+        sceneTimer.dispose();
         glDeleteBuffers(1, &vBO);
-        glDeleteBuffers(1, &depthBuffer);
+        disposeShadowBuffers(shadowLive);
+        disposeShadowBuffers(shadowCached);
+        disposeShadowBuffers(shadowVsm);
+        glDeleteTextures(1, &blurTex);
+        glDeleteFramebuffers(1, &blurFbo);
+        glDeleteSamplers(1, &cmpSampler);
+        glDeleteTextures(1, &atlasTex);
+        glDeleteFramebuffers(1, &atlasFbo);
         glDeleteVertexArrays(VAO_SZ, vAO);
     }
 
@@ -337,37 +578,84 @@ class PointShadowMap: public glf::BaseApp {
         update_state(duration);
 
         /* --------------------- Render shadow map --------------------- */
-        shadow_shader.use();
-        glBindFramebuffer(GL_FRAMEBUFFER, depthBuffer);
-        glViewport(0, 0, DEPTH_RES_WIDTH, DEPTH_RES_HEIGHT);
-
-        glClearDepth(1.0f);
-        glClear(GL_DEPTH_BUFFER_BIT);
-
         // Recalculate light view
         glm::vec3 pos = light[0].position();
         for (i = 0; i < 6; ++i) {
             lvMat = glm::lookAt(pos, pos + kLookVector[i][0], kLookVector[i][1]);
             lvpMat[i] = lpMat * lvMat;
-            glUniformMatrix4fv(uniformShadow.geom.lvpMat[i], 1, GL_FALSE, _vp(lvpMat[i]));
         }
-        glUniform3fv(uniformShadow.frag.lightPos, 1, _vp(pos));
 
-        for (i = 0; i < MODEL_SZ; ++i) {
-            glUniformMatrix4fv(uniformShadow.vert.lmMat, 1, GL_FALSE, _vp(model[i].modelMat()));
-            model[i].render(&shader_tex_info);
+        glViewport(0, 0, DEPTH_RES_WIDTH, DEPTH_RES_HEIGHT);
+        glClearDepth(1.0f);
+
+        shadowTimer.begin();
+        prof::Profiler::instance().beginGpuZone("Shadow pass");
+
+        // Static depth is kept in its own cube only if dynamic casters are drawn over it,
+        // otherwise the live shadow cube doubles as the cache
+        bool cached = shadowCache.isEnabled();
+        bool split = cached && hasDynamicCasters();
+        if (atlasEnabled) {
+            allocateAtlas();
+            renderAtlas();
+        } else if (shadowFilter == FILTER_VSM) {
+            // Blurred moments can't be composited, so all casters are redrawn
+            renderMoments(pos);
+        } else {
+            if (shadowCache.stale(light[0])) {
+                renderShadow(pos, split ? shadowCached : shadowLive,
+                    cached ? glf3d::CASTER_STATIC : glf3d::CASTER_ALL, true);
+            }
+            if (split) {
+                for (i = 0; i < 6; ++i) {
+                    glf3d::blitDepth(shadowCached.faceFbo[i], shadowLive.faceFbo[i],
+                        DEPTH_RES_WIDTH, DEPTH_RES_HEIGHT);
+                }
+                renderShadow(pos, shadowLive, glf3d::CASTER_DYNAMIC, false);
+            }
         }
+
+        prof::Profiler::instance().endGpuZone();
+        shadowTimer.end();
         glBindFramebuffer(GL_FRAMEBUFFER, 0);
 
+        if (elapsedTime - lastReport > SHADOW_REPORT_INTERVAL) {
+            fprintf(stdout, "Shadow pass [%s, cache %s]: %.3f ms (%u face draws culled, %u rebuilds)\n",
+                kShadowPathStr[shadowPath], cached ? "on" : "off", shadowTimer.average(),
+                culledFaces, shadowCache.rebuildCount());
+            fprintf(stdout, "Scene pass [%s filter]: %.3f ms\n",
+                atlasEnabled ? "atlas" : kShadowFilterStr[shadowFilter], sceneTimer.average());
+            if (atlasEnabled) {
+                fprintf(stdout, "Shadow atlas tiles:");
+                for (i = 0; i < NUM_LIGHTS; ++i)
+                    fprintf(stdout, " %u", atlas.granted(atlasReq[i]));
+                fprintf(stdout, "\n");
+            }
+            shadowTimer.reset();
+            sceneTimer.reset();
+            lastReport = elapsedTime;
+        }
+
         /* ------------------------ Render scene ------------------------ */
+        sceneTimer.begin();
+        prof::Profiler::instance().beginGpuZone("Scene pass");
         scene_shader.use();
         glViewport(0, 0, getWidth(), getHeight());
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-        // Bind to shadow texture uniform
+        // Bind shadow textures: the depth cube is read raw (pcf) and through
+        // the compare sampler (poisson), moments only by the vsm filter
         glActiveTexture(GL_TEXTURE3);
-        glBindTexture(GL_TEXTURE_CUBE_MAP, depthTex);
-        glUniform1i(uniformScene.frag.shadowTex, 3);
+        glBindTexture(GL_TEXTURE_CUBE_MAP, shadowLive.tex);
+        glActiveTexture(GL_TEXTURE4);
+        glBindTexture(GL_TEXTURE_CUBE_MAP, shadowLive.tex);
+        glBindSampler(4, cmpSampler);
+        glActiveTexture(GL_TEXTURE5);
+        glBindTexture(GL_TEXTURE_CUBE_MAP, shadowVsm.moments);
+        glActiveTexture(GL_TEXTURE6);
+        glBindTexture(GL_TEXTURE_2D, atlasTex);
+        if (atlasEnabled)
+            glUniform3fv(uniformScene.atlas.tile, NUM_LIGHTS * 6, _vp(atlasTile[0]));
         glUniform3fv(uniformScene.frag.cam_pos, 1, _vp(cam.position()));
 
         // Send light data to shader
@@ -391,7 +679,15 @@ class PointShadowMap: public glf::BaseApp {
             glUniform1f(uniformScene.material.specint, model[i].material.specularIntensity());
             model[i].render(&shader_tex_info);
         }
-        glBindTexture(GL_TEXTURE_CUBE_MAP, 0);
+        for (i = 3; i <= 5; ++i) {
+            glActiveTexture(GL_TEXTURE0 + i);
+            glBindTexture(GL_TEXTURE_CUBE_MAP, 0);
+        }
+        glBindSampler(4, 0);
+        glActiveTexture(GL_TEXTURE6);
+        glBindTexture(GL_TEXTURE_2D, 0);
+        prof::Profiler::instance().endGpuZone();
+        sceneTimer.end();
 
         /* -------------------------- Render Lights --------------------- */
         light_shader.use();
@@ -406,14 +702,303 @@ class PointShadowMap: public glf::BaseApp {
         }
         glBindVertexArray(0);
     }
+
+    void renderShadow(const glm::vec3& pos, const ShadowTarget& target,
+                      glf3d::CasterFilter filter, bool clear) {
+        switch (shadowPath) {
+            case SHADOW_GEOM: renderShadowGeom(pos, target, filter, clear); break;
+            case SHADOW_LAYERED: renderShadowLayered(pos, target, filter, clear); break;
+            case SHADOW_MULTIPASS: renderShadowMultipass(pos, target, filter, clear); break;
+            default: break;
+        }
+    }
+
+    // Variance shadow cube: depth moments of all casters, then a separable
+    // gaussian per face (horizontal into the scratch target, vertical back)
+    void renderMoments(const glm::vec3& pos) {
+        glBindFramebuffer(GL_FRAMEBUFFER, shadowVsm.fbo);
+        glClearColor(1.0f, 1.0f, 1.0f, 1.0f);
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        glClearColor(bg_col[0], bg_col[1], bg_col[2], bg_col[3]);
+        renderShadow(pos, shadowVsm, glf3d::CASTER_ALL, false);
+
+        blur_shader.use();
+        glDisable(GL_DEPTH_TEST);
+        glBindVertexArray(vAO[BLUR]);
+
+        // Only the source of each pass stays bound, so a written image is never sampled
+        for (i = 0; i < 6; ++i) {
+            glActiveTexture(GL_TEXTURE0);
+            glBindTexture(GL_TEXTURE_2D, 0);
+            glActiveTexture(GL_TEXTURE1);
+            glBindTexture(GL_TEXTURE_CUBE_MAP, shadowVsm.moments);
+            glBindFramebuffer(GL_FRAMEBUFFER, blurFbo);
+            glUniform1i(uniformBlur.face, i);
+            glUniform2f(uniformBlur.step, 1.0f / DEPTH_RES_WIDTH, 0.0f);
+            glDrawArrays(GL_TRIANGLES, 0, 3);
+
+            glBindTexture(GL_TEXTURE_CUBE_MAP, 0);
+            glActiveTexture(GL_TEXTURE0);
+            glBindTexture(GL_TEXTURE_2D, blurTex);
+            glBindFramebuffer(GL_FRAMEBUFFER, shadowVsm.faceFbo[i]);
+            glUniform1i(uniformBlur.face, -1);
+            glUniform2f(uniformBlur.step, 0.0f, 1.0f / DEPTH_RES_HEIGHT);
+            glDrawArrays(GL_TRIANGLES, 0, 3);
+        }
+
+        glBindTexture(GL_TEXTURE_2D, 0);
+        glBindVertexArray(0);
+        glEnable(GL_DEPTH_TEST);
+    }
+
+    // Whether the sphere a light's shadows reach is inside the side planes of the view
+    static bool reachVisible(const glm::mat4& _viewProj, const glm::vec3& _pos) {
+        glm::mat4 rows = glm::transpose(_viewProj);
+        for (GLuint p = 0; p < 4; ++p) {
+            glm::vec4 plane = rows[3] + (p & 1 ? -1.0f : 1.0f) * rows[p >> 1];
+            glm::vec3 normal(plane);
+            if (glm::dot(normal, _pos) + plane.w < -ATLAS_LIGHT_REACH * glm::length(normal))
+                return false;
+        }
+        return true;
+    }
+
+    /* Requests 6 atlas tiles per light, sized by the screen coverage of its
+     * shadows and ranked by coverage weighted intensity. Lights behind or
+     * beside the view cover nothing and get no tiles, nor a shadow pass */
+    void allocateAtlas() {
+        GLfloat coverage[NUM_LIGHTS], importance[NUM_LIGHTS];
+        GLuint order[NUM_LIGHTS], f;
+        GLfloat tanHalfFov = tanf(cam.fov() * 0.5f);
+        glm::mat4 viewProj = pMat * cam.viewMat();
+
+        for (i = 0; i < NUM_LIGHTS; ++i) {
+            glm::vec3 rel = light[i].position() - cam.position();
+            GLfloat dist = std::max(glm::length(rel), 0.01f);
+
+            bool hidden = glm::dot(rel, cam.front()) < -ATLAS_LIGHT_REACH ||
+                !reachVisible(viewProj, light[i].position());
+            coverage[i] = hidden ? 0.0f :
+                std::min(ATLAS_LIGHT_REACH / (dist * tanHalfFov), 1.0f);
+            importance[i] = coverage[i] * light[i].intensity();
+            order[i] = i;
+        }
+
+        for (i = 1; i < NUM_LIGHTS; ++i) {  // Insertion sort, most important first
+            for (f = i; f > 0 && importance[order[f]] > importance[order[f - 1]]; --f)
+                std::swap(order[f], order[f - 1]);
+        }
+
+        atlas.begin();
+        for (i = 0; i < NUM_LIGHTS; ++i) {
+            atlasReq[order[i]] = atlas.request(
+                static_cast<GLuint>(ATLAS_MAX_TILE * coverage[order[i]]), 6);
+        }
+        atlas.pack();
+
+        for (i = 0; i < NUM_LIGHTS; ++i)
+            for (f = 0; f < 6; ++f)
+                atlasTile[i * 6 + f] = atlas.tileTransform(atlasReq[i], f);
+    }
+
+    // All lights into one atlas: a viewport per cube face tile, one framebuffer
+    void renderAtlas() {
+        ShadowUniforms& uni = uniformShadow[SHADOW_MULTIPASS];
+        shadow_shader[SHADOW_MULTIPASS].use();
+        glBindFramebuffer(GL_FRAMEBUFFER, atlasFbo);
+        glViewport(0, 0, ATLAS_RES, ATLAS_RES);
+        glClear(GL_DEPTH_BUFFER_BIT);
+
+        GLuint l, f, culled = 0;
+        for (l = 0; l < NUM_LIGHTS; ++l) {
+            if (!atlas.granted(atlasReq[l])) continue;
+
+            glm::vec3 pos = light[l].position();
+            glUniform3fv(uni.frag.lightPos, 1, _vp(pos));
+            updateFaceVisibility(pos);
+            culled += culledFaces;
+
+            for (f = 0; f < 6; ++f) {
+                const glf3d::ShadowTile& tile = atlas.tile(atlasReq[l], f);
+                glViewport(tile.x, tile.y, tile.size, tile.size);
+                lvMat = glm::lookAt(pos, pos + kLookVector[f][0], kLookVector[f][1]);
+                glUniformMatrix4fv(uni.vert.lvpMat[0], 1, GL_FALSE, _vp(lpMat * lvMat));
+
+                for (i = 0; i < MODEL_SZ; ++i) {
+                    if (!(faceMask[i] & (1 << f))) continue;
+
+                    glUniformMatrix4fv(uni.vert.lmMat, 1, GL_FALSE, _vp(model[i].modelMat()));
+                    model[i].render(&shader_tex_info);
+                }
+            }
+        }
+        culledFaces = culled;
+    }
+
+    // Reference path: geometry shader amplifies every triangle to all 6 faces
+    void renderShadowGeom(const glm::vec3& pos, const ShadowTarget& target,
+                          glf3d::CasterFilter filter, bool clear) {
+        ShadowUniforms& uni = uniformShadow[SHADOW_GEOM];
+        shadow_shader[SHADOW_GEOM].use();
+        glBindFramebuffer(GL_FRAMEBUFFER, target.fbo);
+        if (clear) glClear(GL_DEPTH_BUFFER_BIT);
+
+        for (i = 0; i < 6; ++i)
+            glUniformMatrix4fv(uni.vert.lvpMat[i], 1, GL_FALSE, _vp(lvpMat[i]));
+        glUniform3fv(uni.frag.lightPos, 1, _vp(pos));
+
+        culledFaces = 0;
+        for (i = 0; i < MODEL_SZ; ++i) {
+            if (!glf3d::casterSelected(casterStatic[i], filter)) continue;
+
+            glUniformMatrix4fv(uni.vert.lmMat, 1, GL_FALSE, _vp(model[i].modelMat()));
+            model[i].render(&shader_tex_info);
+        }
+    }
+
+    // Single pass: each model is instanced once per cube face it touches
+    void renderShadowLayered(const glm::vec3& pos, const ShadowTarget& target,
+                             glf3d::CasterFilter filter, bool clear) {
+        ShadowUniforms& uni = uniformShadow[SHADOW_LAYERED];
+        shadow_shader[SHADOW_LAYERED].use();
+        glBindFramebuffer(GL_FRAMEBUFFER, target.fbo);
+        if (clear) glClear(GL_DEPTH_BUFFER_BIT);
+
+        for (i = 0; i < 6; ++i)
+            glUniformMatrix4fv(uni.vert.lvpMat[i], 1, GL_FALSE, _vp(lvpMat[i]));
+        glUniform3fv(uni.frag.lightPos, 1, _vp(pos));
+        updateFaceVisibility(pos);
+
+        GLint faces[6]; GLuint f, count;
+        for (i = 0; i < MODEL_SZ; ++i) {
+            if (!glf3d::casterSelected(casterStatic[i], filter)) continue;
+
+            for (f = count = 0; f < 6; ++f)
+                if (faceMask[i] & (1 << f)) faces[count++] = f;
+            if (!count) continue;
+
+            glf3d::RenderContext& ctx = model[i].renderContext();
+            ctx.shouldDrawInstanced = true;
+            ctx.instanceAmount = count;
+
+            glUniform1iv(uni.vert.faceIdx, count, faces);
+            glUniformMatrix4fv(uni.vert.lmMat, 1, GL_FALSE, _vp(model[i].modelMat()));
+            model[i].render(&shader_tex_info);
+            ctx.shouldDrawInstanced = false;
+        }
+    }
+
+    // Fallback: one pass per cube face, skipping models outside that face
+    void renderShadowMultipass(const glm::vec3& pos, const ShadowTarget& target,
+                               glf3d::CasterFilter filter, bool clear) {
+        ShadowUniforms& uni = uniformShadow[SHADOW_MULTIPASS];
+        shadow_shader[SHADOW_MULTIPASS].use();
+        glUniform3fv(uni.frag.lightPos, 1, _vp(pos));
+        updateFaceVisibility(pos);
+
+        GLuint f;
+        for (f = 0; f < 6; ++f) {
+            glBindFramebuffer(GL_FRAMEBUFFER, target.faceFbo[f]);
+            if (clear) glClear(GL_DEPTH_BUFFER_BIT);
+            glUniformMatrix4fv(uni.vert.lvpMat[0], 1, GL_FALSE, _vp(lvpMat[f]));
+
+            for (i = 0; i < MODEL_SZ; ++i) {
+                if (!(faceMask[i] & (1 << f)) ||
+                    !glf3d::casterSelected(casterStatic[i], filter)) continue;
+
+                glUniformMatrix4fv(uni.vert.lmMat, 1, GL_FALSE, _vp(model[i].modelMat()));
+                model[i].render(&shader_tex_info);
+            }
+        }
+    }
 #undef _vp
 
+    void disposeShadowBuffers(ShadowTarget& target) {
+        glDeleteTextures(1, &target.tex);
+        glDeleteTextures(1, &target.moments);
+        glDeleteFramebuffers(1, &target.fbo);
+        glDeleteFramebuffers(6, target.faceFbo);
+    }
+
+    bool hasDynamicCasters() const {
+        for (GLuint m = 0; m < MODEL_SZ; ++m)
+            if (!casterStatic[m]) return true;
+        return false;
+    }
+
+    void updateFaceVisibility(const glm::vec3& pos) {
+        glm::vec3 center; GLfloat radius;
+        GLuint f;
+
+        culledFaces = 0;
+        for (i = 0; i < MODEL_SZ; ++i) {
+            model[i].boundingSphere(center, radius);
+
+            faceMask[i] = 0;
+            for (f = 0; f < 6; ++f) {
+                if (cubeFaceVisible(f, center - pos, radius))
+                    faceMask[i] |= 1 << f;
+                else
+                    culledFaces++;
+            }
+        }
+    }
+
+    void onKeyPress(int key, int mods) {
+        glf::BaseApp::onKeyPress(key, mods);
+
+        ShadowPath path = shadowPath;
+        switch (key) {
+            case GLFW_KEY_1: path = SHADOW_GEOM; break;
+            case GLFW_KEY_2: if (layeredSupported) path = SHADOW_LAYERED; break;
+            case GLFW_KEY_3: path = SHADOW_MULTIPASS; break;
+            case GLFW_KEY_C:
+                shadowCache.enable(!shadowCache.isEnabled());
+                shadowTimer.reset();
+                return;
+            case GLFW_KEY_P:
+                if (lightAnim[0].status() == anim::RUNNING) animReg.pause();
+                else animReg.play();
+                return;
+            case GLFW_KEY_F:
+                shadowFilter = (ShadowFilter) ((shadowFilter + 1) % FILTER_SZ);
+                scene_shader.use();
+                glUniform1i(uniformScene.frag.shadowMode, shadowFilter);
+                shadowTimer.reset();
+                sceneTimer.reset();
+                fprintf(stdout, "Shadow filter: %s\n", kShadowFilterStr[shadowFilter]);
+                return;
+            case GLFW_KEY_T:
+                atlasEnabled = !atlasEnabled;
+                scene_shader.use();
+                glUniform1i(uniformScene.frag.atlasEnabled, atlasEnabled);
+                shadowTimer.reset();
+                sceneTimer.reset();
+                fprintf(stdout, "Shadow atlas: %s\n", atlasEnabled ? "on" : "off");
+                return;
+            default: return;
+        }
+
+        if (path != shadowPath) {
+            shadowPath = path;
+            shadowCache.invalidate();
+            shadowTimer.reset();
+            fprintf(stdout, "Shadow path: %s\n", kShadowPathStr[shadowPath]);
+        }
+    }
+
     // Ugly state machine
     void update_state(double duration) {
         // Handle animation
         animReg.animate(duration);
-        light[0].rotateAnchor(
-            glm::radians(lightAnim[0].value()), kLightRotAxis, kWorldOrigin);
+        // Leave the light untouched while paused to keep the shadow cache valid
+        if (lightAnim[0].status() == anim::RUNNING) {
+            for (i = 0; i < NUM_LIGHTS; ++i) {
+                light[i].rotateAnchor(
+                    glm::radians(lightAnim[i].value()), kLightRotAxis, kWorldOrigin);
+            }
+        }
+        model[BOX0].rotate(glm::radians(boxSpin.value()), kModelRotAxis);
 
         // Handle keyboard input
         if (testKeyState(GLFW_KEY_W, GLFW_PRESS))
@@ -442,22 +1027,31 @@ class PointShadowMap: public glf::BaseApp {
     }
 
  private:
-    enum VAOs { LIGHT, VAO_SZ };
+    enum VAOs { LIGHT, BLUR, VAO_SZ };
     enum MODEL { BOX0, BOX1, BOX2, ROOM, MODEL_SZ };
+    enum ShadowPath { SHADOW_GEOM, SHADOW_LAYERED, SHADOW_MULTIPASS, SHADOW_PATH_SZ };
+    // Matches shadow_mode in scene.frag
+    enum ShadowFilter { FILTER_PCF, FILTER_POISSON, FILTER_VSM, FILTER_SZ };
 
     static const GLuint kVertsCount = 36;
 
     // OpenGL data
     GLfloat bg_col[4];
     GLuint vAO[VAO_SZ], vBO;
-    GLuint depthBuffer, depthTex;
-    glf::Shader scene_shader, light_shader, shadow_shader, text_shader;
+    ShadowTarget shadowLive, shadowCached, shadowVsm;
+    GLuint cmpSampler, blurTex, blurFbo;
+    glf::Shader scene_shader, light_shader, text_shader, blur_shader;
+    glf::Shader shadow_shader[SHADOW_PATH_SZ];
     glf::ShaderTextureInfo shader_tex_info;
     GLuint i;  // Loop counter
 
     struct {
         struct { GLuint modelMat, transMat, normalMat, invertNormal; } vert;
-        struct { GLuint cam_pos, lcount, shadowTex, farPlane; } frag;
+        struct {
+            GLuint cam_pos, lcount, shadowTex, farPlane,
+                shadowCmpTex, vsmTex, shadowMode, atlasTex, atlasEnabled;
+        } frag;
+        struct { GLuint tile, faceDir[6], faceRight[6], faceUp[6]; } atlas;
         struct { GLuint amb; } world;
         struct { GLuint shine, specint, amb; } material;
 
@@ -473,10 +1067,36 @@ class PointShadowMap: public glf::BaseApp {
     } uniformLight;
 
     struct {
-        struct { GLuint lmMat; } vert;
-        struct { GLuint lvpMat[6]; } geom;
+        GLuint planeSrc, cubeSrc, face, step;
+    } uniformBlur;
+
+    struct ShadowUniforms {
+        struct { GLuint lmMat, lvpMat[6], faceIdx; } vert;
         struct { GLuint lightPos, farPlane; } frag;
-    } uniformShadow;
+    } uniformShadow[SHADOW_PATH_SZ];
+
+    // Shadow path state
+    ShadowPath shadowPath;
+    bool layeredSupported;
+    GLuint faceMask[MODEL_SZ], culledFaces;
+    util::GPUTimer shadowTimer, sceneTimer;
+    double lastReport;
+
+    // Shadow filter state
+    ShadowFilter shadowFilter;
+    static const char* const kShadowFilterStr[FILTER_SZ];
+
+    // Shadow atlas state
+    bool atlasEnabled;
+    GLuint atlasTex, atlasFbo;
+    GLuint atlasReq[NUM_LIGHTS];
+    glm::vec3 atlasTile[NUM_LIGHTS * 6];
+    glf3d::ShadowAtlas atlas;
+
+    // Shadow cache state
+    bool casterStatic[MODEL_SZ];
+    glf3d::ShadowCache shadowCache;
+    static const char* const kShadowPathStr[SHADOW_PATH_SZ];
 
     // Transform data
     glm::mat4 lpMat, lvMat, lvpMat[6];
@@ -493,7 +1113,15 @@ class PointShadowMap: public glf::BaseApp {
 
     // Animation data
     anim::AnimatorRegistry<GLfloat> animReg;
-    anim::PropertyAnimator<GLfloat> lightAnim[1];
+    anim::PropertyAnimator<GLfloat> lightAnim[NUM_LIGHTS], boxSpin;
+};
+
+const char* const PointShadowMap::kShadowPathStr[SHADOW_PATH_SZ] = {
+    "geometry", "layered", "multipass"
+};
+
+const char* const PointShadowMap::kShadowFilterStr[PointShadowMap::FILTER_SZ] = {
+    "pcf", "poisson", "vsm"
 };
 
 DECLARE_MAIN(PointShadowMap);